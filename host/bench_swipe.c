@@ -0,0 +1,58 @@
+// Microbenchmarks do caminho da passagem (main/swipe_bench.c) no PC, sobre
+// o backend de host/port. A mesma suíte roda na placa com CONFIG_RFID_BENCH
+// e imprime a mesma tabela em ciclos.
+//
+//   ./build-host/bench_swipe            # estado em diretório temporário
+//   ./build-host/bench_swipe DIR        # estado em DIR (mantido)
+//
+// Depois da tabela, o que os kernels de log gastaram de flash emulada.
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "host_port.h"
+#include "rfid_storage.h"
+#include "swipe_bench.h"
+#include "time_service.h"
+
+static void remove_dir(const char *dir)
+{
+    DIR *d = opendir(dir);
+    if (!d) return;
+    struct dirent *e;
+    char path[512];
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+        unlink(path);
+    }
+    closedir(d);
+    rmdir(dir);
+}
+
+int main(int argc, char **argv)
+{
+    char tmp[] = "/tmp/bench_swipe.XXXXXX";
+    const char *dir = argc > 1 ? argv[1] : mkdtemp(tmp);
+    if (!dir) {
+        perror("mkdtemp");
+        return 2;
+    }
+    if (!getenv("HOST_LOG_LEVEL")) esp_log_level_set("*", ESP_LOG_WARN);
+
+    ESP_ERROR_CHECK(host_port_init(dir, NULL));
+    ESP_ERROR_CHECK(rfid_storage_init());
+    ESP_ERROR_CHECK(time_service_init());
+    host_port_reset_stats();
+
+    esp_err_t err = swipe_bench_run();
+
+    printf("\nflash emulada durante a suite:\n");
+    host_port_print_stats(stdout);
+    if (argc <= 1) remove_dir(dir);
+    return err == ESP_OK ? 0 : 1;
+}
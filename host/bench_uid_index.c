@@ -0,0 +1,108 @@
+// Benchmark de busca de UID: índice hash (uid_index.c) vs varredura linear
+// com strcmp (implementação antiga de rfid_is_user_authorized).
+// A latência do índice deve ficar plana de 50 a 10.000 usuários.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "uid_index.h"
+
+// Mesmo layout de rfid_user_t (rfid_storage.h)
+typedef struct {
+    char uid[32];
+    char name[64];
+} user_t;
+
+#define LOOKUPS 200000
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static size_t slots_for(size_t n)
+{
+    size_t s = 1;
+    while (s < 2 * n) s <<= 1;
+    return s;
+}
+
+static int linear_find(const user_t *db, size_t n, const char *uid)
+{
+    for (size_t i = 0; i < n; i++) {
+        if (strcmp(db[i].uid, uid) == 0) return (int)i;
+    }
+    return -1;
+}
+
+static volatile int sink;
+
+static void run(size_t n)
+{
+    user_t *db = calloc(n, sizeof(user_t));
+    size_t n_slots = slots_for(n);
+    uid_index_slot_t *slots = malloc(n_slots * sizeof(uid_index_slot_t));
+    uid_index_t ix;
+
+    uid_index_init(&ix, slots, n_slots, db, sizeof(user_t));
+    for (size_t i = 0; i < n; i++) {
+        // UIDs no formato "facility:card" como os lidos via Wiegand
+        snprintf(db[i].uid, sizeof(db[i].uid), "%u:%u", (unsigned)(i % 255), (unsigned)(10000 + i * 7));
+        uid_index_insert(&ix, db[i].uid, (uint16_t)i);
+    }
+
+    char miss[32];
+    snprintf(miss, sizeof(miss), "999:%u", 1234567u);
+
+    // Acerto: UIDs espalhados pela tabela
+    double t0 = now_ns();
+    for (int k = 0; k < LOOKUPS; k++) {
+        sink = uid_index_find(&ix, db[((size_t)k * 7919u) % n].uid);
+    }
+    double hit = (now_ns() - t0) / LOOKUPS;
+
+    t0 = now_ns();
+    for (int k = 0; k < LOOKUPS; k++) {
+        sink = uid_index_find(&ix, miss);
+    }
+    double mis = (now_ns() - t0) / LOOKUPS;
+
+    // Linear: menos iterações para não demorar em 10k
+    int lin_lookups = LOOKUPS / (int)(n / 50 + 1);
+    t0 = now_ns();
+    for (int k = 0; k < lin_lookups; k++) {
+        sink = linear_find(db, n, db[((size_t)k * 7919u) % n].uid);
+    }
+    double lin = (now_ns() - t0) / lin_lookups;
+
+    // Remove metade e confere que o restante continua acessível
+    for (size_t i = 0; i < n; i += 2) {
+        if (uid_index_remove(&ix, db[i].uid) != (int)i) {
+            printf("ERRO: remove %s\n", db[i].uid);
+        }
+    }
+    for (size_t i = 1; i < n; i += 2) {
+        if (uid_index_find(&ix, db[i].uid) != (int)i) {
+            printf("ERRO: find %s\n", db[i].uid);
+        }
+    }
+
+    printf("%8zu %8zu %12.1f %12.1f %14.1f\n", n, n_slots, hit, mis, lin);
+    free(slots);
+    free(db);
+}
+
+int main(void)
+{
+    static const size_t sizes[] = { 50, 100, 500, 1000, 5000, 10000 };
+
+    printf("%8s %8s %12s %12s %14s\n", "users", "slots", "hit ns", "miss ns", "linear ns");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        run(sizes[i]);
+    }
+    return 0;
+}
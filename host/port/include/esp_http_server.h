@@ -0,0 +1,10 @@
+#pragma once
+// Não há servidor HTTP no PC: só o que web_writer.c referencia. A saída da
+// renderização vai para um sink (web_writer_begin_sink).
+
+#include <sys/types.h>
+#include "esp_err.h"
+
+typedef struct httpd_req httpd_req_t;
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len);
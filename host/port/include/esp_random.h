@@ -0,0 +1,6 @@
+#pragma once
+// esp_random no PC: getrandom(2) em vez do RNG de hardware.
+
+#include <stdint.h>
+
+uint32_t esp_random(void);
@@ -0,0 +1,9 @@
+#pragma once
+// Mesmos polinômios e convenção (valor invertido na entrada e na saída) das
+// funções da ROM: registros gravados no PC e no ESP32-C6 têm o mesmo CRC.
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+uint8_t esp_rom_crc8_le(uint8_t crc, const uint8_t *buf, uint32_t len);
@@ -0,0 +1,6 @@
+#pragma once
+// esp_timer_get_time no PC: CLOCK_MONOTONIC, em µs desde o início do processo.
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
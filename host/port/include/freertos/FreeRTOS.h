@@ -0,0 +1,39 @@
+#pragma once
+// Subconjunto da API do FreeRTOS sobre pthreads (host/port/port_freertos.c).
+// 1 tick = 1 ms. As seções críticas (portMUX) viram um mutex recursivo
+// global: no C6 de um núcleo só elas já serializam tudo, e aqui basta que
+// não haja duas ao mesmo tempo.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int32_t  BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE         ((BaseType_t)0)
+#define pdTRUE          ((BaseType_t)1)
+#define pdPASS          pdTRUE
+#define pdFAIL          pdFALSE
+
+#define configTICK_RATE_HZ  1000
+#define portTICK_PERIOD_MS  ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY       ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+typedef struct {
+    int unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED  { 0 }
+
+void host_port_enter_critical(void);
+void host_port_exit_critical(void);
+
+#define portENTER_CRITICAL(mux)   do { (void)(mux); host_port_enter_critical(); } while (0)
+#define portEXIT_CRITICAL(mux)    do { (void)(mux); host_port_exit_critical(); } while (0)
+#define taskENTER_CRITICAL(mux)   portENTER_CRITICAL(mux)
+#define taskEXIT_CRITICAL(mux)    portEXIT_CRITICAL(mux)
+
+#define configASSERT(x)     do { if (!(x)) __builtin_trap(); } while (0)
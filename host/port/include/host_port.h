@@ -0,0 +1,72 @@
+#pragma once
+// Backend Linux dos módulos de main/ (biblioteca rfid_core em host/).
+//
+// Os módulos usam a própria API do ESP-IDF como camada de hardware; aqui
+// ela é reimplementada com o mínimo que eles chamam:
+//   esp_partition  -> <dir>/<label>.bin, semântica NOR (port_flash.c)
+//   nvs            -> <dir>/nvs.bin, chave/valor tipado (port_nvs.c)
+//   FreeRTOS       -> pthreads, 1 tick = 1 ms (port_freertos.c)
+//   esp_timer, log, CRC da ROM, settimeofday (port_misc.c)
+//
+// Cada gravação e apagamento é contado, e o custo em tempo é estimado com
+// os valores típicos de uma NOR SPI (HOST_FLASH_*_US). Assim o mesmo
+// código roda sob perf/valgrind e os benchmarks medem também quanto de
+// flash cada operação gasta.
+
+#include <stdint.h>
+#include <stdio.h>
+#include "esp_err.h"
+
+// Tempos típicos de datasheet (GD25Q32/W25Q32, família usada nos módulos C6)
+#define HOST_FLASH_ERASE_SECTOR_US  45000   // setor de 4 KB
+#define HOST_FLASH_PROGRAM_PAGE_US  600     // página de 256 bytes
+#define HOST_FLASH_PAGE_SIZE        256
+
+// NVS do IDF: páginas de 4 KB com 126 entradas de 32 bytes
+#define HOST_NVS_ENTRY_SIZE         32
+#define HOST_NVS_ENTRIES_PER_PAGE   126
+
+typedef struct {
+    uint64_t read_bytes;
+    uint64_t write_ops;
+    uint64_t write_bytes;
+    uint64_t pages_programmed;      // páginas de 256 bytes tocadas por gravações
+    uint64_t erase_ops;
+    uint64_t erase_bytes;
+    uint64_t bad_writes;            // tentativa de levar bit de 0 a 1 (faltou apagar)
+} host_flash_stats_t;
+
+typedef struct {
+    uint64_t sets;                  // chamadas nvs_set_*
+    uint64_t sets_skipped;          // valor igual ao gravado: o IDF não grava
+    uint64_t erases;                // nvs_erase_key / chaves de nvs_erase_all
+    uint64_t commits;
+    uint64_t entries_written;       // entradas de 32 bytes
+    uint64_t program_ops;           // entradas + atualizações do bitmap de estado
+    uint64_t write_bytes;
+    uint64_t page_erases;           // páginas recicladas (coleta de lixo)
+    uint64_t erase_bytes;
+    uint32_t entries_live;
+    uint32_t entries_dead;          // apagadas/substituídas, ainda ocupando página
+    uint32_t entries_capacity;
+} host_nvs_stats_t;
+
+// Diretório dos arquivos (criado se não existir) e tabela de partições.
+// Chamar antes de qualquer módulo; partitions_csv NULL = ../partitions.csv
+// relativo ao fonte (HOST_PARTITIONS_CSV do CMake).
+esp_err_t host_port_init(const char *data_dir, const char *partitions_csv);
+
+// Partição pelo rótulo; ESP_ERR_NOT_FOUND se não existir
+esp_err_t host_flash_get_stats(const char *label, host_flash_stats_t *out);
+void host_nvs_get_stats(host_nvs_stats_t *out);
+void host_port_reset_stats(void);
+
+// Tempo de flash estimado (µs) para os contadores
+uint64_t host_flash_cost_us(const host_flash_stats_t *s);
+uint64_t host_nvs_cost_us(const host_nvs_stats_t *s);
+
+// Tabela com todas as partições e o NVS
+void host_port_print_stats(FILE *out);
+
+// Hora passada a settimeofday pelo time_service (o relógio do PC não muda)
+int64_t host_port_wall_offset_us(void);
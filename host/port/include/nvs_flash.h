@@ -0,0 +1,7 @@
+#pragma once
+// nvs_flash_init/erase no PC: carregam/zeram <dir>/nvs.bin (host/port/port_nvs.c)
+
+#include "esp_err.h"
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
@@ -0,0 +1,319 @@
+// Partições de dados em arquivo, com a semântica e a contabilidade da NOR.
+//
+// A tabela vem do mesmo partitions.csv do firmware. O arquivo de cada
+// partição só é criado (cheio de 0xFF, como flash apagada) quando algum
+// módulo a procura com esp_partition_find_first; o conteúdo fica em RAM e
+// cada gravação/apagamento é repassado ao arquivo na hora, então o estado
+// sobrevive entre execuções como sobreviveria a um reset.
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "host_port.h"
+#include "port_internal.h"
+
+static const char *TAG = "HOST_FLASH";
+
+#define MAX_PARTS       16
+#define TABLE_OFFSET    0x9000      // primeira partição depois da tabela (padrão do IDF)
+#define APP_ALIGN       0x10000
+
+typedef struct {
+    esp_partition_t part;
+    int fd;                         // -1 até o primeiro uso
+    uint8_t *mem;
+    host_flash_stats_t stats;
+} host_part_t;
+
+static host_part_t parts[MAX_PARTS];
+static int n_parts;
+static char data_dir[256];
+
+// =====================
+// Tabela de partições
+// =====================
+static char *trim(char *s)
+{
+    while (isspace((unsigned char)*s)) s++;
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) end--;
+    *end = '\0';
+    return s;
+}
+
+// "0x6000", "24K", "1M", "4096"
+static bool parse_size(const char *s, uint32_t *out)
+{
+    char *end;
+    unsigned long v = strtoul(s, &end, 0);
+    if (end == s) return false;
+    if (*end == 'K' || *end == 'k') v *= 1024, end++;
+    else if (*end == 'M' || *end == 'm') v *= 1024 * 1024, end++;
+    if (*end != '\0') return false;
+    *out = (uint32_t)v;
+    return true;
+}
+
+static int parse_subtype(const char *s)
+{
+    static const struct { const char *name; int value; } names[] = {
+        { "ota", 0x00 }, { "phy", 0x01 }, { "nvs", 0x02 }, { "coredump", 0x03 },
+        { "nvs_keys", 0x04 }, { "efuse", 0x05 }, { "fat", 0x81 }, { "spiffs", 0x82 },
+        { "factory", 0x00 },
+    };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(s, names[i].name) == 0) return names[i].value;
+    }
+    char *end;
+    long v = strtol(s, &end, 0);
+    return (end != s && *end == '\0') ? (int)v : -1;
+}
+
+static esp_err_t load_table(const char *csv)
+{
+    FILE *f = fopen(csv, "r");
+    if (!f) {
+        ESP_LOGE(TAG, "Tabela de particoes %s: %s", csv, strerror(errno));
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    uint32_t offset = TABLE_OFFSET;
+    char line[256];
+    n_parts = 0;
+    while (fgets(line, sizeof(line), f)) {
+        char *p = trim(line);
+        if (*p == '\0' || *p == '#') continue;
+
+        char *field[6] = { 0 };
+        int n = 0;
+        for (char *save, *tok = strtok_r(p, ",", &save); tok && n < 6; tok = strtok_r(NULL, ",", &save)) {
+            field[n++] = trim(tok);
+        }
+        if (n < 5) continue;
+
+        bool app = strcmp(field[1], "app") == 0;
+        uint32_t size, at;
+        int subtype = parse_subtype(field[2]);
+        if (!parse_size(field[4], &size) || subtype < 0 || n_parts == MAX_PARTS) {
+            ESP_LOGW(TAG, "Linha ignorada na tabela: %s", field[0]);
+            continue;
+        }
+        if (field[3][0] != '\0' && parse_size(field[3], &at)) {
+            offset = at;
+        } else if (app) {
+            offset = (offset + APP_ALIGN - 1) & ~(uint32_t)(APP_ALIGN - 1);
+        }
+
+        host_part_t *hp = &parts[n_parts++];
+        memset(hp, 0, sizeof(*hp));
+        hp->fd = -1;
+        hp->part.type = app ? ESP_PARTITION_TYPE_APP : ESP_PARTITION_TYPE_DATA;
+        hp->part.subtype = (esp_partition_subtype_t)subtype;
+        hp->part.address = offset;
+        hp->part.size = size;
+        hp->part.erase_size = SPI_FLASH_SEC_SIZE;
+        strncpy(hp->part.label, field[0], sizeof(hp->part.label) - 1);
+        offset += size;
+    }
+    fclose(f);
+    return n_parts ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t host_port_init(const char *dir, const char *partitions_csv)
+{
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        ESP_LOGE(TAG, "Diretorio %s: %s", dir, strerror(errno));
+        return ESP_FAIL;
+    }
+    snprintf(data_dir, sizeof(data_dir), "%s", dir);
+
+#ifdef HOST_PARTITIONS_CSV
+    if (!partitions_csv) partitions_csv = HOST_PARTITIONS_CSV;
+#endif
+    if (!partitions_csv) return ESP_ERR_INVALID_ARG;
+    esp_err_t err = load_table(partitions_csv);
+    if (err != ESP_OK) return err;
+
+    for (int i = 0; i < n_parts; i++) {
+        const esp_partition_t *p = &parts[i].part;
+        if (p->type == ESP_PARTITION_TYPE_DATA && p->subtype == ESP_PARTITION_SUBTYPE_DATA_NVS) {
+            return host_nvs_setup(data_dir, p->size);
+        }
+    }
+    ESP_LOGE(TAG, "Tabela sem particao nvs");
+    return ESP_ERR_NOT_FOUND;
+}
+
+// =====================
+// Arquivo de cada partição
+// =====================
+static esp_err_t open_backing(host_part_t *hp)
+{
+    if (hp->fd >= 0) return ESP_OK;
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s.bin", data_dir, hp->part.label);
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    uint8_t *mem = malloc(hp->part.size);
+    if (fd < 0 || !mem) {
+        ESP_LOGE(TAG, "%s: %s", path, fd < 0 ? strerror(errno) : "sem memoria");
+        if (fd >= 0) close(fd);
+        free(mem);
+        return ESP_FAIL;
+    }
+
+    // Arquivo novo ou menor que a partição: o resto é flash apagada
+    memset(mem, 0xFF, hp->part.size);
+    ssize_t got = pread(fd, mem, hp->part.size, 0);
+    if (got < (ssize_t)hp->part.size) {
+        size_t from = got > 0 ? (size_t)got : 0;
+        memset(mem + from, 0xFF, hp->part.size - from);
+        if (pwrite(fd, mem + from, hp->part.size - from, from) != (ssize_t)(hp->part.size - from)) {
+            ESP_LOGE(TAG, "%s: %s", path, strerror(errno));
+            close(fd);
+            free(mem);
+            return ESP_FAIL;
+        }
+    }
+    hp->fd = fd;
+    hp->mem = mem;
+    return ESP_OK;
+}
+
+static host_part_t *from_handle(const esp_partition_t *part)
+{
+    host_part_t *hp = (host_part_t *)part;      // part é o primeiro campo
+    return (hp >= parts && hp < parts + n_parts && hp->fd >= 0) ? hp : NULL;
+}
+
+static esp_err_t sync_range(host_part_t *hp, size_t offset, size_t size)
+{
+    return pwrite(hp->fd, hp->mem + offset, size, offset) == (ssize_t)size ? ESP_OK : ESP_FAIL;
+}
+
+// =====================
+// API esp_partition
+// =====================
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    for (int i = 0; i < n_parts; i++) {
+        host_part_t *hp = &parts[i];
+        if (type != ESP_PARTITION_TYPE_ANY && hp->part.type != type) continue;
+        if (subtype != ESP_PARTITION_SUBTYPE_ANY && hp->part.subtype != subtype) continue;
+        if (label && strcmp(hp->part.label, label) != 0) continue;
+        return open_backing(hp) == ESP_OK ? &hp->part : NULL;
+    }
+    return NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *part, size_t src_offset, void *dst, size_t size)
+{
+    host_part_t *hp = from_handle(part);
+    if (!hp || !dst) return ESP_ERR_INVALID_ARG;
+    if (src_offset > part->size || size > part->size - src_offset) return ESP_ERR_INVALID_SIZE;
+
+    memcpy(dst, hp->mem + src_offset, size);
+    hp->stats.read_bytes += size;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *part, size_t dst_offset, const void *src, size_t size)
+{
+    host_part_t *hp = from_handle(part);
+    if (!hp || !src) return ESP_ERR_INVALID_ARG;
+    if (dst_offset > part->size || size > part->size - dst_offset) return ESP_ERR_INVALID_SIZE;
+    if (size == 0) return ESP_OK;
+
+    // NOR: a gravação só zera bits. Levar um bit a 1 sem apagar antes
+    // não dá erro no chip, só deixa lixo; aqui ao menos é contado.
+    const uint8_t *in = src;
+    uint8_t *cell = hp->mem + dst_offset;
+    bool bad = false;
+    for (size_t i = 0; i < size; i++) {
+        if (in[i] & ~cell[i]) bad = true;
+        cell[i] &= in[i];
+    }
+    if (bad) {
+        hp->stats.bad_writes++;
+        ESP_LOGW(TAG, "%s: gravacao sobre area nao apagada em 0x%zx (+%zu)", part->label, dst_offset, size);
+    }
+
+    hp->stats.write_ops++;
+    hp->stats.write_bytes += size;
+    hp->stats.pages_programmed += (dst_offset + size - 1) / HOST_FLASH_PAGE_SIZE - dst_offset / HOST_FLASH_PAGE_SIZE + 1;
+    return sync_range(hp, dst_offset, size);
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t size)
+{
+    host_part_t *hp = from_handle(part);
+    if (!hp) return ESP_ERR_INVALID_ARG;
+    if (offset % SPI_FLASH_SEC_SIZE || size % SPI_FLASH_SEC_SIZE) return ESP_ERR_INVALID_SIZE;
+    if (offset > part->size || size > part->size - offset) return ESP_ERR_INVALID_SIZE;
+
+    memset(hp->mem + offset, 0xFF, size);
+    hp->stats.erase_ops += size / SPI_FLASH_SEC_SIZE;
+    hp->stats.erase_bytes += size;
+    return sync_range(hp, offset, size);
+}
+
+// =====================
+// Contadores
+// =====================
+esp_err_t host_flash_get_stats(const char *label, host_flash_stats_t *out)
+{
+    for (int i = 0; i < n_parts; i++) {
+        if (strcmp(parts[i].part.label, label) == 0) {
+            *out = parts[i].stats;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+uint64_t host_flash_cost_us(const host_flash_stats_t *s)
+{
+    return s->erase_ops * HOST_FLASH_ERASE_SECTOR_US + s->pages_programmed * HOST_FLASH_PROGRAM_PAGE_US;
+}
+
+void host_port_reset_stats(void)
+{
+    for (int i = 0; i < n_parts; i++) memset(&parts[i].stats, 0, sizeof(parts[i].stats));
+    host_nvs_reset_stats();
+}
+
+void host_port_print_stats(FILE *out)
+{
+    fprintf(out, "%-10s %10s %10s %8s %8s %10s %6s %10s\n",
+            "particao", "lidos", "gravados", "progr.", "setores", "apagados", "ruins", "custo ms");
+    for (int i = 0; i < n_parts; i++) {
+        const host_part_t *hp = &parts[i];
+        if (hp->fd < 0) continue;
+        const host_flash_stats_t *s = &hp->stats;
+        fprintf(out, "%-10s %10llu %10llu %8llu %8llu %10llu %6llu %10.1f\n", hp->part.label,
+                (unsigned long long)s->read_bytes, (unsigned long long)s->write_bytes,
+                (unsigned long long)s->pages_programmed, (unsigned long long)s->erase_ops,
+                (unsigned long long)s->erase_bytes, (unsigned long long)s->bad_writes,
+                host_flash_cost_us(s) / 1000.0);
+    }
+
+    host_nvs_stats_t n;
+    host_nvs_get_stats(&n);
+    fprintf(out, "%-10s %10s %10llu %8llu %8llu %10llu %6s %10.1f\n", "nvs", "-",
+            (unsigned long long)n.write_bytes, (unsigned long long)n.program_ops,
+            (unsigned long long)n.page_erases, (unsigned long long)n.erase_bytes, "-",
+            host_nvs_cost_us(&n) / 1000.0);
+    fprintf(out, "nvs: %llu sets (%llu iguais, sem gravar), %llu apagamentos, %llu commits; "
+            "entradas %u vivas + %u mortas de %u\n",
+            (unsigned long long)n.sets, (unsigned long long)n.sets_skipped, (unsigned long long)n.erases,
+            (unsigned long long)n.commits, n.entries_live, n.entries_dead, n.entries_capacity);
+}
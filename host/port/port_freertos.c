@@ -0,0 +1,395 @@
+// FreeRTOS sobre pthreads: o suficiente para as tasks de main/ (gravação,
+// política) rodarem no PC com a mesma sincronização do firmware.
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+struct host_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+    char name[16];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+};
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t can_send;
+    pthread_cond_t can_recv;
+    uint8_t *buf;
+    UBaseType_t len;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+
+struct host_sem {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    UBaseType_t count;
+    UBaseType_t max;
+};
+
+struct host_event_group {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    EventBits_t bits;
+};
+
+static pthread_mutex_t critical_lock;
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static struct timespec t0;
+static __thread struct host_task *current;
+
+static void init_once(void)
+{
+    pthread_mutexattr_t a;
+    pthread_mutexattr_init(&a);
+    pthread_mutexattr_settype(&a, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&critical_lock, &a);
+    pthread_mutexattr_destroy(&a);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+}
+
+// Condições com relógio monotônico: os prazos não andam com a hora do PC
+static void cond_init(pthread_cond_t *c)
+{
+    pthread_condattr_t a;
+    pthread_condattr_init(&a);
+    pthread_condattr_setclock(&a, CLOCK_MONOTONIC);
+    pthread_cond_init(c, &a);
+    pthread_condattr_destroy(&a);
+}
+
+static struct timespec deadline(TickType_t ticks)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t ns = (uint64_t)ts.tv_nsec + (uint64_t)ticks * (1000000000ULL / configTICK_RATE_HZ);
+    ts.tv_sec += ns / 1000000000ULL;
+    ts.tv_nsec = ns % 1000000000ULL;
+    return ts;
+}
+
+// Espera em cond até pred ou o prazo; lock já adquirido. false = estourou.
+#define WAIT_UNTIL(pred, cond, lock, ticks) ({                                  \
+        bool ok_ = true;                                                        \
+        if (!(pred)) {                                                          \
+            if ((ticks) == 0) {                                                 \
+                ok_ = false;                                                    \
+            } else if ((ticks) == portMAX_DELAY) {                              \
+                while (!(pred)) pthread_cond_wait(cond, lock);                  \
+            } else {                                                            \
+                struct timespec dl_ = deadline(ticks);                          \
+                while (!(pred)) {                                               \
+                    if (pthread_cond_timedwait(cond, lock, &dl_) == ETIMEDOUT) {\
+                        ok_ = (pred);                                           \
+                        break;                                                  \
+                    }                                                           \
+                }                                                               \
+            }                                                                   \
+        }                                                                       \
+        ok_;                                                                    \
+    })
+
+// =====================
+// Seções críticas e tempo
+// =====================
+void host_port_enter_critical(void)
+{
+    pthread_once(&once, init_once);
+    pthread_mutex_lock(&critical_lock);
+}
+
+void host_port_exit_critical(void)
+{
+    pthread_mutex_unlock(&critical_lock);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    pthread_once(&once, init_once);
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t ms = (int64_t)(ts.tv_sec - t0.tv_sec) * 1000 + (ts.tv_nsec - t0.tv_nsec) / 1000000;
+    return (TickType_t)ms;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = {
+        .tv_sec = ticks / configTICK_RATE_HZ,
+        .tv_nsec = (long)(ticks % configTICK_RATE_HZ) * (1000000000L / configTICK_RATE_HZ),
+    };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+// =====================
+// Tasks
+// =====================
+static struct host_task *task_new(const char *name)
+{
+    struct host_task *t = calloc(1, sizeof(*t));
+    if (!t) return NULL;
+    strncpy(t->name, name ? name : "", sizeof(t->name) - 1);
+    pthread_mutex_init(&t->lock, NULL);
+    cond_init(&t->cond);
+    return t;
+}
+
+static void *task_entry(void *p)
+{
+    current = p;
+    current->fn(current->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t prio, TaskHandle_t *out_handle)
+{
+    (void)stack_depth;
+    (void)prio;
+    pthread_once(&once, init_once);
+    struct host_task *t = task_new(name);
+    if (!t) return pdFAIL;
+    t->fn = fn;
+    t->arg = arg;
+    // Como no FreeRTOS, o handle já vale antes de a task rodar
+    if (out_handle) *out_handle = t;
+
+    pthread_attr_t a;
+    pthread_attr_init(&a);
+    pthread_attr_setdetachstate(&a, PTHREAD_CREATE_DETACHED);
+    int rc = pthread_create(&t->thread, &a, task_entry, t);
+    pthread_attr_destroy(&a);
+    if (rc != 0) {
+        if (out_handle) *out_handle = NULL;
+        free(t);
+        return pdFAIL;
+    }
+    pthread_setname_np(t->thread, t->name);
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    // Só a própria task (único uso em main/); o struct fica, pode haver handle guardado
+    if (task == NULL || task == current) pthread_exit(NULL);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (!current) current = task_new("main");     // thread que não veio de xTaskCreate
+    return current;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    struct host_task *t = xTaskGetCurrentTaskHandle();
+    pthread_mutex_lock(&t->lock);
+    WAIT_UNTIL(t->notify > 0, &t->cond, &t->lock, ticks);
+    uint32_t value = t->notify;
+    if (value > 0) t->notify = clear_on_exit ? 0 : value - 1;
+    pthread_mutex_unlock(&t->lock);
+    return value;
+}
+
+// =====================
+// Filas
+// =====================
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *q = calloc(1, sizeof(*q));
+    if (!q) return NULL;
+    q->buf = malloc((size_t)length * item_size);
+    if (!q->buf) {
+        free(q);
+        return NULL;
+    }
+    q->len = length;
+    q->item_size = item_size;
+    pthread_mutex_init(&q->lock, NULL);
+    cond_init(&q->can_send);
+    cond_init(&q->can_recv);
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    if (!q) return;
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->can_send);
+    pthread_cond_destroy(&q->can_recv);
+    free(q->buf);
+    free(q);
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&q->lock);
+    bool ok = WAIT_UNTIL(q->count < q->len, &q->can_send, &q->lock, ticks);
+    if (ok) {
+        UBaseType_t tail = (q->head + q->count) % q->len;
+        memcpy(q->buf + (size_t)tail * q->item_size, item, q->item_size);
+        q->count++;
+        pthread_cond_signal(&q->can_recv);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok ? pdPASS : pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&q->lock);
+    bool ok = WAIT_UNTIL(q->count > 0, &q->can_recv, &q->lock, ticks);
+    if (ok) {
+        memcpy(item, q->buf + (size_t)q->head * q->item_size, q->item_size);
+        q->head = (q->head + 1) % q->len;
+        q->count--;
+        pthread_cond_signal(&q->can_send);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok ? pdPASS : pdFALSE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t n = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+// =====================
+// Semáforos
+// =====================
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial)
+{
+    struct host_sem *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    pthread_mutex_init(&s->lock, NULL);
+    cond_init(&s->cond);
+    s->max = max_count;
+    s->count = initial;
+    return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t s)
+{
+    if (!s) return;
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->cond);
+    free(s);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks)
+{
+    pthread_mutex_lock(&s->lock);
+    bool ok = WAIT_UNTIL(s->count > 0, &s->cond, &s->lock, ticks);
+    if (ok) s->count--;
+    pthread_mutex_unlock(&s->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s)
+{
+    pthread_mutex_lock(&s->lock);
+    bool ok = s->count < s->max;
+    if (ok) {
+        s->count++;
+        pthread_cond_signal(&s->cond);
+    }
+    pthread_mutex_unlock(&s->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+// =====================
+// Grupos de eventos
+// =====================
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    struct host_event_group *g = calloc(1, sizeof(*g));
+    if (!g) return NULL;
+    pthread_mutex_init(&g->lock, NULL);
+    cond_init(&g->cond);
+    return g;
+}
+
+void vEventGroupDelete(EventGroupHandle_t g)
+{
+    if (!g) return;
+    pthread_mutex_destroy(&g->lock);
+    pthread_cond_destroy(&g->cond);
+    free(g);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t g, EventBits_t bits)
+{
+    pthread_mutex_lock(&g->lock);
+    g->bits |= bits;
+    EventBits_t now = g->bits;
+    pthread_cond_broadcast(&g->cond);
+    pthread_mutex_unlock(&g->lock);
+    return now;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t g, EventBits_t bits)
+{
+    pthread_mutex_lock(&g->lock);
+    EventBits_t before = g->bits;
+    g->bits &= ~bits;
+    pthread_mutex_unlock(&g->lock);
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t g)
+{
+    pthread_mutex_lock(&g->lock);
+    EventBits_t now = g->bits;
+    pthread_mutex_unlock(&g->lock);
+    return now;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t g, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_all, TickType_t ticks)
+{
+    pthread_mutex_lock(&g->lock);
+#define BITS_READY (wait_all ? (g->bits & bits) == bits : (g->bits & bits) != 0)
+    bool ok = WAIT_UNTIL(BITS_READY, &g->cond, &g->lock, ticks);
+#undef BITS_READY
+    EventBits_t value = g->bits;
+    if (ok && clear_on_exit) g->bits &= ~bits;
+    pthread_mutex_unlock(&g->lock);
+    return value;
+}
@@ -0,0 +1,8 @@
+#pragma once
+// Ligação entre port_flash.c (tabela de partições) e port_nvs.c
+
+#include <stdint.h>
+#include "esp_err.h"
+
+esp_err_t host_nvs_setup(const char *dir, uint32_t partition_size);
+void host_nvs_reset_stats(void);
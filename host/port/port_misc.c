@@ -0,0 +1,182 @@
+// esp_timer, log, nomes de erro, CRC da ROM e o resto miúdo do IDF no PC.
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/random.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "host_port.h"
+#include "nvs.h"
+
+// =====================
+// esp_timer
+// =====================
+static int64_t mono_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t boot_us;
+
+__attribute__((constructor)) static void timer_boot(void)
+{
+    boot_us = mono_us();
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return mono_us() - boot_us;
+}
+
+// =====================
+// esp_random
+// =====================
+uint32_t esp_random(void)
+{
+    uint32_t r = 0;
+    if (getrandom(&r, sizeof(r), 0) != sizeof(r)) r = (uint32_t)mono_us() * 2654435761u;
+    return r;
+}
+
+// =====================
+// Relógio de parede
+// =====================
+// time_service acerta a hora do sistema ao sincronizar com o coordenador.
+// No PC isso mudaria o relógio da máquina (ou falharia sem root): a hora
+// pedida só vira um deslocamento consultável por host_port_wall_offset_us.
+static int64_t wall_offset_us;
+
+int settimeofday(const struct timeval *tv, const struct timezone *tz)
+{
+    (void)tz;
+    if (!tv) return 0;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    int64_t want = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+    wall_offset_us = want - ((int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000);
+    return 0;
+}
+
+int64_t host_port_wall_offset_us(void)
+{
+    return wall_offset_us;
+}
+
+// =====================
+// Log
+// =====================
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static int log_level = -1;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    (void)tag;      // um nível só para todas as tags
+    log_level = level;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *fmt, ...)
+{
+    if (log_level < 0) {
+        const char *env = getenv("HOST_LOG_LEVEL");
+        log_level = env ? atoi(env) : ESP_LOG_INFO;
+    }
+    if ((int)level > log_level) return;
+
+    static const char letter[] = "NEWIDV";
+    pthread_mutex_lock(&log_lock);
+    fprintf(stderr, "%c (%lld) %s: ", letter[level], (long long)(esp_timer_get_time() / 1000), tag);
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+    pthread_mutex_unlock(&log_lock);
+}
+
+// =====================
+// Nomes de erro
+// =====================
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK:                        return "ESP_OK";
+    case ESP_FAIL:                      return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:                return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:           return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:         return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:          return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:             return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:         return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:               return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE:      return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC:           return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_INVALID_VERSION:       return "ESP_ERR_INVALID_VERSION";
+    case ESP_ERR_NVS_NOT_INITIALIZED:   return "ESP_ERR_NVS_NOT_INITIALIZED";
+    case ESP_ERR_NVS_NOT_FOUND:         return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_NVS_TYPE_MISMATCH:     return "ESP_ERR_NVS_TYPE_MISMATCH";
+    case ESP_ERR_NVS_READ_ONLY:         return "ESP_ERR_NVS_READ_ONLY";
+    case ESP_ERR_NVS_NOT_ENOUGH_SPACE:  return "ESP_ERR_NVS_NOT_ENOUGH_SPACE";
+    case ESP_ERR_NVS_INVALID_NAME:      return "ESP_ERR_NVS_INVALID_NAME";
+    case ESP_ERR_NVS_INVALID_HANDLE:    return "ESP_ERR_NVS_INVALID_HANDLE";
+    case ESP_ERR_NVS_KEY_TOO_LONG:      return "ESP_ERR_NVS_KEY_TOO_LONG";
+    case ESP_ERR_NVS_INVALID_LENGTH:    return "ESP_ERR_NVS_INVALID_LENGTH";
+    case ESP_ERR_NVS_NO_FREE_PAGES:     return "ESP_ERR_NVS_NO_FREE_PAGES";
+    case ESP_ERR_NVS_VALUE_TOO_LONG:    return "ESP_ERR_NVS_VALUE_TOO_LONG";
+    case ESP_ERR_NVS_NEW_VERSION_FOUND: return "ESP_ERR_NVS_NEW_VERSION_FOUND";
+    default:                            return "UNKNOWN ERROR";
+    }
+}
+
+// =====================
+// CRC (mesma convenção da ROM: ~crc na entrada e na saída)
+// =====================
+static uint32_t crc32_table[256];
+
+__attribute__((constructor)) static void crc32_build(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        crc32_table[i] = c;
+    }
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--) crc = crc32_table[(crc ^ *buf++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+uint8_t esp_rom_crc8_le(uint8_t crc, const uint8_t *buf, uint32_t len)
+{
+    // x^8 + x^2 + x + 1, refletido
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int k = 0; k < 8; k++) crc = (crc & 1) ? (uint8_t)((crc >> 1) ^ 0xE0) : (uint8_t)(crc >> 1);
+    }
+    return (uint8_t)~crc;
+}
+
+// =====================
+// HTTP
+// =====================
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    (void)r;
+    (void)buf;
+    (void)buf_len;
+    return ESP_ERR_NOT_SUPPORTED;
+}
@@ -0,0 +1,532 @@
+// nvs.h do ESP-IDF no PC: chave/valor tipado em RAM, persistido em
+// <dir>/nvs.bin a cada alteração (escrita atômica com rename).
+//
+// O arquivo guarda só os valores; o custo em flash é estimado com o layout
+// do NVS real: entradas de 32 bytes em páginas de 4 KB (126 entradas),
+// valor primitivo = 1 entrada, string = 1 + dados, blob = índice +
+// cabeçalho de cada bloco (até uma página) + dados. Substituir ou apagar
+// deixa a entrada antiga morta até a página ser reciclada; quando as
+// páginas livres acabam (uma fica de reserva, como no IDF), a página com
+// mais entradas mortas é apagada e as vivas são copiadas. Gravar o mesmo
+// valor não custa nada: o IDF compara antes de gravar.
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "host_port.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "port_internal.h"
+
+static const char *TAG = "HOST_NVS";
+
+#define FILE_MAGIC      "HNVS"
+#define FILE_VERSION    1
+#define MAX_NAMESPACES  32
+#define MAX_HANDLES     16
+#define CHUNK_MAX       ((HOST_NVS_ENTRIES_PER_PAGE - 1) * HOST_NVS_ENTRY_SIZE)  // dados por página
+#define MAX_STR_SIZE    4000
+#define MAX_ITEM_SIZE   (1u << 20)  // sanidade na leitura do arquivo
+
+// Mesmos códigos de tipo do NVS
+typedef enum {
+    T_U8 = 0x01, T_I8 = 0x11, T_U16 = 0x02, T_I16 = 0x12,
+    T_U32 = 0x04, T_I32 = 0x14, T_U64 = 0x08, T_I64 = 0x18,
+    T_STR = 0x21, T_BLOB = 0x42,
+} item_type_t;
+
+typedef struct {
+    uint8_t ns;
+    uint8_t type;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    uint32_t len;
+    uint8_t *data;
+} item_t;
+
+typedef struct {
+    bool used;
+    uint8_t ns;
+    nvs_open_mode_t mode;
+} handle_t;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static char path[512];
+static bool initialized;
+
+static char namespaces[MAX_NAMESPACES][NVS_KEY_NAME_MAX_SIZE];
+static int n_namespaces;
+static item_t *items;
+static int n_items, cap_items;
+static handle_t handles[MAX_HANDLES];
+
+static uint32_t capacity;           // entradas em todas as páginas menos a reserva
+static uint32_t used;               // ocupadas (vivas + mortas)
+static uint32_t dead;
+static host_nvs_stats_t stats;
+
+// =====================
+// Contabilidade
+// =====================
+static uint32_t entries_for(uint8_t type, uint32_t len)
+{
+    uint32_t data = (len + HOST_NVS_ENTRY_SIZE - 1) / HOST_NVS_ENTRY_SIZE;
+    if (type == T_STR) return 1 + data;
+    if (type == T_BLOB) {
+        // Blob longo é dividido em blocos de até uma página, cada um com cabeçalho
+        uint32_t chunks = len ? (len + CHUNK_MAX - 1) / CHUNK_MAX : 1;
+        return 1 + chunks + data;
+    }
+    return 1;
+}
+
+static void account_write(uint32_t n)
+{
+    stats.entries_written += n;
+    stats.write_bytes += (uint64_t)n * HOST_NVS_ENTRY_SIZE;
+    stats.program_ops += 2 * (uint64_t)n;     // entrada + estado no bitmap da página
+}
+
+// Recicla páginas até caber "need" entradas novas
+static esp_err_t make_room(uint32_t need)
+{
+    while (used + need > capacity) {
+        if (dead == 0) return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        uint32_t freed = dead < HOST_NVS_ENTRIES_PER_PAGE ? dead : HOST_NVS_ENTRIES_PER_PAGE;
+        account_write(HOST_NVS_ENTRIES_PER_PAGE - freed);      // vivas copiadas
+        stats.page_erases++;
+        stats.erase_bytes += 4096;
+        used -= freed;
+        dead -= freed;
+    }
+    return ESP_OK;
+}
+
+static void account_dead(uint32_t n)
+{
+    dead += n;
+    stats.program_ops += n;
+}
+
+// =====================
+// Arquivo
+// =====================
+static esp_err_t save(void)
+{
+    char tmp[520];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) return ESP_FAIL;
+
+    uint32_t hdr[5] = { FILE_VERSION, used, dead, (uint32_t)n_namespaces, (uint32_t)n_items };
+    bool ok = fwrite(FILE_MAGIC, 4, 1, f) == 1 && fwrite(hdr, sizeof(hdr), 1, f) == 1 &&
+              fwrite(namespaces, NVS_KEY_NAME_MAX_SIZE, n_namespaces, f) == (size_t)n_namespaces;
+    for (int i = 0; ok && i < n_items; i++) {
+        const item_t *it = &items[i];
+        ok = fwrite(it, offsetof(item_t, data), 1, f) == 1 && fwrite(it->data, 1, it->len, f) == it->len;
+    }
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        ESP_LOGE(TAG, "Falha ao gravar %s", path);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static void clear_all(void)
+{
+    for (int i = 0; i < n_items; i++) free(items[i].data);
+    free(items);
+    items = NULL;
+    n_items = cap_items = 0;
+    n_namespaces = 0;
+    used = dead = 0;
+}
+
+static esp_err_t load(void)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return ESP_OK;          // primeira execução: NVS vazio
+
+    char magic[4];
+    uint32_t hdr[5];
+    esp_err_t err = ESP_ERR_NVS_NEW_VERSION_FOUND;
+    if (fread(magic, 4, 1, f) != 1 || memcmp(magic, FILE_MAGIC, 4) != 0 ||
+        fread(hdr, sizeof(hdr), 1, f) != 1 || hdr[0] != FILE_VERSION || hdr[3] > MAX_NAMESPACES) {
+        goto out;
+    }
+    used = hdr[1];
+    dead = hdr[2];
+    n_namespaces = (int)hdr[3];
+    if (fread(namespaces, NVS_KEY_NAME_MAX_SIZE, n_namespaces, f) != (size_t)n_namespaces) goto out;
+
+    items = calloc(hdr[4] ? hdr[4] : 1, sizeof(item_t));
+    if (!items) {
+        err = ESP_ERR_NO_MEM;
+        goto out;
+    }
+    cap_items = hdr[4];
+    for (uint32_t i = 0; i < hdr[4]; i++) {
+        item_t *it = &items[n_items];
+        if (fread(it, offsetof(item_t, data), 1, f) != 1 || it->len > MAX_ITEM_SIZE) goto out;
+        it->data = malloc(it->len ? it->len : 1);
+        if (!it->data || fread(it->data, 1, it->len, f) != it->len) {
+            free(it->data);
+            goto out;
+        }
+        n_items++;
+    }
+    err = ESP_OK;
+out:
+    fclose(f);
+    // Arquivo de outra versão ou corrompido: o chamador apaga e reinicia,
+    // como com ESP_ERR_NVS_NEW_VERSION_FOUND no chip
+    if (err != ESP_OK) clear_all();
+    return err;
+}
+
+esp_err_t host_nvs_setup(const char *dir, uint32_t partition_size)
+{
+    snprintf(path, sizeof(path), "%s/nvs.bin", dir);
+    uint32_t pages = partition_size / 4096;
+    capacity = pages > 1 ? (pages - 1) * HOST_NVS_ENTRIES_PER_PAGE : 0;
+    return capacity ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+void host_nvs_reset_stats(void)
+{
+    pthread_mutex_lock(&lock);
+    memset(&stats, 0, sizeof(stats));
+    pthread_mutex_unlock(&lock);
+}
+
+void host_nvs_get_stats(host_nvs_stats_t *out)
+{
+    pthread_mutex_lock(&lock);
+    *out = stats;
+    out->entries_live = used - dead;
+    out->entries_dead = dead;
+    out->entries_capacity = capacity;
+    pthread_mutex_unlock(&lock);
+}
+
+uint64_t host_nvs_cost_us(const host_nvs_stats_t *s)
+{
+    // Gravações de entrada são parciais, mas o tempo de programação é
+    // dominado pelo ciclo da página: conta cada uma como uma página
+    return s->page_erases * HOST_FLASH_ERASE_SECTOR_US + s->program_ops * HOST_FLASH_PROGRAM_PAGE_US;
+}
+
+// =====================
+// nvs_flash
+// =====================
+esp_err_t nvs_flash_init(void)
+{
+    if (path[0] == '\0') return ESP_ERR_NOT_FOUND;     // host_port_init não chamado
+    pthread_mutex_lock(&lock);
+    esp_err_t err = ESP_OK;
+    if (!initialized) {
+        err = load();
+        initialized = (err == ESP_OK);
+    }
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    if (path[0] == '\0') return ESP_ERR_NOT_FOUND;
+    pthread_mutex_lock(&lock);
+    clear_all();
+    memset(handles, 0, sizeof(handles));
+    initialized = false;
+    uint32_t pages = capacity / HOST_NVS_ENTRIES_PER_PAGE + 1;
+    stats.page_erases += pages;
+    stats.erase_bytes += (uint64_t)pages * 4096;
+    unlink(path);
+    pthread_mutex_unlock(&lock);
+    return ESP_OK;
+}
+
+// =====================
+// Handles
+// =====================
+static handle_t *get_handle(nvs_handle_t h)
+{
+    return (h >= 1 && h <= MAX_HANDLES && handles[h - 1].used) ? &handles[h - 1] : NULL;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (!name || !out_handle) return ESP_ERR_INVALID_ARG;
+    if (strlen(name) >= NVS_KEY_NAME_MAX_SIZE) return ESP_ERR_NVS_KEY_TOO_LONG;
+
+    pthread_mutex_lock(&lock);
+    esp_err_t err = ESP_OK;
+    int ns = -1, slot = -1;
+    if (!initialized) {
+        err = ESP_ERR_NVS_NOT_INITIALIZED;
+        goto out;
+    }
+    for (int i = 0; i < n_namespaces; i++) {
+        if (strcmp(namespaces[i], name) == 0) ns = i;
+    }
+    for (int i = 0; i < MAX_HANDLES && slot < 0; i++) {
+        if (!handles[i].used) slot = i;
+    }
+    if (slot < 0) {
+        err = ESP_ERR_NO_MEM;
+    } else if (ns < 0 && open_mode == NVS_READONLY) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else if (ns < 0 && n_namespaces == MAX_NAMESPACES) {
+        err = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    } else if (ns < 0) {
+        // Namespace novo = uma entrada no namespace 0
+        err = make_room(1);
+        if (err == ESP_OK) {
+            ns = n_namespaces++;
+            snprintf(namespaces[ns], NVS_KEY_NAME_MAX_SIZE, "%s", name);
+            used++;
+            account_write(1);
+            err = save();
+        }
+    }
+    if (err == ESP_OK) {
+        handles[slot] = (handle_t){ .used = true, .ns = (uint8_t)ns, .mode = open_mode };
+        *out_handle = (nvs_handle_t)(slot + 1);
+    }
+out:
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+void nvs_close(nvs_handle_t h)
+{
+    pthread_mutex_lock(&lock);
+    handle_t *hd = get_handle(h);
+    if (hd) hd->used = false;
+    pthread_mutex_unlock(&lock);
+}
+
+esp_err_t nvs_commit(nvs_handle_t h)
+{
+    // Cada set já foi gravado (como no IDF, onde o commit não faz nada hoje)
+    pthread_mutex_lock(&lock);
+    esp_err_t err = get_handle(h) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+    if (err == ESP_OK) stats.commits++;
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+// =====================
+// Itens
+// =====================
+static int find_item(uint8_t ns, const char *key, int type)
+{
+    for (int i = 0; i < n_items; i++) {
+        if (items[i].ns == ns && (type < 0 || items[i].type == type) && strcmp(items[i].key, key) == 0) return i;
+    }
+    return -1;
+}
+
+static void drop_item(int i)
+{
+    free(items[i].data);
+    items[i] = items[--n_items];
+}
+
+static esp_err_t check_key(const char *key)
+{
+    if (!key) return ESP_ERR_NVS_INVALID_NAME;
+    return strlen(key) < NVS_KEY_NAME_MAX_SIZE ? ESP_OK : ESP_ERR_NVS_KEY_TOO_LONG;
+}
+
+static esp_err_t set_item(nvs_handle_t h, const char *key, uint8_t type, const void *value, size_t len)
+{
+    esp_err_t err = check_key(key);
+    if (err != ESP_OK) return err;
+    if (type == T_STR && len > MAX_STR_SIZE) return ESP_ERR_NVS_VALUE_TOO_LONG;
+    if (entries_for(type, (uint32_t)len) > capacity) return ESP_ERR_NVS_VALUE_TOO_LONG;
+
+    pthread_mutex_lock(&lock);
+    handle_t *hd = get_handle(h);
+    if (!hd) {
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+        goto out;
+    }
+    if (hd->mode == NVS_READONLY) {
+        err = ESP_ERR_NVS_READ_ONLY;
+        goto out;
+    }
+    stats.sets++;
+
+    int i = find_item(hd->ns, key, type);
+    if (i >= 0 && items[i].len == len && memcmp(items[i].data, value, len) == 0) {
+        stats.sets_skipped++;
+        goto out;
+    }
+
+    uint32_t n = entries_for(type, (uint32_t)len);
+    err = make_room(n);
+    if (err != ESP_OK) goto out;
+    uint8_t *data = malloc(len ? len : 1);
+    if (!data) {
+        err = ESP_ERR_NO_MEM;
+        goto out;
+    }
+    memcpy(data, value, len);
+
+    if (i >= 0) {
+        account_dead(entries_for(items[i].type, items[i].len));
+        free(items[i].data);
+    } else {
+        if (n_items == cap_items) {
+            int cap = cap_items ? cap_items * 2 : 32;
+            item_t *grown = realloc(items, (size_t)cap * sizeof(item_t));
+            if (!grown) {
+                free(data);
+                err = ESP_ERR_NO_MEM;
+                goto out;
+            }
+            items = grown;
+            cap_items = cap;
+        }
+        i = n_items++;
+        memset(&items[i], 0, sizeof(items[i]));
+        items[i].ns = hd->ns;
+        items[i].type = type;
+        snprintf(items[i].key, sizeof(items[i].key), "%s", key);
+    }
+    items[i].data = data;
+    items[i].len = (uint32_t)len;
+    used += n;
+    account_write(n);
+    err = save();
+out:
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+// Primitivos: *length NULL; str/blob: buffer NULL devolve o tamanho
+static esp_err_t get_item(nvs_handle_t h, const char *key, uint8_t type, void *out, size_t *length)
+{
+    esp_err_t err = check_key(key);
+    if (err != ESP_OK) return err;
+
+    pthread_mutex_lock(&lock);
+    handle_t *hd = get_handle(h);
+    int i = hd ? find_item(hd->ns, key, type) : -1;
+    if (!hd) {
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    } else if (i < 0) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else if (!length) {
+        memcpy(out, items[i].data, items[i].len);
+    } else if (!out) {
+        *length = items[i].len;
+    } else if (*length < items[i].len) {
+        *length = items[i].len;
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    } else {
+        memcpy(out, items[i].data, items[i].len);
+        *length = items[i].len;
+    }
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t h, const char *key)
+{
+    esp_err_t err = check_key(key);
+    if (err != ESP_OK) return err;
+
+    pthread_mutex_lock(&lock);
+    handle_t *hd = get_handle(h);
+    int i = hd ? find_item(hd->ns, key, -1) : -1;
+    if (!hd) {
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    } else if (hd->mode == NVS_READONLY) {
+        err = ESP_ERR_NVS_READ_ONLY;
+    } else if (i < 0) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else {
+        stats.erases++;
+        account_dead(entries_for(items[i].type, items[i].len));
+        drop_item(i);
+        err = save();
+    }
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t h)
+{
+    pthread_mutex_lock(&lock);
+    handle_t *hd = get_handle(h);
+    esp_err_t err = ESP_OK;
+    if (!hd) {
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    } else if (hd->mode == NVS_READONLY) {
+        err = ESP_ERR_NVS_READ_ONLY;
+    } else {
+        for (int i = n_items - 1; i >= 0; i--) {
+            if (items[i].ns != hd->ns) continue;
+            stats.erases++;
+            account_dead(entries_for(items[i].type, items[i].len));
+            drop_item(i);
+        }
+        err = save();
+    }
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+#define NVS_PRIMITIVE(suffix, ctype, code)                                          \
+    esp_err_t nvs_set_##suffix(nvs_handle_t h, const char *key, ctype value)        \
+    {                                                                               \
+        return set_item(h, key, code, &value, sizeof(value));                       \
+    }                                                                               \
+    esp_err_t nvs_get_##suffix(nvs_handle_t h, const char *key, ctype *out_value)   \
+    {                                                                               \
+        if (!out_value) return ESP_ERR_INVALID_ARG;                                 \
+        return get_item(h, key, code, out_value, NULL);                             \
+    }
+
+NVS_PRIMITIVE(u8, uint8_t, T_U8)
+NVS_PRIMITIVE(i8, int8_t, T_I8)
+NVS_PRIMITIVE(u16, uint16_t, T_U16)
+NVS_PRIMITIVE(i16, int16_t, T_I16)
+NVS_PRIMITIVE(u32, uint32_t, T_U32)
+NVS_PRIMITIVE(i32, int32_t, T_I32)
+NVS_PRIMITIVE(u64, uint64_t, T_U64)
+NVS_PRIMITIVE(i64, int64_t, T_I64)
+
+esp_err_t nvs_set_str(nvs_handle_t h, const char *key, const char *value)
+{
+    if (!value) return ESP_ERR_INVALID_ARG;
+    return set_item(h, key, T_STR, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *value, size_t length)
+{
+    if (!value && length) return ESP_ERR_INVALID_ARG;
+    return set_item(h, key, T_BLOB, value ? value : "", length);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t h, const char *key, char *out_value, size_t *length)
+{
+    if (!length) return ESP_ERR_INVALID_ARG;
+    return get_item(h, key, T_STR, out_value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out_value, size_t *length)
+{
+    if (!length) return ESP_ERR_INVALID_ARG;
+    return get_item(h, key, T_BLOB, out_value, length);
+}
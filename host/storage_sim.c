@@ -0,0 +1,260 @@
+// Roda o núcleo do firmware (rfid_storage, access_policy, time_service)
+// no PC sobre o backend de host/port e mostra quanto de flash cada fase
+// gasta: cadastro de usuários, passagens de cartão com log, remoções.
+//
+//   ./build-host/storage_sim --fresh --users 50 --swipes 5000
+//
+// O estado fica em --dir (partições e NVS em arquivo): rodar de novo sem
+// --fresh equivale a um reboot, com a recuperação do journal e do WAL e a
+// ACL de boot gravada no fim da execução anterior.
+
+#include <dirent.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "access_policy.h"
+#include "esp_timer.h"
+#include "fast_boot.h"
+#include "host_port.h"
+#include "mem_budget.h"
+#include "rfid_storage.h"
+#include "time_service.h"
+#include "wiegand_format.h"
+
+typedef struct {
+    const char *dir;
+    int users;
+    int swipes;
+    int unknown_pct;
+    unsigned seed;
+    int window_ms;
+    bool fresh;
+} sim_cfg_t;
+
+static uint64_t rng_state;
+
+static uint64_t rnd64(void)
+{
+    // xorshift64*, igual ao wiegand_sim
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ULL;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void remove_state(const char *dir)
+{
+    DIR *d = opendir(dir);
+    if (!d) return;
+    struct dirent *e;
+    char path[512];
+    while ((e = readdir(d)) != NULL) {
+        size_t n = strlen(e->d_name);
+        if (n > 4 && strcmp(e->d_name + n - 4, ".bin") == 0) {
+            snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+            unlink(path);
+        }
+    }
+    closedir(d);
+}
+
+static void report(const char *phase, double elapsed_ns, int ops)
+{
+    printf("\n== %s: %d operacoes, %.1f ms no PC (%.2f us/op)\n", phase, ops, elapsed_ns / 1e6,
+           ops ? elapsed_ns / 1e3 / ops : 0.0);
+    host_port_print_stats(stdout);
+    host_port_reset_stats();
+}
+
+static void wait_durable(rfid_ticket_t ticket)
+{
+    if (ticket && rfid_storage_wait(ticket, 10000) != ESP_OK) {
+        fprintf(stderr, "ticket %lu nao ficou duravel\n", (unsigned long)ticket);
+        exit(1);
+    }
+}
+
+static void usage(const char *argv0)
+{
+    printf("uso: %s [opcoes]\n"
+           "  --dir DIR        estado em arquivo (padrao sim-data)\n"
+           "  --fresh          apaga o estado antes (flash nova)\n"
+           "  --users N        usuarios cadastrados (padrao 40, max %d)\n"
+           "  --swipes N       passagens de cartao (padrao 2000)\n"
+           "  --unknown PCT    %% de cartoes desconhecidos (padrao 20)\n"
+           "  --window MS      janela de gravacao em grupo (padrao %d)\n"
+           "  --seed N\n",
+           argv0, MAX_USERS, RFID_COMMIT_WINDOW_MS);
+}
+
+int main(int argc, char **argv)
+{
+    sim_cfg_t cfg = {
+        .dir = "sim-data",
+        .users = 40,
+        .swipes = 2000,
+        .unknown_pct = 20,
+        .seed = 1,
+        .window_ms = RFID_COMMIT_WINDOW_MS,
+    };
+    static const struct option opts[] = {
+        { "dir", required_argument, NULL, 'd' },
+        { "fresh", no_argument, NULL, 'f' },
+        { "users", required_argument, NULL, 'u' },
+        { "swipes", required_argument, NULL, 's' },
+        { "unknown", required_argument, NULL, 'k' },
+        { "window", required_argument, NULL, 'w' },
+        { "seed", required_argument, NULL, 'r' },
+        { "help", no_argument, NULL, 'h' },
+        { 0 },
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "d:fu:s:k:w:r:h", opts, NULL)) != -1) {
+        switch (c) {
+        case 'd': cfg.dir = optarg; break;
+        case 'f': cfg.fresh = true; break;
+        case 'u': cfg.users = atoi(optarg); break;
+        case 's': cfg.swipes = atoi(optarg); break;
+        case 'k': cfg.unknown_pct = atoi(optarg); break;
+        case 'w': cfg.window_ms = atoi(optarg); break;
+        case 'r': cfg.seed = (unsigned)strtoul(optarg, NULL, 0); break;
+        default: usage(argv[0]); return c == 'h' ? 0 : 2;
+        }
+    }
+    if (cfg.users < 1 || cfg.users > MAX_USERS) cfg.users = MAX_USERS;
+    rng_state = 0x9E3779B97F4A7C15ULL ^ cfg.seed;
+
+    if (cfg.fresh) remove_state(cfg.dir);
+    ESP_ERROR_CHECK(host_port_init(cfg.dir, NULL));
+
+    const wg_format_t *fmt = wg_format_for_length(26);
+    wg_credential_t *creds = calloc((size_t)cfg.users, sizeof(wg_credential_t));
+    if (!creds) return 2;
+    for (int i = 0; i < cfg.users; i++) {
+        wg_decode(wg_encode(fmt, 100, (uint32_t)(1000 + i)), 26, &creds[i]);
+    }
+
+    // Mesma ordem de main.c: ACL de boot, depois as tabelas completas
+    double t0 = now_ns();
+    bool boot_acl = fast_boot_load_acl() == ESP_OK;
+    report("acl de boot", now_ns() - t0, 1);
+
+    t0 = now_ns();
+    ESP_ERROR_CHECK(rfid_storage_init());
+    ESP_ERROR_CHECK(time_service_init());
+    ESP_ERROR_CHECK(access_policy_init());
+    ESP_ERROR_CHECK(rfid_storage_set_commit_window((uint32_t)cfg.window_ms, RFID_COMMIT_MAX_RECORDS));
+    report("boot", now_ns() - t0, 1);
+    mem_budget_report();
+
+    // Sem hora as duas fontes têm de decidir igual (cartões deste --seed e desconhecidos)
+    if (boot_acl) {
+        int diff = 0;
+        for (int i = 0; i < cfg.users + 100; i++) {
+            wg_credential_t cred = i < cfg.users ? creds[i] : (wg_credential_t){ 0 };
+            if (i >= cfg.users) wg_decode(wg_encode(fmt, 100, 50000 + (uint32_t)i), 26, &cred);
+            char uid[MAX_UID_LEN];
+            wg_credential_to_str(&cred, uid, sizeof(uid));
+            for (uint8_t d = 0; d < POLICY_MAX_DOORS; d++) {
+                bool full = rfid_is_user_authorized(uid) && access_policy_check(uid, d, false, 0);
+                diff += fast_boot_acl_check(uid, d) != full;
+            }
+        }
+        printf("ACL de boot x tabelas completas: %d divergencias\n", diff);
+        fast_boot_acl_release();
+    }
+
+    // Hora conhecida, como depois da primeira sincronização Zigbee
+    time_service_sync((uint32_t)time(NULL), esp_timer_get_time());
+
+    // Cadastro
+    t0 = now_ns();
+    rfid_ticket_t ticket = 0;
+    for (int i = 0; i < cfg.users; i++) {
+        char uid[MAX_UID_LEN], name[MAX_NAME_LEN];
+        wg_credential_to_str(&creds[i], uid, sizeof(uid));
+        snprintf(name, sizeof(name), "Usuario %d", i);
+        esp_err_t err = rfid_add_user(uid, name, &ticket);
+        if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+            fprintf(stderr, "rfid_add_user(%s): %s\n", uid, esp_err_to_name(err));
+            return 1;
+        }
+    }
+    wait_durable(ticket);
+    report("cadastro", now_ns() - t0, cfg.users);
+
+    // Passagens: decodificação, consulta, política e log, como no pipeline
+    t0 = now_ns();
+    double decide_ns = 0;
+    int granted = 0;
+    ticket = 0;
+    for (int i = 0; i < cfg.swipes; i++) {
+        bool unknown = (int)(rnd64() % 100) < cfg.unknown_pct;
+        uint32_t card = unknown ? 50000 + (uint32_t)(rnd64() % 10000) : 1000 + (uint32_t)(rnd64() % cfg.users);
+        uint8_t door = (uint8_t)(rnd64() % POLICY_MAX_DOORS);
+
+        double d0 = now_ns();
+        wg_credential_t cred;
+        wg_decode(wg_encode(fmt, 100, card), 26, &cred);
+        char uid[MAX_UID_LEN];
+        wg_credential_to_str(&cred, uid, sizeof(uid));
+        uint32_t now_unix = 0;
+        bool now_valid = time_service_to_unix(esp_timer_get_time(), &now_unix);
+        bool ok = rfid_is_user_authorized(uid) && access_policy_check(uid, door, now_valid, now_unix);
+        decide_ns += now_ns() - d0;
+        granted += ok;
+
+        rfid_log_t log = {
+            .cred = cred.id,
+            .time = now_unix,
+            .count = 1,
+            .decision = ok ? RFID_LOG_GRANTED : RFID_LOG_DENIED,
+            .reader = door,
+            .time_valid = now_valid,
+        };
+        if (rfid_add_log(&log, &ticket) != ESP_OK) {
+            fprintf(stderr, "rfid_add_log falhou na passagem %d\n", i);
+            return 1;
+        }
+    }
+    wait_durable(ticket);
+    report("passagens", now_ns() - t0, cfg.swipes);
+    printf("liberadas %d de %d; decisao %.0f ns/passagem no PC\n", granted, cfg.swipes,
+           cfg.swipes ? decide_ns / cfg.swipes : 0.0);
+
+    // Remoção de metade dos usuários
+    t0 = now_ns();
+    ticket = 0;
+    int removed = 0;
+    for (int i = 0; i < cfg.users; i += 2) {
+        char uid[MAX_UID_LEN];
+        wg_credential_to_str(&creds[i], uid, sizeof(uid));
+        if (rfid_remove_user(uid, &ticket) == ESP_OK) removed++;
+    }
+    wait_durable(ticket);
+    report("remocao", now_ns() - t0, removed);
+
+    // O que a task de regravação faria: ACL de boot para a próxima execução
+    t0 = now_ns();
+    ESP_ERROR_CHECK(fast_boot_save_acl());
+    report("gravacao da acl de boot", now_ns() - t0, 1);
+
+    rfid_durability_t dur;
+    rfid_storage_get_durability(&dur);
+    printf("\ncommits %lu, registros %lu, maior lote %lu, erros %lu; log seq [%lu, %lu)\n",
+           (unsigned long)dur.commits, (unsigned long)dur.records, (unsigned long)dur.max_batch,
+           (unsigned long)dur.errors, (unsigned long)rfid_log_first_seq(), (unsigned long)rfid_log_next_seq());
+    free(creds);
+    return 0;
+}
@@ -0,0 +1,514 @@
+// Simulador de sinal Wiegand e benchmark de latência de leitura.
+//
+// Alimenta traços de bordas D0/D1 (sintetizados ou gravados) no mesmo código
+// de captura e decodificação do firmware (wiegand_capture.h, wiegand_format.c)
+// e mede:
+//   - vazão de decodificação (bordas e quadros por segundo no PC);
+//   - taxa de erro de quadro (perdidos, rejeitados, aceitos com valor errado);
+//   - latência de fim de quadro (última borda -> quadro fechado), em tempo
+//     simulado, modelando o despertar da tarefa decodificadora.
+//
+// O modo --fuzz gera quadros malformados e verifica invariantes do decodificador.
+//
+// Formato de traço (--trace / --dump): uma borda de descida por linha,
+//   <tempo_us> <linha>      linha 0 = D0, 1 = D1; '#' inicia comentário
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "wiegand_capture.h"
+#include "wiegand_format.h"
+
+typedef struct {
+    int64_t t_us;
+    uint8_t line;
+} edge_t;
+
+// Quadro gerado: o que o leitor "enviou"
+typedef struct {
+    uint64_t bits;
+    uint8_t  nbits;
+    int64_t  t_first_us;
+    int64_t  t_last_us;
+    int      matched;
+} sent_t;
+
+typedef struct {
+    int      frames;
+    int      format;        // 0 = mistura de todos os formatos
+    int64_t  pulse_us;      // largura do pulso em 0
+    int64_t  gap_us;        // intervalo entre o fim de um pulso e o próximo
+    int64_t  jitter_us;     // +/- por borda
+    int64_t  frame_gap_us;  // pausa entre quadros (pequena = back-to-back)
+    double   noise;         // pulsos espúrios por quadro (média)
+    double   drop;          // probabilidade de perder uma borda
+    int64_t  tick_us;       // 0 = despertar exato (esp_timer); >0 = tick do FreeRTOS
+    int64_t  sched_us;      // atraso de escalonamento da tarefa
+    unsigned seed;
+    const char *trace;
+    const char *dump;
+    int      fuzz;
+} sim_cfg_t;
+
+static const uint8_t all_lengths[] = { 26, 34, 35, 37, 48 };
+
+// ====================== Utilitários ======================
+
+static uint64_t rng_state;
+
+static uint64_t rnd64(void)
+{
+    // xorshift64*: reprodutível entre plataformas, ao contrário de rand()
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ULL;
+}
+
+static uint32_t rnd_below(uint32_t n)
+{
+    return n ? (uint32_t)(rnd64() % n) : 0;
+}
+
+static double rnd_unit(void)
+{
+    return (double)(rnd64() >> 11) / (double)(1ULL << 53);
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int cmp_edge(const void *a, const void *b)
+{
+    const edge_t *x = a, *y = b;
+    return (x->t_us > y->t_us) - (x->t_us < y->t_us);
+}
+
+static int cmp_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    edge_t *v;
+    size_t n, cap;
+} edge_vec_t;
+
+static void push_edge(edge_vec_t *ev, int64_t t, uint8_t line)
+{
+    if (ev->n == ev->cap) {
+        ev->cap = ev->cap ? ev->cap * 2 : 1024;
+        ev->v = realloc(ev->v, ev->cap * sizeof(edge_t));
+        if (!ev->v) { perror("realloc"); exit(2); }
+    }
+    ev->v[ev->n].t_us = t;
+    ev->v[ev->n].line = line;
+    ev->n++;
+}
+
+// ====================== Geração de traços ======================
+
+static sent_t *synthesize(const sim_cfg_t *cfg, edge_vec_t *ev)
+{
+    sent_t *sent = calloc((size_t)cfg->frames, sizeof(sent_t));
+    if (!sent) { perror("calloc"); exit(2); }
+
+    int64_t period = cfg->pulse_us + cfg->gap_us;
+    int64_t t = 10000;
+
+    for (int f = 0; f < cfg->frames; f++) {
+        uint8_t len = cfg->format ? (uint8_t)cfg->format
+                                  : all_lengths[rnd_below(sizeof(all_lengths))];
+        const wg_format_t *fmt = wg_format_for_length(len);
+        uint64_t bits = wg_encode(fmt, (uint32_t)rnd64(), (uint32_t)rnd64());
+        if (fmt->id == WG_FMT_RAW) {
+            bits = rnd64() & ((1ULL << len) - 1);
+        }
+
+        sent_t *s = &sent[f];
+        s->bits = bits;
+        s->nbits = len;
+        for (int i = 0; i < len; i++) {
+            int64_t te = t + (int64_t)i * period;
+            if (cfg->jitter_us) {
+                te += (int64_t)rnd_below((uint32_t)(2 * cfg->jitter_us + 1)) - cfg->jitter_us;
+            }
+            if (i == 0) s->t_first_us = te;
+            s->t_last_us = te;
+            if (cfg->drop > 0 && rnd_unit() < cfg->drop) continue;
+            push_edge(ev, te, (uint8_t)((bits >> (len - 1 - i)) & 1));
+        }
+
+        // Ruído: pulsos curtos em qualquer linha, dentro do quadro ou logo depois
+        int64_t span = (int64_t)len * period + cfg->frame_gap_us / 2;
+        double n_noise = cfg->noise;
+        while (n_noise > 0) {
+            if (n_noise >= 1 || rnd_unit() < n_noise) {
+                push_edge(ev, t + (int64_t)rnd_below((uint32_t)span), (uint8_t)rnd_below(2));
+            }
+            n_noise -= 1;
+        }
+
+        t = s->t_last_us + cfg->frame_gap_us;
+    }
+
+    qsort(ev->v, ev->n, sizeof(edge_t), cmp_edge);
+    return sent;
+}
+
+static int load_trace(const char *path, edge_vec_t *ev)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp) { perror(path); return -1; }
+
+    char line[128];
+    while (fgets(line, sizeof(line), fp)) {
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        long long t;
+        int d;
+        if (sscanf(line, "%lld %d", &t, &d) == 2 && (d == 0 || d == 1)) {
+            push_edge(ev, (int64_t)t, (uint8_t)d);
+        }
+    }
+    fclose(fp);
+    qsort(ev->v, ev->n, sizeof(edge_t), cmp_edge);
+    return 0;
+}
+
+static void dump_trace(const char *path, const edge_vec_t *ev)
+{
+    FILE *fp = fopen(path, "w");
+    if (!fp) { perror(path); return; }
+    fprintf(fp, "# t_us linha\n");
+    for (size_t i = 0; i < ev->n; i++) {
+        fprintf(fp, "%" PRId64 " %u\n", ev->v[i].t_us, ev->v[i].line);
+    }
+    fclose(fp);
+}
+
+// ====================== Simulação ======================
+
+typedef struct {
+    int decoded, bad_length, bad_parity, overflow;
+    int correct, wrong, missed;
+    int closed_by_isr;
+    int64_t *lat;           // latência de fim de quadro dos quadros decodificados
+    int n_lat;
+} sim_stats_t;
+
+// Procura o quadro enviado que contém a última borda recebida
+static sent_t *match_sent(sent_t *sent, int n_sent, int *cursor, int64_t t_last)
+{
+    while (*cursor < n_sent && sent[*cursor].t_last_us < t_last - 1) (*cursor)++;
+    for (int i = *cursor; i < n_sent && i <= *cursor + 1; i++) {
+        if (t_last >= sent[i].t_first_us - 1 && !sent[i].matched) return &sent[i];
+    }
+    return NULL;
+}
+
+static void on_frame(const wg_frame_t *fr, int64_t t_detect, sim_stats_t *st,
+                     sent_t *sent, int n_sent, int *cursor)
+{
+    wg_credential_t cred;
+    if (fr->nbits > WG_MAX_BITS) {
+        st->overflow++;
+        return;
+    }
+    wg_decode_result_t res = wg_decode(fr->bits, fr->nbits, &cred);
+    if (res == WG_DECODE_BAD_LENGTH) { st->bad_length++; return; }
+    if (res == WG_DECODE_BAD_PARITY) { st->bad_parity++; return; }
+
+    st->decoded++;
+    st->lat[st->n_lat++] = t_detect - fr->t_last_us;
+
+    if (!sent) return;
+    sent_t *s = match_sent(sent, n_sent, cursor, fr->t_last_us);
+    if (s && s->nbits == fr->nbits && s->bits == fr->bits) {
+        s->matched = 1;
+        st->correct++;
+    } else {
+        st->wrong++;    // aceito com valor diferente do enviado: o pior caso
+    }
+}
+
+// Momento em que a tarefa acorda para um prazo: exato ou no próximo tick
+static int64_t wake_at(const sim_cfg_t *cfg, int64_t deadline)
+{
+    int64_t w = deadline;
+    if (cfg->tick_us > 0) {
+        w = (deadline + cfg->tick_us - 1) / cfg->tick_us * cfg->tick_us;
+    }
+    return w + cfg->sched_us;
+}
+
+static void simulate(const sim_cfg_t *cfg, const edge_vec_t *ev, sent_t *sent, int n_sent,
+                     sim_stats_t *st, double *wall_s)
+{
+    wg_capture_t cap;
+    wg_capture_init(&cap, WG_FRAME_GAP_US);
+    wg_frame_t fr;
+    int cursor = 0;
+    int64_t deadline;
+
+    double t0 = now_s();
+    for (size_t i = 0; i <= ev->n; i++) {
+        int64_t te = (i < ev->n) ? ev->v[i].t_us : INT64_MAX;
+
+        // A tarefa acorda nos prazos que vencem antes da próxima borda
+        while (wg_capture_pending(&cap, &deadline)) {
+            int64_t w = wake_at(cfg, deadline);
+            if (w >= te) break;
+            if (wg_capture_poll(&cap, w, &fr)) {
+                on_frame(&fr, w, st, sent, n_sent, &cursor);
+            }
+        }
+        if (i == ev->n) break;
+
+        // ISR
+        if (wg_capture_edge(&cap, ev->v[i].line, te)) {
+            while (wg_capture_pop(&cap, &fr)) {
+                st->closed_by_isr++;
+                on_frame(&fr, te + cfg->sched_us, st, sent, n_sent, &cursor);
+            }
+        }
+    }
+    *wall_s = now_s() - t0;
+
+    for (int i = 0; i < n_sent; i++) {
+        if (!sent[i].matched) st->missed++;
+    }
+}
+
+static void report(const sim_cfg_t *cfg, const edge_vec_t *ev, int n_sent,
+                   sim_stats_t *st, double wall_s)
+{
+    printf("Bordas: %zu  quadros enviados: %d  tick: %" PRId64 " us\n", ev->n, n_sent, cfg->tick_us);
+    printf("Vazão (PC): %.1f M bordas/s, %.0f k quadros/s\n",
+           wall_s > 0 ? ev->n / wall_s / 1e6 : 0.0,
+           wall_s > 0 ? (st->decoded + st->bad_length + st->bad_parity) / wall_s / 1e3 : 0.0);
+    printf("Decodificados: %d  comprimento inválido: %d  paridade: %d  overflow: %d  fechados pela ISR: %d\n",
+           st->decoded, st->bad_length, st->bad_parity, st->overflow, st->closed_by_isr);
+    if (n_sent > 0) {
+        printf("Corretos: %d  perdidos: %d  aceitos com valor errado: %d  taxa de erro: %.3f%%\n",
+               st->correct, st->missed, st->wrong,
+               100.0 * (n_sent - st->correct) / n_sent);
+    }
+    if (st->n_lat > 0) {
+        qsort(st->lat, (size_t)st->n_lat, sizeof(int64_t), cmp_i64);
+        int64_t sum = 0;
+        for (int i = 0; i < st->n_lat; i++) sum += st->lat[i];
+        printf("Latência de fim de quadro (us): média %" PRId64 "  p50 %" PRId64
+               "  p99 %" PRId64 "  máx %" PRId64 "\n",
+               sum / st->n_lat, st->lat[st->n_lat / 2],
+               st->lat[(st->n_lat * 99) / 100], st->lat[st->n_lat - 1]);
+    }
+}
+
+// ====================== Fuzz ======================
+
+static int fuzz_fail;
+
+static void fuzz_check(int cond, const char *what, uint64_t bits, uint8_t nbits)
+{
+    if (cond) return;
+    if (fuzz_fail++ < 10) {
+        fprintf(stderr, "FALHA: %s (bits=0x%016" PRIx64 " nbits=%u)\n", what, bits, nbits);
+    }
+}
+
+static void fuzz_frame(uint64_t bits, uint8_t nbits)
+{
+    wg_credential_t cred;
+    wg_decode_result_t res = wg_decode(bits, nbits, &cred);
+    const wg_format_t *fmt = wg_format_for_length(nbits);
+
+    fuzz_check(res == WG_DECODE_OK || res == WG_DECODE_BAD_LENGTH || res == WG_DECODE_BAD_PARITY,
+               "resultado fora do enum", bits, nbits);
+    fuzz_check(fmt != NULL || res == WG_DECODE_BAD_LENGTH,
+               "comprimento sem formato nao rejeitado", bits, nbits);
+    if (res != WG_DECODE_OK) return;
+
+    fuzz_check(cred.nbits == nbits, "nbits da credencial", bits, nbits);
+    if (cred.format != WG_FMT_RAW) {
+        // Aceito => a recodificação reproduz exatamente o quadro
+        uint64_t mask = (1ULL << nbits) - 1;
+        fuzz_check(wg_encode(fmt, cred.facility, cred.card) == (bits & mask),
+                   "recodificacao difere do quadro aceito", bits, nbits);
+    }
+
+    char buf[40];
+    memset(buf, 0xA5, sizeof(buf));
+    size_t n = wg_credential_to_str(&cred, buf, 24);
+    fuzz_check(n < 24 && buf[n] == '\0' && (uint8_t)buf[24] == 0xA5,
+               "wg_credential_to_str fora do buffer", bits, nbits);
+}
+
+static int run_fuzz(int iterations)
+{
+    for (int it = 0; it < iterations; it++) {
+        uint8_t nbits = (uint8_t)rnd_below(WG_MAX_BITS + 1);
+        uint64_t bits = rnd64();
+        switch (rnd_below(4)) {
+        case 0:
+            // ruído puro
+            break;
+        case 1: {
+            // quadro válido com um bit invertido: nenhum formato com paridade aceita
+            uint8_t len = all_lengths[rnd_below(sizeof(all_lengths))];
+            const wg_format_t *fmt = wg_format_for_length(len);
+            uint64_t v = wg_encode(fmt, (uint32_t)rnd64(), (uint32_t)rnd64());
+            uint64_t flipped = v ^ (1ULL << rnd_below(len));
+            wg_credential_t cred;
+            fuzz_check(wg_decode(v, len, &cred) == WG_DECODE_OK, "quadro codificado rejeitado", v, len);
+            fuzz_check(wg_decode(flipped, len, &cred) != WG_DECODE_OK, "bit invertido aceito", flipped, len);
+            bits = flipped;
+            nbits = len;
+            break;
+        }
+        case 2: {
+            // quadro válido truncado ou com bits extras (borda perdida/espúria)
+            uint8_t len = all_lengths[rnd_below(sizeof(all_lengths))];
+            uint64_t v = wg_encode(wg_format_for_length(len), (uint32_t)rnd64(), (uint32_t)rnd64());
+            if (rnd_below(2)) {
+                uint8_t cut = (uint8_t)(1 + rnd_below(3));
+                bits = v >> cut;
+                nbits = (uint8_t)(len - cut);
+            } else {
+                uint8_t extra = (uint8_t)(1 + rnd_below(3));
+                bits = (v << extra) | (rnd64() & ((1ULL << extra) - 1));
+                nbits = (uint8_t)(len + extra);
+            }
+            break;
+        }
+        default:
+            // bits acima de nbits devem ser ignorados
+            break;
+        }
+        fuzz_frame(bits, nbits);
+    }
+
+    // Captura: bordas com temporização aleatória não podem gerar quadros inválidos
+    wg_capture_t cap;
+    wg_capture_init(&cap, WG_FRAME_GAP_US);
+    wg_frame_t fr;
+    int64_t t = 0, deadline;
+    int frames = 0;
+    for (int it = 0; it < iterations; it++) {
+        t += 1 + (int64_t)rnd_below(rnd_below(4) ? 3000 : 60000);
+        wg_capture_edge(&cap, (unsigned)rnd_below(2), t);
+        while (wg_capture_pop(&cap, &fr)) {
+            fuzz_check(fr.nbits >= 1 && fr.nbits <= WG_MAX_BITS + 1, "nbits fora do limite", fr.bits, fr.nbits);
+            frames++;
+        }
+        if (wg_capture_pending(&cap, &deadline) && rnd_below(2) &&
+            wg_capture_poll(&cap, deadline, &fr)) {
+            fuzz_check(fr.nbits >= 1 && fr.nbits <= WG_MAX_BITS + 1, "nbits fora do limite", fr.bits, fr.nbits);
+            frames++;
+        }
+    }
+
+    printf("Fuzz: %d quadros + %d bordas (%d quadros capturados), %d falhas\n",
+           iterations, iterations, frames, fuzz_fail);
+    return fuzz_fail ? 1 : 0;
+}
+
+// ====================== main ======================
+
+static void usage(const char *prog)
+{
+    printf("Uso: %s [opções]\n"
+           "  --frames N        quadros sintetizados (padrão 10000)\n"
+           "  --format BITS     26, 34, 35, 37, 48 ou 32/40/56 (RAW); padrão: mistura\n"
+           "  --pulse US        largura do pulso (padrão 50)\n"
+           "  --gap US          intervalo entre pulsos (padrão 1950)\n"
+           "  --jitter US       jitter por borda, +/- (padrão 0)\n"
+           "  --frame-gap US    pausa entre quadros (padrão 100000)\n"
+           "  --noise N         pulsos espúrios por quadro (padrão 0)\n"
+           "  --drop P          probabilidade de perder uma borda (padrão 0)\n"
+           "  --tick US         despertar da tarefa no tick do FreeRTOS (0 = exato)\n"
+           "  --sched US        atraso de escalonamento da tarefa (padrão 0)\n"
+           "  --seed N          semente (padrão 1)\n"
+           "  --trace ARQ       lê bordas gravadas em vez de sintetizar\n"
+           "  --dump ARQ        grava o traço sintetizado\n"
+           "  --fuzz N          modo fuzz com N iterações\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    sim_cfg_t cfg = {
+        .frames = 10000,
+        .pulse_us = 50,
+        .gap_us = 1950,
+        .frame_gap_us = 100000,
+        .seed = 1,
+    };
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (!strcmp(a, "-h") || !strcmp(a, "--help")) { usage(argv[0]); return 0; }
+        if (!v) { usage(argv[0]); return 2; }
+        i++;
+        if      (!strcmp(a, "--frames"))    cfg.frames = atoi(v);
+        else if (!strcmp(a, "--format"))    cfg.format = atoi(v);
+        else if (!strcmp(a, "--pulse"))     cfg.pulse_us = atoll(v);
+        else if (!strcmp(a, "--gap"))       cfg.gap_us = atoll(v);
+        else if (!strcmp(a, "--jitter"))    cfg.jitter_us = atoll(v);
+        else if (!strcmp(a, "--frame-gap")) cfg.frame_gap_us = atoll(v);
+        else if (!strcmp(a, "--noise"))     cfg.noise = atof(v);
+        else if (!strcmp(a, "--drop"))      cfg.drop = atof(v);
+        else if (!strcmp(a, "--tick"))      cfg.tick_us = atoll(v);
+        else if (!strcmp(a, "--sched"))     cfg.sched_us = atoll(v);
+        else if (!strcmp(a, "--seed"))      cfg.seed = (unsigned)strtoul(v, NULL, 0);
+        else if (!strcmp(a, "--trace"))     cfg.trace = v;
+        else if (!strcmp(a, "--dump"))      cfg.dump = v;
+        else if (!strcmp(a, "--fuzz"))      cfg.fuzz = atoi(v);
+        else { usage(argv[0]); return 2; }
+    }
+
+    rng_state = 0x9E3779B97F4A7C15ULL ^ cfg.seed;
+
+    if (cfg.fuzz > 0) {
+        return run_fuzz(cfg.fuzz);
+    }
+
+    if (cfg.format && !wg_format_for_length((uint8_t)cfg.format)) {
+        fprintf(stderr, "Formato de %d bits nao suportado\n", cfg.format);
+        return 2;
+    }
+    if (cfg.pulse_us < 1 || cfg.gap_us < 1 || cfg.jitter_us * 2 >= cfg.pulse_us + cfg.gap_us) {
+        fprintf(stderr, "Temporizacao invalida: jitter deve ser menor que metade do periodo\n");
+        return 2;
+    }
+
+    edge_vec_t ev = {0};
+    sent_t *sent = NULL;
+    int n_sent = 0;
+    if (cfg.trace) {
+        if (load_trace(cfg.trace, &ev) != 0) return 2;
+    } else {
+        sent = synthesize(&cfg, &ev);
+        n_sent = cfg.frames;
+    }
+    if (cfg.dump) dump_trace(cfg.dump, &ev);
+
+    sim_stats_t st = {0};
+    st.lat = calloc(ev.n + 1, sizeof(int64_t));
+    double wall_s = 0;
+    simulate(&cfg, &ev, sent, n_sent, &st, &wall_s);
+    report(&cfg, &ev, n_sent, &st, wall_s);
+
+    free(st.lat);
+    free(sent);
+    free(ev.v);
+    return 0;
+}
@@ -0,0 +1,340 @@
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "access_pipeline.h"
+#include "app_output.h"
+#include "app_zigbee.h"
+#include "access_policy.h"
+#include "deny_cache.h"
+#include "fast_boot.h"
+#include "time_service.h"
+#include "live_feed.h"
+#include "metrics.h"
+#include "mem_budget.h"
+
+static const char *TAG = "ACCESS";
+
+#define DECIDE_QUEUE_LEN   8
+#define LOG_QUEUE_LEN      16
+#define NOTIFY_QUEUE_LEN   16
+
+// Prioridades: decisão acima do decodificador (12), abaixo do agendador de saídas (14)
+#define DECIDE_TASK_PRIO   13
+#define LOG_TASK_PRIO      5
+#define NOTIFY_TASK_PRIO   4
+
+static QueueHandle_t decide_queue = NULL;
+static QueueHandle_t log_queue = NULL;
+static QueueHandle_t notify_queue = NULL;
+
+static access_pipeline_stats_t stats;
+static access_event_t last_event;
+static bool has_last_event = false;
+static SemaphoreHandle_t last_lock = NULL;
+
+static deny_cache_t deny_cache;     // só a task de decisão mexe
+
+// Boot em estágios (fast_boot.h): até READY_FULL_ACL a decisão usa a ACL de
+// boot e o log espera; até READY_SERVICES a notificação espera. Os eventos
+// aguardam nas filas.
+#define READY_FULL_ACL     (1 << 0)
+#define READY_SERVICES     (1 << 1)
+static EventGroupHandle_t ready_events = NULL;
+
+// ====================== Estágios ======================
+
+// Linha JSON do feed ao vivo, mesmos nomes de campo de /api/logs
+static void publish_live(const access_event_t *ev) {
+    if (live_feed_clients() == 0) return;
+
+    char json[128];
+    uint32_t unix_s;
+    int n;
+    if (time_service_to_unix(ev->t_frame_us, &unix_s)) {
+        n = snprintf(json, sizeof(json), "{\"uid\":\"%s\",\"d\":%u,\"r\":%u,\"t\":%lu,\"n\":%lu}", ev->uid,
+                     ev->decision, ev->reader_id, (unsigned long)unix_s, (unsigned long)ev->attempts);
+    } else {
+        n = snprintf(json, sizeof(json), "{\"uid\":\"%s\",\"d\":%u,\"r\":%u,\"up\":%lu,\"n\":%lu}", ev->uid,
+                     ev->decision, ev->reader_id, (unsigned long)(ev->t_frame_us / 1000000),
+                     (unsigned long)ev->attempts);
+    }
+    if (n > 0 && n < (int)sizeof(json)) {
+        live_feed_publish(json, n);
+    }
+}
+
+// Agregado do cache de negação vira um evento comum para o estágio de log
+static void send_deny_summary(const deny_summary_t *sum) {
+    access_event_t ev = {
+        .cred = sum->cred,
+        .reader_id = ACCESS_READER_DEFAULT,
+        .decision = ACCESS_DENIED,
+        .attempts = sum->count,
+        .t_first_attempt_us = sum->t_first_us,
+        .t_frame_us = sum->t_last_us,
+    };
+    wg_credential_to_str(&sum->cred, ev.uid, sizeof(ev.uid));
+
+    if (xQueueSend(log_queue, &ev, 0) != pdTRUE) {
+        stats.dropped_log++;
+    }
+}
+
+static void flush_deny_cache(int64_t now_us) {
+    deny_summary_t sum;
+    while (deny_cache_flush(&deny_cache, now_us, &sum)) {
+        send_deny_summary(&sum);
+    }
+}
+
+// Decisão + acionamento: caminho crítico, sem flash nem rede
+static void decide_task(void *arg) {
+    access_event_t ev;
+    deny_cache_init(&deny_cache);
+
+    // Sem ACL de boot válida (primeiro boot, slot corrompido): os cartões
+    // esperam na fila pelas tabelas completas em vez de serem negados
+    if (!fast_boot_acl_loaded()) {
+        xEventGroupWaitBits(ready_events, READY_FULL_ACL, pdFALSE, pdTRUE, portMAX_DELAY);
+    }
+    bool full = false;
+
+    while (1) {
+        // Acorda também quando um agregado de negações vence
+        TickType_t wait = portMAX_DELAY;
+        int64_t next_flush = deny_cache_next_flush(&deny_cache);
+        if (next_flush != INT64_MAX) {
+            int64_t left_us = next_flush - esp_timer_get_time();
+            wait = left_us > 0 ? pdMS_TO_TICKS(left_us / 1000) + 1 : 0;
+        }
+        if (xQueueReceive(decide_queue, &ev, wait) != pdTRUE) {
+            flush_deny_cache(esp_timer_get_time());
+            continue;
+        }
+        metrics_gauge_max(MET_QUEUE_DECIDE, uxQueueMessagesWaiting(decide_queue) + 1);
+
+        // Tabelas completas no ar: a ACL de boot sai de cena (esta task é a única leitora)
+        if (!full && (xEventGroupGetBits(ready_events) & READY_FULL_ACL)) {
+            full = true;
+            fast_boot_acl_release();
+        }
+
+        // Repetição de um cartão negado: sem busca, sem log individual
+        uint32_t users_version = rfid_users_version();
+        deny_verdict_t verdict = deny_cache_check(&deny_cache, &ev.cred, users_version,
+                                                  ev.t_decoded_us);
+        bool granted = false, known = false;
+        if (verdict == DENY_MISS && !full) {
+            // Sem hora ainda: só regras sem horário, já resolvidas no snapshot
+            known = granted = fast_boot_acl_check(ev.uid, ev.reader_id);
+            stats.boot_decisions++;
+        } else if (verdict == DENY_MISS) {
+            known = rfid_is_user_authorized(ev.uid);
+            if (known) {
+                // Grupos/portas/horário: tabela pré-compilada, tempo constante
+                uint32_t now_unix;
+                bool now_valid = time_service_to_unix(ev.t_frame_us, &now_unix);
+                granted = access_policy_check(ev.uid, ev.reader_id, now_valid, now_unix);
+            }
+        }
+        ev.decision = granted ? ACCESS_GRANTED : ACCESS_DENIED;
+        ev.t_decided_us = esp_timer_get_time();
+        fast_boot_mark_decision(!full);
+
+        // Em backoff nem buzzer/LED: leitor travado ou força bruta
+        if (verdict != DENY_BLOCKED) {
+            app_output_play(granted ? &OUT_SEQ_GRANT : &OUT_SEQ_DENY);
+        }
+        ev.t_actuated_us = esp_timer_get_time();
+        metrics_observe_us(MET_H_SWIPE_TO_DECISION, ev.t_decided_us - ev.t_frame_us);
+        metrics_observe_us(MET_H_DECISION_TO_RELAY, ev.t_actuated_us - ev.t_decided_us);
+
+        stats.events++;
+        if (granted) stats.granted++; else stats.denied++;
+        stats.last_frame_to_relay_us = ev.t_actuated_us - ev.t_frame_us;
+        if (stats.last_frame_to_relay_us > stats.max_frame_to_relay_us) {
+            stats.max_frame_to_relay_us = stats.last_frame_to_relay_us;
+        }
+
+        if (verdict != DENY_MISS) {
+            if (verdict == DENY_BLOCKED) stats.deny_blocked++; else stats.deny_cache_hits++;
+            flush_deny_cache(ev.t_decided_us);
+            continue;
+        }
+        if (!known && full) {
+            // Só cartões desconhecidos: negação por horário muda sozinha com o relógio.
+            // Não da ACL de boot: pode estar atrás da tabela que acabou de carregar.
+            deny_summary_t evicted;
+            if (deny_cache_add(&deny_cache, &ev.cred, users_version, ev.t_decoded_us, &evicted)) {
+                send_deny_summary(&evicted);
+            }
+        }
+
+        ev.attempts = 1;
+        if (xQueueSend(log_queue, &ev, 0) != pdTRUE) {
+            stats.dropped_log++;
+        }
+    }
+}
+
+// Log persistente: pode esperar pela flash sem afetar a porta
+static void log_task(void *arg) {
+    access_event_t ev;
+    // Gravação e número do boot prontos (rfid_storage_init, time_service_init)
+    xEventGroupWaitBits(ready_events, READY_FULL_ACL, pdFALSE, pdTRUE, portMAX_DELAY);
+    while (1) {
+        if (xQueueReceive(log_queue, &ev, portMAX_DELAY) != pdTRUE) continue;
+        metrics_gauge_max(MET_QUEUE_LOG, uxQueueMessagesWaiting(log_queue) + 1);
+
+        // Hora do quadro (monotônico), não da gravação: o log pode estar atrasado.
+        // Sem hora de parede ainda, grava segundos desde o boot; a leitura corrige.
+        int64_t t_first_us = ev.attempts > 1 ? ev.t_first_attempt_us : ev.t_frame_us;
+        int64_t span_s = (ev.t_frame_us - t_first_us) / 1000000;
+        uint32_t unix_s;
+        bool time_valid = time_service_to_unix(t_first_us, &unix_s);
+
+        rfid_log_t rec = {
+            .cred = ev.cred.id,
+            .time = time_valid ? unix_s : (uint32_t)(t_first_us / 1000000),
+            .time_valid = time_valid,
+            .boot = time_service_boot_id(),
+            .count = ev.attempts > UINT16_MAX ? UINT16_MAX : (ev.attempts ? (uint16_t)ev.attempts : 1),
+            .decision = ev.decision == ACCESS_GRANTED ? RFID_LOG_GRANTED : RFID_LOG_DENIED,
+            .reader = ev.reader_id,
+            .span_s = span_s > UINT8_MAX ? UINT8_MAX : (uint8_t)span_s,
+        };
+        esp_err_t err = rfid_add_log(&rec, NULL);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Falha ao gravar log: %s", esp_err_to_name(err));
+        }
+        ev.t_logged_us = esp_timer_get_time();
+
+        if (xQueueSend(notify_queue, &ev, 0) != pdTRUE) {
+            stats.dropped_notify++;
+        }
+    }
+}
+
+// Fila do Zigbee: o envio (agrupado, com ACK e repetição) é do app_zigbee
+static void report_zigbee(const access_event_t *ev) {
+    int64_t t_us = ev->attempts > 1 ? ev->t_first_attempt_us : ev->t_frame_us;
+    uint32_t unix_s;
+    bool time_valid = time_service_to_unix(t_us, &unix_s);
+    app_zb_event_t zev = {
+        .cred = ev->cred.id,
+        .time = time_valid ? unix_s : (uint32_t)(t_us / 1000000),
+        .decision = ev->decision == ACCESS_GRANTED ? RFID_LOG_GRANTED : RFID_LOG_DENIED,
+        .reader = ev->reader_id,
+        .time_valid = time_valid,
+        .uid = ev->uid,
+    };
+    if (app_zb_report_access(&zev) != ESP_OK) {
+        stats.dropped_notify++;
+    }
+}
+
+// Notificação: Zigbee e último evento para o HTTP
+static void notify_task(void *arg) {
+    access_event_t ev;
+    xEventGroupWaitBits(ready_events, READY_SERVICES, pdFALSE, pdTRUE, portMAX_DELAY);
+    while (1) {
+        if (xQueueReceive(notify_queue, &ev, portMAX_DELAY) != pdTRUE) continue;
+        metrics_gauge_max(MET_QUEUE_NOTIFY, uxQueueMessagesWaiting(notify_queue) + 1);
+
+        report_zigbee(&ev);
+        publish_live(&ev);
+        ev.t_notified_us = esp_timer_get_time();
+
+        xSemaphoreTake(last_lock, portMAX_DELAY);
+        last_event = ev;
+        has_last_event = true;
+        xSemaphoreGive(last_lock);
+
+        if (ev.attempts > 1) {
+            ESP_LOGI(TAG, "UID %s negado %lu vezes em %lld s (cache de negacao)", ev.uid,
+                     (unsigned long)ev.attempts, (long long)((ev.t_frame_us - ev.t_first_attempt_us) / 1000000));
+            continue;
+        }
+        ESP_LOGI(TAG, "UID %s %s | quadro->decisao %lld us, ->rele %lld us, ->log %lld us, ->notif %lld us",
+                 ev.uid, ev.decision == ACCESS_GRANTED ? "autorizado" : "negado",
+                 (long long)(ev.t_decided_us - ev.t_frame_us),
+                 (long long)(ev.t_actuated_us - ev.t_frame_us),
+                 (long long)(ev.t_logged_us - ev.t_frame_us),
+                 (long long)(ev.t_notified_us - ev.t_frame_us));
+    }
+}
+
+// ====================== API pública ======================
+
+esp_err_t access_pipeline_start(void) {
+    if (decide_queue) return ESP_OK;
+
+    decide_queue = xQueueCreate(DECIDE_QUEUE_LEN, sizeof(access_event_t));
+    log_queue = xQueueCreate(LOG_QUEUE_LEN, sizeof(access_event_t));
+    notify_queue = xQueueCreate(NOTIFY_QUEUE_LEN, sizeof(access_event_t));
+    last_lock = xSemaphoreCreateMutex();
+    ready_events = xEventGroupCreate();
+    if (!decide_queue || !log_queue || !notify_queue || !last_lock || !ready_events) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (mem_budget_task_create(MEM_SUB_PIPELINE, decide_task, "acc_decide", 3072, NULL,
+                               DECIDE_TASK_PRIO, NULL) != pdPASS ||
+        mem_budget_task_create(MEM_SUB_PIPELINE, log_task, "acc_log", 4096, NULL,
+                               LOG_TASK_PRIO, NULL) != pdPASS ||
+        mem_budget_task_create(MEM_SUB_PIPELINE, notify_task, "acc_notify", 4096, NULL,
+                               NOTIFY_TASK_PRIO, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t access_pipeline_submit(const wg_credential_t *cred, uint8_t reader_id,
+                                 int64_t t_frame_us, int64_t t_decoded_us) {
+    if (!decide_queue) return ESP_ERR_INVALID_STATE;
+
+    access_event_t ev = {
+        .cred = *cred,
+        .reader_id = reader_id,
+        .t_frame_us = t_frame_us,
+        .t_decoded_us = t_decoded_us,
+    };
+    wg_credential_to_str(cred, ev.uid, sizeof(ev.uid));
+
+    if (xQueueSend(decide_queue, &ev, 0) != pdTRUE) {
+        stats.dropped_decide++;
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+void access_pipeline_full_acl_ready(void) {
+    fast_boot_mark(FAST_BOOT_FULL_ACL);
+    if (ready_events) xEventGroupSetBits(ready_events, READY_FULL_ACL);
+}
+
+void access_pipeline_services_ready(void) {
+    fast_boot_mark(FAST_BOOT_SERVICES);
+    if (ready_events) xEventGroupSetBits(ready_events, READY_SERVICES);
+}
+
+bool access_pipeline_last_event(access_event_t *out) {
+    if (!last_lock) return false;
+
+    xSemaphoreTake(last_lock, portMAX_DELAY);
+    bool ok = has_last_event;
+    if (ok) *out = last_event;
+    xSemaphoreGive(last_lock);
+    return ok;
+}
+
+void access_pipeline_get_stats(access_pipeline_stats_t *out) {
+    *out = stats;
+}
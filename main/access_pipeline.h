@@ -0,0 +1,78 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "wiegand_format.h"
+#include "rfid_storage.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Pipeline de acesso orientado a eventos:
+//
+//   decodificador -> [fila] -> decisão + acionamento -> [fila] -> log -> [fila] -> notificação
+//
+// Cada estágio roda na sua task e só conversa com o seguinte por filas
+// limitadas. O relé é acionado no estágio de decisão, então a latência
+// cartão -> relé não depende da flash, do Zigbee nem do HTTP. Se um estágio
+// lento encher a sua fila, o evento é descartado ali (e contado), sem travar
+// os estágios anteriores.
+
+#define ACCESS_READER_DEFAULT  1
+
+typedef enum {
+    ACCESS_DENIED = 0,
+    ACCESS_GRANTED = 1,
+} access_decision_t;
+
+typedef struct {
+    wg_credential_t cred;
+    char uid[MAX_UID_LEN];      // forma texto usada na tabela de usuários
+    uint8_t reader_id;
+    uint8_t decision;           // access_decision_t
+    uint32_t attempts;          // > 1: registro agregado do cache de negação (deny_cache.h)
+    int64_t t_first_attempt_us; // só em registros agregados
+
+    // Carimbos de tempo por estágio (esp_timer_get_time, µs)
+    int64_t t_frame_us;         // último pulso do quadro
+    int64_t t_decoded_us;       // quadro fechado e decodificado
+    int64_t t_decided_us;
+    int64_t t_actuated_us;      // sequência de saída entregue ao agendador
+    int64_t t_logged_us;        // aceito pela task de gravação (na flash em até RFID_COMMIT_WINDOW_MS)
+    int64_t t_notified_us;
+} access_event_t;
+
+typedef struct {
+    uint32_t events;
+    uint32_t granted;
+    uint32_t denied;
+    uint32_t dropped_decide;    // fila de decisão cheia
+    uint32_t dropped_log;
+    uint32_t dropped_notify;
+    uint32_t deny_cache_hits;   // negações respondidas sem busca nem log
+    uint32_t deny_blocked;      // negações em backoff (sem acionar saídas)
+    uint32_t boot_decisions;    // decididas pela ACL de boot (fast_boot.h)
+    int64_t  last_frame_to_relay_us;
+    int64_t  max_frame_to_relay_us;
+} access_pipeline_stats_t;
+
+esp_err_t access_pipeline_start(void);
+
+// Chamado pela task do decodificador; nunca bloqueia
+esp_err_t access_pipeline_submit(const wg_credential_t *cred, uint8_t reader_id,
+                                 int64_t t_frame_us, int64_t t_decoded_us);
+
+// Boot em estágios (main.c): a decisão já roda com a ACL de boot; log e
+// notificação seguram os eventos nas filas até os seus serviços subirem.
+void access_pipeline_full_acl_ready(void);  // usuários, política e gravação prontos
+void access_pipeline_services_ready(void);  // Zigbee e HTTP iniciados (ou desistidos)
+
+// Último evento que chegou ao fim do pipeline (para HTTP)
+bool access_pipeline_last_event(access_event_t *out);
+
+void access_pipeline_get_stats(access_pipeline_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
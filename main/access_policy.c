@@ -0,0 +1,492 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+
+#include "access_policy.h"
+#include "fast_boot.h"
+#include "mem_budget.h"
+#include "nvs_storage.h"
+#include "uid_index.h"
+
+static const char *TAG = "POLICY";
+
+#define KEY_POLICY            "policy"
+#define POLICY_MAGIC          0x4C4F5050u  // "PPOL"
+#define POLICY_VERSION        2             // 1: access_policy_t inteira, com members[MAX_USERS]
+#define POLICY_TASK_PRIO      2             // abaixo de tudo do caminho do cartão
+#define POLICY_DEBOUNCE_MS    100           // junta alterações em sequência (importações, scripts)
+#define POLICY_INDEX_SLOTS    UID_INDEX_SLOTS_FOR(POLICY_MAX_MEMBERS)
+
+_Static_assert(POLICY_INDEX_SLOTS >= 2 * POLICY_MAX_MEMBERS, "POLICY_INDEX_SLOTS pequeno demais para POLICY_MAX_MEMBERS");
+_Static_assert(POLICY_MAX_DOORS <= 8, "portas em máscara de 8 bits");
+
+// Blob: cabeçalho + parte fixa da política (tudo antes de members) + só
+// os n_members membros em uso. Não depende de POLICY_MAX_MEMBERS: mudar a
+// capacidade não invalida a política gravada.
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;              // v2: POLICY_FIXED_SIZE; v1: sizeof(access_policy_t) de quem gravou
+    uint32_t crc;               // CRC32 do corpo
+} policy_blob_hdr_t;
+
+#define POLICY_FIXED_SIZE     offsetof(access_policy_t, members)
+
+// Forma compilada: só leitura para a decisão
+typedef struct {
+    uint16_t allow[POLICY_MAX_DOORS][POLICY_SLOTS];    // grupos liberados por slot
+    uint16_t always[POLICY_MAX_DOORS];                 // grupos com regra POLICY_ALWAYS
+    int32_t utc_offset_s;
+    uint32_t version;
+    policy_member_t members[POLICY_MAX_MEMBERS];
+    uid_index_slot_t slots[POLICY_INDEX_SLOTS];
+    uid_index_t index;
+} policy_compiled_t;
+
+// Fonte, tabelas compiladas e cópia de trabalho da task: arena do init
+static access_policy_t *src = NULL;         // com src_lock
+static SemaphoreHandle_t src_lock = NULL;
+static uint32_t src_version = 0;
+
+static policy_compiled_t *compiled = NULL; // [2]
+static policy_compiled_t *active = NULL;    // troca só dentro de active_mux
+static portMUX_TYPE active_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static TaskHandle_t policy_task_handle = NULL;
+static access_policy_stats_t stats;
+
+// ====================== Compilação ======================
+
+static void set_slots(uint16_t *allow, uint8_t days, uint16_t from_min, uint16_t to_min, uint16_t bit) {
+    int from = from_min / POLICY_SLOT_MIN;
+    int to = (to_min + POLICY_SLOT_MIN - 1) / POLICY_SLOT_MIN;     // slot parcial conta inteiro
+    int len = to_min > from_min ? to - from : POLICY_SLOTS_PER_DAY - from + to;
+    if (len > POLICY_SLOTS_PER_DAY) len = POLICY_SLOTS_PER_DAY;
+    for (int day = 0; day < 7; day++) {
+        if (!(days & (1 << day))) continue;
+        int slot = day * POLICY_SLOTS_PER_DAY + from;
+        for (int i = 0; i < len; i++) {
+            allow[(slot + i) % POLICY_SLOTS] |= bit;            // sábado->domingo dá a volta
+        }
+    }
+}
+
+static void compile(const access_policy_t *p, uint32_t version, policy_compiled_t *c) {
+    memset(c->allow, 0, sizeof(c->allow));
+    memset(c->always, 0, sizeof(c->always));
+    c->utc_offset_s = (int32_t)p->utc_offset_min * 60;
+    c->version = version;
+
+    for (int g = 0; g < POLICY_MAX_GROUPS; g++) {
+        const policy_group_t *grp = &p->groups[g];
+        uint16_t bit = (uint16_t)(1u << g);
+        for (int r = 0; r < grp->n_rules; r++) {
+            const policy_rule_t *rule = &grp->rules[r];
+            for (int d = 0; d < POLICY_MAX_DOORS; d++) {
+                if (!(rule->doors & (1 << d))) continue;
+                if (rule->schedule == POLICY_ALWAYS) {
+                    c->always[d] |= bit;
+                    for (int s = 0; s < POLICY_SLOTS; s++) c->allow[d][s] |= bit;
+                    continue;
+                }
+                if (rule->schedule >= POLICY_MAX_SCHEDULES) continue;
+                const policy_schedule_t *sch = &p->schedules[rule->schedule];
+                for (int i = 0; i < sch->n_intervals; i++) {
+                    const policy_interval_t *iv = &sch->intervals[i];
+                    set_slots(c->allow[d], iv->days, iv->from_min, iv->to_min, bit);
+                }
+            }
+        }
+    }
+
+    memcpy(c->members, p->members, (size_t)p->n_members * sizeof(policy_member_t));
+    uid_index_init(&c->index, c->slots, POLICY_INDEX_SLOTS, c->members, sizeof(policy_member_t));
+    for (int i = 0; i < p->n_members; i++) {
+        uid_index_insert(&c->index, c->members[i].uid, (uint16_t)i);
+    }
+}
+
+// Política gravada ilegível: ninguém passa até alguém reconfigurar
+// (op=reset volta à padrão). Melhor que abrir todas as portas.
+static void deny_all_policy(access_policy_t *p) {
+    memset(p, 0, sizeof(*p));
+}
+
+static void default_policy(access_policy_t *p) {
+    memset(p, 0, sizeof(*p));
+    strcpy(p->groups[0].name, "todos");
+    p->groups[0].n_rules = 1;
+    p->groups[0].rules[0] = (policy_rule_t) { .doors = POLICY_ALL_DOORS, .schedule = POLICY_ALWAYS };
+}
+
+// ====================== Persistência ======================
+
+static esp_err_t save_policy(const access_policy_t *p) {
+    size_t body = POLICY_FIXED_SIZE + (size_t)p->n_members * sizeof(policy_member_t);
+    uint8_t *blob = malloc(sizeof(policy_blob_hdr_t) + body);
+    if (!blob) return ESP_ERR_NO_MEM;
+
+    *(policy_blob_hdr_t *)blob = (policy_blob_hdr_t) {
+        .magic = POLICY_MAGIC,
+        .version = POLICY_VERSION,
+        .size = POLICY_FIXED_SIZE,
+        .crc = esp_rom_crc32_le(0, (const uint8_t *)p, body),   // members vem logo depois da parte fixa
+    };
+    memcpy(blob + sizeof(policy_blob_hdr_t), p, body);
+    esp_err_t err = nvs_set_blob(nvs_storage_handle(), KEY_POLICY, blob, sizeof(policy_blob_hdr_t) + body);
+    if (err == ESP_OK) err = nvs_storage_commit();
+    free(blob);
+    return err;
+}
+
+// Corpo: parte fixa + n_members membros. Na v1 o corpo tem o tamanho da
+// struct de quem gravou (members[MAX_USERS] daquela versão); a parte fixa é
+// a mesma, então serve o mesmo caminho.
+static esp_err_t parse_policy(const uint8_t *body, size_t len, access_policy_t *p) {
+    if (len < POLICY_FIXED_SIZE) return ESP_ERR_INVALID_SIZE;
+    memset(p, 0, sizeof(*p));
+    memcpy(p, body, POLICY_FIXED_SIZE);
+    if (p->n_members > POLICY_MAX_MEMBERS) {
+        ESP_LOGE(TAG, "Politica gravada com %u membros, capacidade %d", p->n_members, POLICY_MAX_MEMBERS);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    size_t members = (size_t)p->n_members * sizeof(policy_member_t);
+    if (POLICY_FIXED_SIZE + members > len) return ESP_ERR_INVALID_SIZE;
+    memcpy(p->members, body + POLICY_FIXED_SIZE, members);
+    return ESP_OK;
+}
+
+static esp_err_t load_policy(access_policy_t *p) {
+    size_t size = 0;
+    esp_err_t err = nvs_get_blob(nvs_storage_handle(), KEY_POLICY, NULL, &size);
+    if (err != ESP_OK) return err;
+    if (size < sizeof(policy_blob_hdr_t)) return ESP_ERR_INVALID_SIZE;
+    uint8_t *blob = malloc(size);
+    if (!blob) return ESP_ERR_NO_MEM;
+
+    err = nvs_get_blob(nvs_storage_handle(), KEY_POLICY, blob, &size);
+    if (err == ESP_OK) {
+        const policy_blob_hdr_t *hdr = (const policy_blob_hdr_t *)blob;
+        const uint8_t *body = blob + sizeof(*hdr);
+        size_t len = size - sizeof(*hdr);
+        bool v2 = hdr->version == POLICY_VERSION && hdr->size == POLICY_FIXED_SIZE &&
+                  len >= POLICY_FIXED_SIZE && (len - POLICY_FIXED_SIZE) % sizeof(policy_member_t) == 0;
+        bool v1 = hdr->version == 1 && hdr->size == len;
+        if (hdr->magic != POLICY_MAGIC || (!v1 && !v2)) {
+            err = ESP_ERR_INVALID_SIZE;
+        } else if (hdr->crc != esp_rom_crc32_le(0, body, len)) {
+            err = ESP_ERR_INVALID_CRC;
+        } else {
+            err = parse_policy(body, len, p);
+        }
+    }
+    free(blob);
+    return err;
+}
+
+// ====================== Task de recompilação ======================
+
+static void publish(const access_policy_t *p, uint32_t version) {
+    // A inativa não tem leitores: quem lê segura active_mux do início ao fim
+    policy_compiled_t *next = (active == &compiled[0]) ? &compiled[1] : &compiled[0];
+    int64_t t0 = esp_timer_get_time();
+    compile(p, version, next);
+    uint32_t dt = (uint32_t)(esp_timer_get_time() - t0);
+
+    portENTER_CRITICAL(&active_mux);
+    active = next;
+    stats.version = version;
+    stats.compiles++;
+    stats.last_compile_us = dt;
+    portEXIT_CRITICAL(&active_mux);
+}
+
+static void policy_task(void *arg) {
+    access_policy_t *copy = arg;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        vTaskDelay(pdMS_TO_TICKS(POLICY_DEBOUNCE_MS));
+        ulTaskNotifyTake(pdTRUE, 0);
+
+        // Compila de uma cópia: a API não espera pela compilação nem pela flash
+        xSemaphoreTake(src_lock, portMAX_DELAY);
+        memcpy(copy, src, sizeof(*copy));
+        uint32_t version = src_version;
+        xSemaphoreGive(src_lock);
+
+        publish(copy, version);
+        fast_boot_acl_changed();
+        esp_err_t err = save_policy(copy);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Falha ao gravar politica: %s", esp_err_to_name(err));
+        }
+        ESP_LOGI(TAG, "Politica v%lu compilada em %lu us", (unsigned long)version,
+                 (unsigned long)stats.last_compile_us);
+    }
+}
+
+// ====================== Comandos ======================
+
+// Valor de "key" em "k=v&k=v"; false se ausente ou grande demais
+static bool get_param(const char *cmd, const char *key, char *out, size_t len) {
+    size_t klen = strlen(key);
+    const char *p = cmd;
+    while (p) {
+        if (strncmp(p, key, klen) == 0 && p[klen] == '=') {
+            const char *v = p + klen + 1;
+            size_t n = strcspn(v, "&");
+            if (n >= len) return false;
+            memcpy(out, v, n);
+            out[n] = '\0';
+            return true;
+        }
+        p = strchr(p, '&');
+        if (p) p++;
+    }
+    return false;
+}
+
+static bool get_long(const char *cmd, const char *key, long min, long max, long *out) {
+    char buf[12];
+    if (!get_param(cmd, key, buf, sizeof(buf))) return false;
+    char *end;
+    long v = strtol(buf, &end, 10);
+    if (end == buf || *end != '\0' || v < min || v > max) return false;
+    *out = v;
+    return true;
+}
+
+// "HH:MM" -> minutos; "24:00" vale como fim do dia
+static bool get_hhmm(const char *cmd, const char *key, uint16_t *out) {
+    char buf[8];
+    unsigned h, m;
+    char tail;
+    if (!get_param(cmd, key, buf, sizeof(buf)) || sscanf(buf, "%u:%u%c", &h, &m, &tail) != 2) return false;
+    if (m > 59 || h > 24 || (h == 24 && m != 0)) return false;
+    *out = (uint16_t)(h * 60 + m);
+    return true;
+}
+
+static bool valid_name(const char *name) {
+    if (!*name) return false;
+    for (; *name; name++) {
+        char c = *name;
+        if (!(c == ' ' || c == '-' || c == '_' || c == '.' || (c >= '0' && c <= '9') ||
+              (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static esp_err_t fail(char *msg, size_t len, const char *text) {
+    snprintf(msg, len, "%s", text);
+    return ESP_ERR_INVALID_ARG;
+}
+
+static esp_err_t apply_member(access_policy_t *p, const char *cmd, char *msg, size_t len) {
+    char uid[MAX_UID_LEN], list[48];
+    if (!get_param(cmd, "uid", uid, sizeof(uid)) || !uid[0]) return fail(msg, len, "uid invalido");
+    if (!get_param(cmd, "groups", list, sizeof(list))) list[0] = '\0';
+
+    uint16_t groups = 0;
+    char *save;
+    for (char *tok = strtok_r(list, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        char *end;
+        long g = strtol(tok, &end, 10);
+        if (end == tok || *end != '\0' || g < 0 || g >= POLICY_MAX_GROUPS) return fail(msg, len, "grupo invalido");
+        groups |= (uint16_t)(1u << g);
+    }
+
+    int i = 0;
+    while (i < p->n_members && strcmp(p->members[i].uid, uid) != 0) i++;
+    if (groups == 0) {
+        // Volta aos grupos padrão
+        if (i < p->n_members) p->members[i] = p->members[--p->n_members];
+    } else {
+        if (i == p->n_members) {
+            if (p->n_members >= POLICY_MAX_MEMBERS) return fail(msg, len, "membros demais");
+            memset(&p->members[i], 0, sizeof(p->members[i]));
+            memcpy(p->members[i].uid, uid, strlen(uid) + 1);   // uid já limitado a MAX_UID_LEN - 1
+            p->n_members++;
+        }
+        p->members[i].groups = groups;
+    }
+    snprintf(msg, len, "membro %s atualizado", uid);
+    return ESP_OK;
+}
+
+static esp_err_t apply_locked(access_policy_t *p, const char *cmd, char *msg, size_t len) {
+    char op[12];
+    long id, v;
+    if (!get_param(cmd, "op", op, sizeof(op))) return fail(msg, len, "op ausente");
+
+    if (strcmp(op, "reset") == 0) {
+        default_policy(p);
+        snprintf(msg, len, "politica padrao");
+        return ESP_OK;
+    }
+    if (strcmp(op, "tz") == 0) {
+        if (!get_long(cmd, "offset_min", -14 * 60, 14 * 60, &v)) return fail(msg, len, "offset_min invalido");
+        p->utc_offset_min = (int16_t)v;
+        snprintf(msg, len, "fuso %ld min", v);
+        return ESP_OK;
+    }
+    if (strcmp(op, "member") == 0) {
+        return apply_member(p, cmd, msg, len);
+    }
+    if (strcmp(op, "schedule") == 0) {
+        if (!get_long(cmd, "id", 0, POLICY_MAX_SCHEDULES - 1, &id)) return fail(msg, len, "id invalido");
+        policy_schedule_t *sch = &p->schedules[id];
+        if (get_long(cmd, "clear", 1, 1, &v)) {
+            memset(sch, 0, sizeof(*sch));
+            snprintf(msg, len, "horario %ld limpo", id);
+            return ESP_OK;
+        }
+        policy_interval_t iv = {0};
+        if (!get_long(cmd, "days", 1, 0x7F, &v)) return fail(msg, len, "days invalido (1..127)");
+        iv.days = (uint8_t)v;
+        if (!get_hhmm(cmd, "from", &iv.from_min) || !get_hhmm(cmd, "to", &iv.to_min) ||
+            iv.from_min == iv.to_min || iv.from_min >= 24 * 60) {
+            return fail(msg, len, "from/to invalidos (HH:MM)");
+        }
+        if (sch->n_intervals >= POLICY_MAX_INTERVALS) return fail(msg, len, "intervalos demais");
+        sch->intervals[sch->n_intervals++] = iv;
+        snprintf(msg, len, "horario %ld: %u intervalos", id, sch->n_intervals);
+        return ESP_OK;
+    }
+    if (strcmp(op, "group") == 0) {
+        if (!get_long(cmd, "id", 0, POLICY_MAX_GROUPS - 1, &id)) return fail(msg, len, "id invalido");
+        policy_group_t *grp = &p->groups[id];
+        char name[POLICY_NAME_LEN];
+        if (get_param(cmd, "name", name, sizeof(name))) {
+            if (!valid_name(name)) return fail(msg, len, "nome invalido");
+            strcpy(grp->name, name);
+        }
+        if (get_long(cmd, "clear", 1, 1, &v)) grp->n_rules = 0;
+        snprintf(msg, len, "grupo %ld atualizado", id);
+        return ESP_OK;
+    }
+    if (strcmp(op, "rule") == 0) {
+        if (!get_long(cmd, "group", 0, POLICY_MAX_GROUPS - 1, &id)) return fail(msg, len, "grupo invalido");
+        policy_rule_t rule;
+        if (!get_long(cmd, "doors", 1, POLICY_ALL_DOORS, &v)) return fail(msg, len, "doors invalido");
+        rule.doors = (uint8_t)v;
+        char sch[8];
+        if (get_param(cmd, "schedule", sch, sizeof(sch)) && strcmp(sch, "always") == 0) {
+            rule.schedule = POLICY_ALWAYS;
+        } else if (get_long(cmd, "schedule", 0, POLICY_MAX_SCHEDULES - 1, &v)) {
+            rule.schedule = (uint8_t)v;
+        } else {
+            return fail(msg, len, "schedule invalido");
+        }
+        policy_group_t *grp = &p->groups[id];
+        if (grp->n_rules >= POLICY_MAX_RULES) return fail(msg, len, "regras demais");
+        grp->rules[grp->n_rules++] = rule;
+        snprintf(msg, len, "grupo %ld: %u regras", id, grp->n_rules);
+        return ESP_OK;
+    }
+    return fail(msg, len, "op desconhecida");
+}
+
+// ====================== API pública ======================
+
+esp_err_t access_policy_init(void) {
+    if (src_lock) return ESP_OK;
+    esp_err_t err = nvs_storage_reserve_blob(KEY_POLICY, sizeof(policy_blob_hdr_t) + sizeof(access_policy_t));
+    if (err != ESP_OK) return err;
+    src = mem_budget_alloc(MEM_SUB_POLICY, sizeof(access_policy_t));
+    compiled = mem_budget_alloc(MEM_SUB_POLICY, 2 * sizeof(policy_compiled_t));
+    access_policy_t *work = mem_budget_alloc(MEM_SUB_POLICY, sizeof(access_policy_t));
+    if (!src || !compiled || !work) return ESP_ERR_NO_MEM;
+    src_lock = xSemaphoreCreateMutex();
+    if (!src_lock) return ESP_ERR_NO_MEM;
+
+    err = load_policy(src);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        default_policy(src);        // dispositivo novo
+    } else if (err != ESP_OK) {
+        // Não volta à padrão (tudo liberado): as restrições gravadas valem até alguém reconfigurar
+        ESP_LOGE(TAG, "Politica gravada ilegivel (%s): acesso negado a todos ate op=reset ou nova politica",
+                 esp_err_to_name(err));
+        deny_all_policy(src);
+    }
+    src_version = 1;
+    publish(src, src_version);
+    stats.pending_version = src_version;
+
+    if (mem_budget_task_create(MEM_SUB_POLICY, policy_task, "policy", 3072, work, POLICY_TASK_PRIO,
+                               &policy_task_handle) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Politica carregada: %u membros, compilada em %lu us", src->n_members,
+             (unsigned long)stats.last_compile_us);
+    return ESP_OK;
+}
+
+bool access_policy_check(const char *uid, uint8_t door, bool now_valid, uint32_t now_unix) {
+    if (door >= POLICY_MAX_DOORS) return false;
+    int64_t t0 = esp_timer_get_time();
+
+    portENTER_CRITICAL(&active_mux);
+    const policy_compiled_t *c = active;
+    int i = uid_index_find(&c->index, uid);
+    uint16_t groups = i >= 0 ? c->members[i].groups : POLICY_DEFAULT_GROUPS;
+    uint16_t allowed;
+    if (now_valid) {
+        int64_t local = (int64_t)now_unix + c->utc_offset_s;
+        int64_t days = local / 86400;
+        int wday = (int)((days + 4) % 7);          // 1970-01-01 foi quinta
+        int slot = wday * POLICY_SLOTS_PER_DAY + (int)(local % 86400) / (POLICY_SLOT_MIN * 60);
+        allowed = c->allow[door][slot];
+    } else {
+        allowed = c->always[door];
+    }
+    portEXIT_CRITICAL(&active_mux);
+
+    uint32_t dt = (uint32_t)(esp_timer_get_time() - t0);
+    if (dt > stats.max_check_us) stats.max_check_us = dt;
+    return (groups & allowed) != 0;
+}
+
+esp_err_t access_policy_apply(const char *cmd, char *msg, size_t msg_len) {
+    if (!src_lock) return ESP_ERR_INVALID_STATE;
+    if (!cmd) return fail(msg, msg_len, "comando vazio");
+
+    xSemaphoreTake(src_lock, portMAX_DELAY);
+    esp_err_t err = apply_locked(src, cmd, msg, msg_len);
+    if (err == ESP_OK) {
+        src_version++;
+        stats.pending_version = src_version;
+    }
+    xSemaphoreGive(src_lock);
+
+    if (err == ESP_OK) xTaskNotifyGive(policy_task_handle);
+    return err;
+}
+
+bool access_policy_get(access_policy_t *out) {
+    if (!src_lock) return false;
+    xSemaphoreTake(src_lock, portMAX_DELAY);
+    memcpy(out, src, sizeof(*out));
+    xSemaphoreGive(src_lock);
+    return true;
+}
+
+uint32_t access_policy_version(void) {
+    return stats.version;
+}
+
+void access_policy_get_stats(access_policy_stats_t *out) {
+    portENTER_CRITICAL(&active_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&active_mux);
+}
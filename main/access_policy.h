@@ -0,0 +1,115 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "rfid_storage.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Política de acesso: usuário -> grupos -> (portas, horário semanal).
+//
+// A política "fonte" (editável, gravada no NVS) é compilada em segundo plano
+// numa tabela allow[porta][slot] com a máscara dos grupos liberados em cada
+// slot de 15 minutos da semana. A decisão é uma busca no índice hash de
+// membros + um AND de máscaras, sem percorrer regras nem horários.
+// Duas tabelas compiladas: a task monta a inativa e troca o ponteiro.
+//
+// Usuário sem grupos explícitos pertence a POLICY_DEFAULT_GROUPS e não ocupa
+// a lista de membros (até POLICY_MAX_MEMBERS); a política padrão dá ao
+// grupo 0 todas as portas a qualquer hora (comportamento de antes:
+// cadastrado = liberado).
+//
+// Porta = reader_id do evento (0..POLICY_MAX_DOORS-1).
+
+#define POLICY_MAX_GROUPS        16     // cabe na máscara de 16 bits
+#define POLICY_MAX_DOORS         4
+#define POLICY_MAX_SCHEDULES     8
+#define POLICY_MAX_INTERVALS     8      // por horário
+#define POLICY_MAX_RULES         4      // por grupo
+#define POLICY_NAME_LEN          16
+#define POLICY_SLOT_MIN          15
+#define POLICY_SLOTS_PER_DAY     (24 * 60 / POLICY_SLOT_MIN)
+#define POLICY_SLOTS             (7 * POLICY_SLOTS_PER_DAY)     // 672
+#define POLICY_ALWAYS            0xFF   // regra sem horário
+#define POLICY_DEFAULT_GROUPS    0x0001
+#define POLICY_ALL_DOORS         ((1u << POLICY_MAX_DOORS) - 1)
+#ifdef CONFIG_RFID_POLICY_MAX_MEMBERS
+#define POLICY_MAX_MEMBERS       CONFIG_RFID_POLICY_MAX_MEMBERS   // Kconfig: usuários com grupos próprios
+#else
+#define POLICY_MAX_MEMBERS       128
+#endif
+
+typedef struct {
+    uint8_t days;               // bit 0 = domingo ... bit 6 = sábado
+    uint8_t reserved;
+    uint16_t from_min;          // minutos desde 00:00, hora local
+    uint16_t to_min;            // exclusivo; menor que from_min = passa da meia-noite
+} policy_interval_t;
+
+typedef struct {
+    uint8_t n_intervals;
+    policy_interval_t intervals[POLICY_MAX_INTERVALS];
+} policy_schedule_t;
+
+typedef struct {
+    uint8_t doors;              // máscara de portas
+    uint8_t schedule;           // índice em schedules[] ou POLICY_ALWAYS
+} policy_rule_t;
+
+typedef struct {
+    char name[POLICY_NAME_LEN];
+    uint8_t n_rules;
+    policy_rule_t rules[POLICY_MAX_RULES];
+} policy_group_t;
+
+typedef struct {
+    char uid[MAX_UID_LEN];      // primeiro campo: chave do uid_index
+    uint16_t groups;
+} policy_member_t;
+
+typedef struct {
+    int16_t utc_offset_min;     // fuso local para os horários
+    policy_schedule_t schedules[POLICY_MAX_SCHEDULES];
+    policy_group_t groups[POLICY_MAX_GROUPS];
+    uint16_t n_members;
+    policy_member_t members[POLICY_MAX_MEMBERS];
+} access_policy_t;
+
+typedef struct {
+    uint32_t version;           // política em vigor (compilada)
+    uint32_t pending_version;   // última alteração aceita
+    uint32_t compiles;
+    uint32_t last_compile_us;
+    uint32_t max_check_us;      // pior access_policy_check medido
+} access_policy_stats_t;
+
+// Carrega do NVS (ou a padrão), compila e inicia a task de recompilação.
+// Depois de nvs_storage_init (rfid_storage_init).
+esp_err_t access_policy_init(void);
+
+// Caminho da decisão: tempo constante, não bloqueia.
+// now_valid = false (hora desconhecida): só valem regras POLICY_ALWAYS.
+bool access_policy_check(const char *uid, uint8_t door, bool now_valid, uint32_t now_unix);
+
+// Alteração em texto "op=...&chave=valor", igual para HTTP (query string) e
+// Zigbee (atributo de comando). A recompilação e a gravação são assíncronas.
+//   op=tz&offset_min=-180
+//   op=schedule&id=1&days=62&from=08:00&to=18:00   (acrescenta intervalo; clear=1 limpa)
+//   op=group&id=1&name=equipe                      (clear=1 remove as regras)
+//   op=rule&group=1&doors=3&schedule=1|always
+//   op=member&uid=12:3456&groups=1,2               (groups vazio = grupos padrão)
+//   op=reset                                       (política padrão)
+// msg recebe um texto curto para o usuário.
+esp_err_t access_policy_apply(const char *cmd, char *msg, size_t msg_len);
+
+// Cópia da política fonte (para exibir); false sem memória
+bool access_policy_get(access_policy_t *out);
+uint32_t access_policy_version(void);
+void access_policy_get_stats(access_policy_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
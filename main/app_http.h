@@ -1,12 +0,0 @@
-#pragma once
-#include "esp_err.h"
-
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-esp_err_t app_http_start(void);
-
-#ifdef __cplusplus
-}
-#endif
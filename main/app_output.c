@@ -0,0 +1,156 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "driver/gpio.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "app_output.h"
+#include "mem_budget.h"
+
+static const char *TAG = "OUTPUT";
+
+#define OUT_QUEUE_LEN   8
+
+// ---------- Последовательности ----------
+static const out_step_t grant_relay[]  = { {1, 3000} };
+static const out_step_t grant_led[]    = { {1, 3000} };
+static const out_step_t grant_buzzer[] = { {1, 100} };
+
+const out_sequence_t OUT_SEQ_GRANT = {
+    .n_tracks = 3,
+    .tracks = {
+        { OUT_RELAY,  1, grant_relay },
+        { OUT_LED,    1, grant_led },
+        { OUT_BUZZER, 1, grant_buzzer },
+    },
+};
+
+static const out_step_t deny_beeps[] = { {1, 100}, {0, 100}, {1, 100}, {0, 100}, {1, 100} };
+
+const out_sequence_t OUT_SEQ_DENY = {
+    .n_tracks = 2,
+    .tracks = {
+        { OUT_LED,    5, deny_beeps },
+        { OUT_BUZZER, 5, deny_beeps },
+    },
+};
+
+// ---------- Состояние каналов ----------
+typedef struct {
+    int gpio;
+    const out_track_t *track;   // NULL = канал свободен
+    uint8_t step;
+    int64_t step_end_us;
+} out_state_t;
+
+static out_state_t channels[OUT_CHANNELS];
+static QueueHandle_t out_queue = NULL;
+
+static void start_step(out_state_t *ch, int64_t now)
+{
+    const out_step_t *st = &ch->track->steps[ch->step];
+    gpio_set_level(ch->gpio, st->level);
+    ch->step_end_us = now + (int64_t)st->ms * 1000;
+}
+
+static void start_sequence(const out_sequence_t *seq, int64_t now)
+{
+    for (int i = 0; i < seq->n_tracks; i++) {
+        const out_track_t *tr = &seq->tracks[i];
+        if (tr->channel >= OUT_CHANNELS || tr->n_steps == 0) continue;
+
+        out_state_t *ch = &channels[tr->channel];
+        ch->track = tr;
+        ch->step = 0;
+        start_step(ch, now);
+    }
+}
+
+// Продвигает шаги, срок которых истёк; возвращает ближайший дедлайн
+static int64_t advance(int64_t now)
+{
+    int64_t next = INT64_MAX;
+
+    for (int i = 0; i < OUT_CHANNELS; i++) {
+        out_state_t *ch = &channels[i];
+        while (ch->track && now >= ch->step_end_us) {
+            if (++ch->step >= ch->track->n_steps) {
+                gpio_set_level(ch->gpio, 0);
+                ch->track = NULL;
+            } else {
+                // отсчёт от конца прошлого шага, чтобы длительности не "плыли"
+                const out_step_t *st = &ch->track->steps[ch->step];
+                gpio_set_level(ch->gpio, st->level);
+                ch->step_end_us += (int64_t)st->ms * 1000;
+            }
+        }
+        if (ch->track && ch->step_end_us < next) {
+            next = ch->step_end_us;
+        }
+    }
+    return next;
+}
+
+static void output_task(void *arg)
+{
+    const out_sequence_t *seq;
+    TickType_t wait = portMAX_DELAY;
+
+    for (;;) {
+        if (xQueueReceive(out_queue, &seq, wait) == pdTRUE) {
+            start_sequence(seq, esp_timer_get_time());
+        }
+
+        int64_t now = esp_timer_get_time();
+        int64_t next = advance(now);
+        if (next == INT64_MAX) {
+            wait = portMAX_DELAY;
+        } else {
+            int64_t left_ms = (next - now + 999) / 1000;
+            wait = pdMS_TO_TICKS(left_ms);
+            if (wait == 0) wait = 1;
+        }
+    }
+}
+
+// ---------- API ----------
+esp_err_t app_output_init(const wiegand_pins_t *pins)
+{
+    if (!pins) return ESP_ERR_INVALID_ARG;
+    if (out_queue) return ESP_OK;
+
+    channels[OUT_RELAY].gpio = pins->gpio_relay;
+    channels[OUT_LED].gpio = pins->gpio_led;
+    channels[OUT_BUZZER].gpio = pins->gpio_buzzer;
+
+    gpio_config_t out_cfg = {
+        .pin_bit_mask = (1ULL<<pins->gpio_led) | (1ULL<<pins->gpio_buzzer) | (1ULL<<pins->gpio_relay),
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    ESP_ERROR_CHECK(gpio_config(&out_cfg));
+    for (int i = 0; i < OUT_CHANNELS; i++) {
+        gpio_set_level(channels[i].gpio, 0);
+    }
+
+    out_queue = xQueueCreate(OUT_QUEUE_LEN, sizeof(const out_sequence_t *));
+    if (!out_queue) return ESP_ERR_NO_MEM;
+
+    // Приоритет выше декодера: переключение реле не ждёт разбора кадров
+    if (mem_budget_task_create(MEM_SUB_READER, output_task, "output", 2560, NULL, 14, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Output scheduler ready: RELAY=%d LED=%d BUZ=%d",
+             pins->gpio_relay, pins->gpio_led, pins->gpio_buzzer);
+    return ESP_OK;
+}
+
+esp_err_t app_output_play(const out_sequence_t *seq)
+{
+    if (!out_queue || !seq) return ESP_ERR_INVALID_STATE;
+    return xQueueSend(out_queue, &seq, 0) == pdTRUE ? ESP_OK : ESP_ERR_TIMEOUT;
+}
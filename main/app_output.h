@@ -0,0 +1,52 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+#include "app_wiegand.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------------------------
+// Планировщик выходов: реле, светодиод, зуммер.
+// Последовательности описываются декларативно (уровень + длительность)
+// и проигрываются отдельной задачей, без vTaskDelay в вызывающем коде.
+// Каналы независимы: новая последовательность заменяет только свои каналы,
+// поэтому, например, сигнал "отказ" не обрывает уже идущий импульс реле.
+// ---------------------------
+
+typedef enum {
+    OUT_RELAY = 0,
+    OUT_LED,
+    OUT_BUZZER,
+    OUT_CHANNELS
+} out_channel_t;
+
+typedef struct {
+    uint8_t  level;     // уровень на время шага
+    uint16_t ms;        // длительность шага
+} out_step_t;
+
+typedef struct {
+    uint8_t channel;    // out_channel_t
+    uint8_t n_steps;
+    const out_step_t *steps;
+} out_track_t;
+
+typedef struct {
+    uint8_t n_tracks;
+    out_track_t tracks[OUT_CHANNELS];
+} out_sequence_t;
+
+// Готовые последовательности
+extern const out_sequence_t OUT_SEQ_GRANT;   // реле 3 с, LED 3 с, один бип
+extern const out_sequence_t OUT_SEQ_DENY;    // три коротких бипа + мигание LED
+
+esp_err_t app_output_init(const wiegand_pins_t *pins);
+
+// Не блокирует: ставит последовательность в очередь задачи вывода
+esp_err_t app_output_play(const out_sequence_t *seq);
+
+#ifdef __cplusplus
+}
+#endif
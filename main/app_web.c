@@ -1,90 +1,328 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include "esp_event.h"
 #include "esp_http_server.h"
+#include "app_web.h"
+#include "app_wiegand.h"
+#include "app_output.h"
 #include "rfid_reader.h"
 #include "rfid_storage.h"
+#include "web_writer.h"
+#include "web_render.h"
+#include "live_feed.h"
+#include "web_assets.h"
+#include "user_import.h"
+#include "access_policy.h"
+#include "access_pipeline.h"
+#include "app_zigbee.h"
+#include "metrics.h"
+#include "mem_budget.h"
+#include "fast_boot.h"
 
 static const char *TAG = "app_web";
 static httpd_handle_t server = NULL;
 
+// Espera máxima pela gravação de uma alteração de usuário (janela de commit + flash)
+#define WEB_DURABLE_WAIT_MS 2000
+
+// /api/logs: registros por requisição (padrão e máximo)
+#define WEB_LOGS_DEFAULT_LIMIT  100
+#define WEB_LOGS_MAX_LIMIT      1000
+
+// Importação de usuários: buffer fixo de recepção e tamanho máximo do corpo
+#define WEB_IMPORT_RX_BUF       512
+#define WEB_IMPORT_MAX_BODY     (MAX_USERS * USER_IMPORT_LINE_MAX + 64)
+
+// Listagem de usuários: registros copiados por vez com o lock (na pilha do httpd)
+#define WEB_USERS_PAGE          8
+
 /* ------------------- HANDLERS ------------------- */
 
-// Página principal
-static esp_err_t root_get_handler(httpd_req_t *req)
+// Páginas são estáticas (main/www, web_assets.c); aqui só os dados em JSON
+
+// Último UID lido, para a página /live: {"last_uid":"0A1B2C","len":3}
+static esp_err_t status_get_handler(httpd_req_t *req)
 {
-    const char resp[] =
-        "<h1>ESP32C6 RFID + Zigbee</h1>"
-        "<p><a href=\"/config\">Config Zigbee</a></p>"
-        "<p><a href=\"/rfid_logs\">RFID Logs</a></p>"
-        "<p><a href=\"/users\">Users</a></p>"
-        "<p><a href=\"/manage_users\">Gerir Usuários</a></p>";
-    httpd_resp_send(req, resp, HTTPD_RESP_USE_STRLEN);
-    return ESP_OK;
+    uint8_t buf[16] = {0};
+    size_t len = sizeof(buf);
+    wiegand_get_last_uid(buf, &len);
+
+    char json[sizeof("{\"last_uid\":\"\",\"len\":16}") + 2 * sizeof(buf)];
+    int n = snprintf(json, sizeof(json), "{\"last_uid\":\"");
+    for (size_t i = 0; i < len; ++i) n += snprintf(json + n, sizeof(json) - n, "%02X", buf[i]);
+    snprintf(json + n, sizeof(json) - n, "\",\"len\":%u}", (unsigned)len);
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_sendstr(req, json);
 }
 
-// Página de configuração Zigbee (placeholder)
-static esp_err_t config_get_handler(httpd_req_t *req)
+// Pulso do relé pelo agendador de saídas (a resposta não espera o fim do pulso)
+static esp_err_t open_get_handler(httpd_req_t *req)
 {
-    const char resp[] = "<h1>Config Zigbee</h1><p>Futuro formulário de rede...</p>";
-    httpd_resp_send(req, resp, HTTPD_RESP_USE_STRLEN);
-    return ESP_OK;
+    esp_err_t err = app_output_play(&OUT_SEQ_GRANT);
+    httpd_resp_set_type(req, "text/plain");
+    return httpd_resp_sendstr(req, err == ESP_OK ? "OK" : "BUSY");
 }
 
-// Listar logs RFID
-static esp_err_t logs_get_handler(httpd_req_t *req)
+static esp_err_t clear_get_handler(httpd_req_t *req)
 {
-    rfid_log_t *logs;
-    int count = rfid_get_logs(&logs);
+    wiegand_clear_last_uid();
+    httpd_resp_set_type(req, "text/plain");
+    return httpd_resp_sendstr(req, "CLEARED");
+}
 
-    httpd_resp_sendstr_chunk(req, "<h1>RFID Logs</h1><ul>");
-    for (int i = 0; i < count; i++) {
-        char line[128];
-        snprintf(line, sizeof(line), "<li>UID: %s | Time: %s</li>", logs[i].uid, logs[i].timestamp);
-        httpd_resp_sendstr_chunk(req, line);
+// Parâmetro numérico da query string; def se ausente ou inválido
+static uint32_t query_u32(const char *query, const char *key, uint32_t def)
+{
+    char val[12];
+    if (!query || httpd_query_key_value(query, key, val, sizeof(val)) != ESP_OK) {
+        return def;
     }
-    httpd_resp_sendstr_chunk(req, "</ul>");
-    httpd_resp_sendstr_chunk(req, NULL);
-    return ESP_OK;
+    char *end;
+    unsigned long v = strtoul(val, &end, 10);
+    return (end == val || *end != '\0') ? def : (uint32_t)v;
 }
 
-// Listar usuários
-static esp_err_t users_get_handler(httpd_req_t *req)
+// Logs em JSON a partir de um cursor: GET /api/logs?since=<seq>&limit=N
+//
+// since é o "next" da resposta anterior (ausente = mais antigo disponível;
+// com tail=N, os N mais recentes).
+// Se o cursor já foi sobrescrito pelo journal circular, a lista começa em
+// "first" e o cliente percebe o buraco comparando com o cursor enviado.
+//   {"first":F,"next":N,"more":0,"logs":[{"seq":S,"uid":"..","t":unix,"d":1,"r":1},...]}
+// "d": 0 negado, 1 liberado, 2 desconhecido; agregados têm "n" e "span" (s);
+// sem hora de parede conhecida vem "boot" e "up" (s desde o boot) no lugar de "t".
+static esp_err_t api_logs_get_handler(httpd_req_t *req)
 {
-    rfid_user_t *users;
-    int count = rfid_list_users(&users);
+    char query[64];
+    bool has_query = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK;
+
+    uint32_t first = rfid_log_first_seq();
+    uint32_t end = rfid_log_next_seq();
+    const char *q = has_query ? query : NULL;
+    uint32_t tail = query_u32(q, "tail", 0);
+    uint32_t seq = query_u32(q, "since", tail ? end - tail : first);
+    uint32_t limit = query_u32(q, "limit", WEB_LOGS_DEFAULT_LIMIT);
+    if (limit == 0 || limit > WEB_LOGS_MAX_LIMIT) limit = WEB_LOGS_MAX_LIMIT;
+
+    // Cursores comparados por diferença: a sequência pode dar a volta
+    if ((int32_t)(seq - first) < 0) seq = first;
+    if ((int32_t)(end - seq) < 0) seq = end;
+    uint32_t stop = (end - seq > limit) ? seq + limit : end;
 
-    httpd_resp_sendstr_chunk(req, "<h1>Usuários</h1><ul>");
-    for (int i = 0; i < count; i++) {
-        char line[128];
-        snprintf(line, sizeof(line), "<li>%s (UID=%s)</li>", users[i].name, users[i].uid);
-        httpd_resp_sendstr_chunk(req, line);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    web_writer_t w;
+    if (web_writer_begin(&w, req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Sem memoria");
     }
-    httpd_resp_sendstr_chunk(req, "</ul>");
-    httpd_resp_sendstr_chunk(req, "<p><a href=\"/manage_users\">Gerir Usuários</a></p>");
-    httpd_resp_sendstr_chunk(req, NULL);
-    return ESP_OK;
+
+    web_render_logs(&w, first, seq, stop, end);
+    return web_writer_end(&w);
 }
 
-// Formulário de gestão de usuários
-static esp_err_t manage_users_handler(httpd_req_t *req)
-{
-    const char resp[] =
-        "<h1>Gerir Usuários RFID</h1>"
-        "<h2>Adicionar Usuário</h2>"
-        "<form action=\"/add_user\" method=\"get\">"
-        "UID: <input type=\"text\" name=\"uid\"><br>"
-        "Nome: <input type=\"text\" name=\"name\"><br>"
-        "<input type=\"submit\" value=\"Adicionar\">"
-        "</form>"
-        "<h2>Remover Usuário</h2>"
-        "<form action=\"/remove_user\" method=\"get\">"
-        "UID: <input type=\"text\" name=\"uid\"><br>"
-        "<input type=\"submit\" value=\"Remover\">"
-        "</form>"
-        "<p><a href=\"/users\">Ver lista de usuários</a></p>";
-    httpd_resp_send(req, resp, HTTPD_RESP_USE_STRLEN);
-    return ESP_OK;
+// Percorre os usuários em páginas copiadas com o lock (rfid_copy_users): o
+// envio pela rede fica fora do lock que a decisão de acesso usa. Se a tabela
+// mudar no meio, a resposta é abortada em vez de sair com usuários
+// faltando ou repetidos.
+static void write_users(web_writer_t *w, void (*item)(web_writer_t *w, const rfid_user_t *user, int index))
+{
+    rfid_user_t page[WEB_USERS_PAGE];
+    uint32_t first_version = 0;
+    for (int pos = 0; !web_writer_failed(w); ) {
+        uint32_t version;
+        int n = rfid_copy_users(pos, page, WEB_USERS_PAGE, &version);
+        if (pos == 0) {
+            first_version = version;
+        } else if (version != first_version) {
+            ESP_LOGW(TAG, "Usuarios alterados durante a listagem; resposta abortada");
+            w->err = ESP_ERR_INVALID_STATE;
+            break;
+        }
+        for (int i = 0; i < n; i++) item(w, &page[i], pos + i);
+        if (n < WEB_USERS_PAGE) break;
+        pos += n;
+    }
+}
+
+// Lista de usuários: {"users":[{"uid":"..","name":".."},...]}
+static esp_err_t api_users_get_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    web_writer_t w;
+    if (web_writer_begin(&w, req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Sem memoria");
+    }
+    web_writer_str(&w, "{\"users\":[");
+    write_users(&w, web_render_user);
+    web_writer_str(&w, "]}");
+    return web_writer_end(&w);
+}
+
+// Formato pedido em ?format=csv|bin (padrão csv)
+static user_import_format_t query_format(const char *query)
+{
+    char fmt[8];
+    if (query && httpd_query_key_value(query, "format", fmt, sizeof(fmt)) == ESP_OK && strcmp(fmt, "bin") == 0) {
+        return USER_IMPORT_BIN;
+    }
+    return USER_IMPORT_CSV;
+}
+
+// Importação em lote: POST /api/users/import?mode=merge|replace&dry_run=1&format=csv|bin
+//
+// O corpo é lido em pedaços de WEB_IMPORT_RX_BUF e analisado enquanto chega
+// (user_import.c). Só com a lista inteira válida a tabela muda, de uma vez,
+// com um único commit; dry_run=1 responde o que mudaria sem alterar nada.
+//   {"ok":true,"durable":true,"dry_run":0,"parsed":N,"added":a,"updated":u,"removed":r,"unchanged":c,"total":T}
+//   {"ok":false,"msg":"...","record":L}
+// Como em send_applied, "durable":false = a lista já vale, mas a gravação
+// atrasou ou falhou e pode não sobreviver a um reboot. ok:false só quando
+// nada mudou (lista inválida ou acima de MAX_USERS).
+static esp_err_t api_users_import_handler(httpd_req_t *req)
+{
+    char query[64];
+    const char *q = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK ? query : NULL;
+    char mode_str[8] = "merge";
+    if (q) httpd_query_key_value(q, "mode", mode_str, sizeof(mode_str));
+    rfid_import_mode_t mode = strcmp(mode_str, "replace") == 0 ? RFID_IMPORT_REPLACE : RFID_IMPORT_MERGE;
+    bool dry_run = query_u32(q, "dry_run", 0) != 0;
+
+    if (req->content_len > WEB_IMPORT_MAX_BODY) {
+        return httpd_resp_send_err(req, HTTPD_413_CONTENT_TOO_LARGE, "Lista grande demais");
+    }
+
+    user_import_t *imp = malloc(sizeof(user_import_t));
+    if (!imp || !user_import_begin(imp, query_format(q), MAX_USERS)) {
+        free(imp);
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Sem memoria");
+    }
+
+    char rx[WEB_IMPORT_RX_BUF];
+    size_t left = req->content_len;
+    bool ok = true;
+    while (left > 0 && ok) {
+        int n = httpd_req_recv(req, rx, left < sizeof(rx) ? left : sizeof(rx));
+        if (n == HTTPD_SOCK_ERR_TIMEOUT) continue;
+        if (n <= 0) {
+            user_import_end(imp);
+            free(imp);
+            return ESP_FAIL;
+        }
+        left -= n;
+        ok = user_import_feed(imp, rx, n);
+    }
+    ok = ok && user_import_finish(imp);
+
+    char json[224];
+    if (!ok) {
+        snprintf(json, sizeof(json), "{\"ok\":false,\"msg\":\"%s\",\"record\":%lu}",
+                 user_import_strerror(imp->err), (unsigned long)imp->record);
+    } else {
+        rfid_import_result_t res;
+        rfid_ticket_t ticket;
+        esp_err_t err = rfid_import_users(imp->users, imp->count, mode, dry_run, &res, &ticket);
+        if (err == ESP_ERR_NO_MEM) {
+            snprintf(json, sizeof(json), "{\"ok\":false,\"msg\":\"usuarios demais\",\"total\":%lu}",
+                     (unsigned long)res.total);
+        } else {
+            // Qualquer outro erro é da fila de gravação: a tabela já mudou
+            if (err == ESP_OK && ticket) {
+                err = rfid_storage_wait(ticket, WEB_DURABLE_WAIT_MS);
+            }
+            snprintf(json, sizeof(json),
+                     "{\"ok\":true,\"durable\":%s,\"dry_run\":%d,\"parsed\":%d,\"added\":%lu,\"updated\":%lu,"
+                     "\"removed\":%lu,\"unchanged\":%lu,\"total\":%lu}",
+                     err == ESP_OK ? "true" : "false", dry_run, imp->count, (unsigned long)res.added,
+                     (unsigned long)res.updated, (unsigned long)res.removed, (unsigned long)res.unchanged,
+                     (unsigned long)res.total);
+        }
+    }
+    user_import_end(imp);
+    free(imp);
+
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_sendstr(req, json);
+}
+
+// Registro binário da exportação: tamanho + uid, tamanho + nome
+static void export_user_bin(web_writer_t *w, const rfid_user_t *user, int index)
+{
+    uint8_t len = (uint8_t)strnlen(user->uid, MAX_UID_LEN - 1);
+    web_writer_write(w, (const char *)&len, 1);
+    web_writer_write(w, user->uid, len);
+    len = (uint8_t)strnlen(user->name, MAX_NAME_LEN - 1);
+    web_writer_write(w, (const char *)&len, 1);
+    web_writer_write(w, user->name, len);
+}
+
+static void export_user_csv(web_writer_t *w, const rfid_user_t *user, int index)
+{
+    const char *name = user->name;
+    if (strpbrk(name, ",\"")) {
+        // Aspas no CSV: "" dentro do campo
+        web_writer_printf(w, "%s,\"", user->uid);
+        for (const char *c = name; *c; c++) {
+            web_writer_write(w, c, 1);
+            if (*c == '"') web_writer_write(w, c, 1);
+        }
+        web_writer_str(w, "\"\n");
+    } else {
+        web_writer_printf(w, "%s,%s\n", user->uid, name);
+    }
+}
+
+// Exportação: GET /api/users/export?format=csv|bin, no formato aceito pela importação
+static esp_err_t api_users_export_handler(httpd_req_t *req)
+{
+    char query[32];
+    const char *q = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK ? query : NULL;
+    bool bin = query_format(q) == USER_IMPORT_BIN;
+
+    httpd_resp_set_type(req, bin ? "application/octet-stream" : "text/csv");
+    httpd_resp_set_hdr(req, "Content-Disposition", bin ? "attachment; filename=\"users.bin\"" :
+                                                         "attachment; filename=\"users.csv\"");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    web_writer_t w;
+    if (web_writer_begin(&w, req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Sem memoria");
+    }
+    web_writer_str(&w, bin ? USER_IMPORT_BIN_MAGIC : "uid,name\n");
+    write_users(&w, bin ? export_user_bin : export_user_csv);
+    return web_writer_end(&w);
+}
+
+// Resultado de uma alteração: {"ok":true,"msg":"..."}
+static esp_err_t send_result(httpd_req_t *req, bool ok, const char *msg)
+{
+    char json[96];
+    snprintf(json, sizeof(json), "{\"ok\":%s,\"msg\":\"%s\"}", ok ? "true" : "false", msg);
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_sendstr(req, json);
+}
+
+// Alteração já aplicada na tabela em RAM: espera a flash e diz se ficou
+// durável. {"ok":true,"durable":false} = vale agora, mas pode não
+// sobreviver a um reboot (gravação atrasada ou falhou).
+static esp_err_t send_applied(httpd_req_t *req, rfid_ticket_t ticket, const char *what)
+{
+    esp_err_t err = rfid_storage_wait(ticket, WEB_DURABLE_WAIT_MS);
+    char json[160];
+    snprintf(json, sizeof(json), "{\"ok\":true,\"durable\":%s,\"msg\":\"%s%s\"}",
+             err == ESP_OK ? "true" : "false", what,
+             err == ESP_OK ? " com sucesso." :
+             err == ESP_ERR_TIMEOUT ? ", mas ainda não gravado na flash." :
+                                      ", mas a gravação na flash falhou.");
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_sendstr(req, json);
 }
 
 // Adicionar usuário
@@ -97,16 +335,23 @@ static esp_err_t add_user_handler(httpd_req_t *req)
         httpd_query_key_value(buf, "uid", uid, sizeof(uid));
         httpd_query_key_value(buf, "name", name, sizeof(name));
         if (strlen(uid) > 0 && strlen(name) > 0) {
-            if (rfid_add_user(uid, name) == ESP_OK) {
-                httpd_resp_sendstr(req, "Usuário adicionado com sucesso.<br><a href=\"/users\">Voltar</a>");
+            // Responde depois da flash: o usuário vê se sobrevive a um reboot
+            rfid_ticket_t ticket;
+            esp_err_t err = rfid_add_user(uid, name, &ticket);
+            if (err == ESP_OK) {
+                send_applied(req, ticket, "Usuário adicionado");
+            } else if (err == ESP_ERR_INVALID_STATE) {
+                send_result(req, false, "UID já cadastrado.");
+            } else if (err == ESP_ERR_NO_MEM) {
+                send_result(req, false, "Limite de usuários atingido.");
             } else {
-                httpd_resp_sendstr(req, "Erro ao adicionar usuário.<br><a href=\"/manage_users\">Voltar</a>");
+                send_result(req, false, "Erro ao adicionar usuário.");
             }
         } else {
-            httpd_resp_sendstr(req, "Parâmetros inválidos.<br><a href=\"/manage_users\">Voltar</a>");
+            send_result(req, false, "Parâmetros inválidos.");
         }
     } else {
-        httpd_resp_sendstr(req, "Erro ao ler parâmetros.<br><a href=\"/manage_users\">Voltar</a>");
+        send_result(req, false, "Erro ao ler parâmetros.");
     }
     return ESP_OK;
 }
@@ -120,44 +365,307 @@ static esp_err_t remove_user_handler(httpd_req_t *req)
         char uid[32] = {0};
         httpd_query_key_value(buf, "uid", uid, sizeof(uid));
         if (strlen(uid) > 0) {
-            if (rfid_remove_user(uid) == ESP_OK) {
-                httpd_resp_sendstr(req, "Usuário removido com sucesso.<br><a href=\"/users\">Voltar</a>");
+            rfid_ticket_t ticket;
+            esp_err_t err = rfid_remove_user(uid, &ticket);
+            if (err == ESP_OK) {
+                send_applied(req, ticket, "Usuário removido");
+            } else if (err == ESP_ERR_NOT_FOUND) {
+                send_result(req, false, "UID não encontrado.");
             } else {
-                httpd_resp_sendstr(req, "UID não encontrado.<br><a href=\"/manage_users\">Voltar</a>");
+                send_result(req, false, "Erro ao remover usuário.");
             }
         } else {
-            httpd_resp_sendstr(req, "Parâmetros inválidos.<br><a href=\"/manage_users\">Voltar</a>");
+            send_result(req, false, "Parâmetros inválidos.");
         }
     } else {
-        httpd_resp_sendstr(req, "Erro ao ler parâmetros.<br><a href=\"/manage_users\">Voltar</a>");
+        send_result(req, false, "Erro ao ler parâmetros.");
     }
     return ESP_OK;
 }
 
+// Política de acesso: {"version":V,"tz":-180,"schedules":[...],"groups":[...],"members":[...]}
+// Horários e grupos vazios são omitidos; "schedule" de uma regra é o id ou "always".
+static esp_err_t api_policy_get_handler(httpd_req_t *req)
+{
+    access_policy_t *p = malloc(sizeof(access_policy_t));
+    if (!p || !access_policy_get(p)) {
+        free(p);
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Sem memoria");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    web_writer_t w;
+    if (web_writer_begin(&w, req) != ESP_OK) {
+        free(p);
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Sem memoria");
+    }
+    web_writer_printf(&w, "{\"version\":%lu,\"tz\":%d,\"schedules\":[",
+                      (unsigned long)access_policy_version(), p->utc_offset_min);
+    bool first = true;
+    for (int i = 0; i < POLICY_MAX_SCHEDULES; i++) {
+        const policy_schedule_t *sch = &p->schedules[i];
+        if (sch->n_intervals == 0) continue;
+        web_writer_printf(&w, "%s{\"id\":%d,\"intervals\":[", first ? "" : ",", i);
+        for (int j = 0; j < sch->n_intervals; j++) {
+            const policy_interval_t *iv = &sch->intervals[j];
+            web_writer_printf(&w, "%s{\"days\":%u,\"from\":\"%02u:%02u\",\"to\":\"%02u:%02u\"}", j ? "," : "",
+                              iv->days, iv->from_min / 60, iv->from_min % 60, iv->to_min / 60, iv->to_min % 60);
+        }
+        web_writer_str(&w, "]}");
+        first = false;
+    }
+    web_writer_str(&w, "],\"groups\":[");
+    first = true;
+    for (int i = 0; i < POLICY_MAX_GROUPS; i++) {
+        const policy_group_t *grp = &p->groups[i];
+        if (grp->n_rules == 0 && grp->name[0] == '\0') continue;
+        web_writer_printf(&w, "%s{\"id\":%d,\"name\":", first ? "" : ",", i);
+        web_writer_json_str(&w, grp->name);
+        web_writer_str(&w, ",\"rules\":[");
+        for (int j = 0; j < grp->n_rules; j++) {
+            const policy_rule_t *r = &grp->rules[j];
+            if (r->schedule == POLICY_ALWAYS) {
+                web_writer_printf(&w, "%s{\"doors\":%u,\"schedule\":\"always\"}", j ? "," : "", r->doors);
+            } else {
+                web_writer_printf(&w, "%s{\"doors\":%u,\"schedule\":%u}", j ? "," : "", r->doors, r->schedule);
+            }
+        }
+        web_writer_str(&w, "]}");
+        first = false;
+    }
+    web_writer_str(&w, "],\"members\":[");
+    for (int i = 0; i < p->n_members && !web_writer_failed(&w); i++) {
+        web_writer_str(&w, i ? ",{\"uid\":" : "{\"uid\":");
+        web_writer_json_str(&w, p->members[i].uid);
+        web_writer_str(&w, ",\"groups\":[");
+        bool first_group = true;
+        for (int g = 0; g < POLICY_MAX_GROUPS; g++) {
+            if (!(p->members[i].groups & (1u << g))) continue;
+            web_writer_printf(&w, first_group ? "%d" : ",%d", g);
+            first_group = false;
+        }
+        web_writer_str(&w, "]}");
+    }
+    web_writer_str(&w, "]}");
+    free(p);
+    return web_writer_end(&w);
+}
+
+// Alteração da política: POST /api/policy?op=...  (formato em access_policy.h)
+static esp_err_t api_policy_post_handler(httpd_req_t *req)
+{
+    char query[128], msg[64];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK) {
+        return send_result(req, false, "Erro ao ler parâmetros.");
+    }
+    esp_err_t err = access_policy_apply(query, msg, sizeof(msg));
+    return send_result(req, err == ESP_OK, msg);
+}
+
+// Métricas para o Prometheus: GET /metrics (registro em metrics.h). Os
+// contadores que os módulos já mantêm são lidos aqui, na coleta.
+static esp_err_t metrics_get_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "text/plain; version=0.0.4; charset=utf-8");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    web_writer_t w;
+    if (web_writer_begin(&w, req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Sem memoria");
+    }
+    metrics_render(&w);
+
+    access_pipeline_stats_t acc;
+    access_pipeline_get_stats(&acc);
+    metrics_render_header(&w, "rfid_access_decisions_total", "counter", "Decisoes de acesso");
+    web_writer_printf(&w, "rfid_access_decisions_total{decision=\"granted\"} %lu\n"
+                          "rfid_access_decisions_total{decision=\"denied\"} %lu\n",
+                      (unsigned long)acc.granted, (unsigned long)acc.denied);
+    metrics_render_header(&w, "rfid_access_dropped_total", "counter", "Eventos descartados por fila cheia, por estagio");
+    web_writer_printf(&w, "rfid_access_dropped_total{stage=\"decide\"} %lu\n"
+                          "rfid_access_dropped_total{stage=\"log\"} %lu\n"
+                          "rfid_access_dropped_total{stage=\"notify\"} %lu\n",
+                      (unsigned long)acc.dropped_decide, (unsigned long)acc.dropped_log,
+                      (unsigned long)acc.dropped_notify);
+    metrics_render_value(&w, "rfid_access_deny_cache_hits_total", "counter",
+                         "Negacoes respondidas pelo cache de negacao", acc.deny_cache_hits);
+    metrics_render_value(&w, "rfid_access_boot_acl_decisions_total", "counter",
+                         "Decisoes tomadas pela ACL de boot, antes das tabelas completas", acc.boot_decisions);
+
+    // Marcos do boot em estágios (fast_boot.h); 0 = ainda não chegou
+    fast_boot_stats_t boot;
+    fast_boot_get_stats(&boot);
+    metrics_render_header(&w, "rfid_boot_stage_seconds", "gauge", "Marcos do boot desde o inicio da aplicacao");
+    for (int i = 0; i < FAST_BOOT_STAGE_COUNT; i++) {
+        int64_t us = boot.stage_us[i];
+        web_writer_printf(&w, "rfid_boot_stage_seconds{stage=\"%s\"} %lu.%06lu\n",
+                          fast_boot_stage_name((fast_boot_stage_t)i), (unsigned long)(us / 1000000),
+                          (unsigned long)(us % 1000000));
+    }
+    metrics_render_value(&w, "rfid_boot_acl_entries", "gauge", "Entradas da ACL de boot lida neste boot",
+                         boot.acl_entries);
+    metrics_render_value(&w, "rfid_boot_acl_writes_total", "counter", "Snapshots da ACL de boot gravados",
+                         boot.acl_writes);
+
+    app_zb_stats_t zb;
+    app_zb_get_stats(&zb);
+    metrics_render_value(&w, "rfid_zigbee_frames_acked_total", "counter", "Reports confirmados pelo APS", zb.frames_sent);
+    metrics_render_value(&w, "rfid_zigbee_events_acked_total", "counter", "Eventos entregues ao coordenador", zb.events_sent);
+    metrics_render_value(&w, "rfid_zigbee_events_dropped_total", "counter", "Eventos perdidos por fila cheia", zb.dropped);
+    metrics_render_value(&w, "rfid_zigbee_retries_total", "counter", "Repeticoes apos erro ou timeout do APS", zb.retries);
+    metrics_render_value(&w, "rfid_zigbee_queued_events", "gauge", "Eventos aguardando ACK", zb.queued);
+    metrics_render_value(&w, "rfid_zigbee_joined", "gauge", "1 se na rede Zigbee", zb.joined);
+
+    rfid_durability_t dur;
+    rfid_storage_get_durability(&dur);
+    metrics_render_value(&w, "rfid_storage_pending_records", "gauge", "Alteracoes aceitas ainda nao gravadas", dur.pending);
+    metrics_render_value(&w, "rfid_live_feed_clients", "gauge", "Clientes em /ws", live_feed_clients());
+
+    // Orçamento de RAM (mem_budget.h); pilhas por task já saem em metrics_render
+    mem_budget_sub_t ram[MEM_SUB_COUNT];
+    for (int i = 0; i < MEM_SUB_COUNT; i++) mem_budget_get((mem_subsys_t)i, &ram[i]);
+    metrics_render_header(&w, "rfid_ram_arena_bytes", "gauge", "Arenas alocadas no init, por subsistema");
+    for (int i = 0; i < MEM_SUB_COUNT; i++) {
+        web_writer_printf(&w, "rfid_ram_arena_bytes{subsystem=\"%s\"} %lu\n", mem_budget_name((mem_subsys_t)i),
+                          (unsigned long)ram[i].arena_bytes);
+    }
+    metrics_render_header(&w, "rfid_ram_init_heap_bytes", "gauge", "Heap consumido pelo init, por subsistema");
+    for (int i = 0; i < MEM_SUB_COUNT; i++) {
+        web_writer_printf(&w, "rfid_ram_init_heap_bytes{subsystem=\"%s\"} %lu\n",
+                          mem_budget_name((mem_subsys_t)i), (unsigned long)ram[i].init_heap_bytes);
+    }
+
+    return web_writer_end(&w);
+}
+
+/* ------------------- ROTAS ------------------- */
+
+// Servidor único: todas as rotas numa tabela, max_uri_handlers sai do tamanho
+// dela. Sem handler = página estática de web_assets.c.
+typedef struct {
+    const char *uri;
+    httpd_method_t method;
+    esp_err_t (*handler)(httpd_req_t *req);
+    web_asset_id_t asset;
+} web_route_t;
+
+#define WEB_PAGE(u, a)      { .uri = (u), .method = HTTP_GET, .asset = (a) }
+#define WEB_API(u, m, h)    { .uri = (u), .method = (m), .handler = (h) }
+
+static const web_route_t routes[] = {
+    // Páginas (estáticas, gzip)
+    WEB_PAGE("/", WEB_ASSET_INDEX),
+    WEB_PAGE("/live", WEB_ASSET_LIVE),
+    WEB_PAGE("/config", WEB_ASSET_CONFIG),
+    WEB_PAGE("/rfid_logs", WEB_ASSET_LOGS),
+    WEB_PAGE("/users", WEB_ASSET_USERS),
+    WEB_PAGE("/manage_users", WEB_ASSET_USERS),
+
+    // Dados e alterações (JSON)
+    WEB_API("/api/logs",         HTTP_GET, api_logs_get_handler),
+    WEB_API("/api/users",        HTTP_GET, api_users_get_handler),
+    WEB_API("/add_user",         HTTP_GET, add_user_handler),
+    WEB_API("/remove_user",      HTTP_GET, remove_user_handler),
+    WEB_API("/api/users/import", HTTP_POST, api_users_import_handler),
+    WEB_API("/api/users/export", HTTP_GET, api_users_export_handler),
+    WEB_API("/api/policy",       HTTP_GET, api_policy_get_handler),
+    WEB_API("/api/policy",       HTTP_POST, api_policy_post_handler),
+
+    // Porta e leitor
+    WEB_API("/status",           HTTP_GET, status_get_handler),
+    WEB_API("/open",             HTTP_GET, open_get_handler),
+    WEB_API("/clear",            HTTP_GET, clear_get_handler),
+
+    WEB_API("/metrics",          HTTP_GET, metrics_get_handler),
+};
+
+#define WEB_ROUTE_COUNT     (sizeof(routes) / sizeof(routes[0]))
+#define WEB_EXTRA_HANDLERS  1       // /ws (live_feed.c)
+
 /* ------------------- SERVER START ------------------- */
-httpd_handle_t start_webserver(void)
+
+// SoftAP com SSID/senha do sdkconfig (CONFIG_ESP_WIFI_SOFTAP_*)
+static esp_err_t wifi_init_softap(void)
+{
+    esp_err_t err = esp_netif_init();
+    if (err == ESP_OK) err = esp_event_loop_create_default();
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) return err;     // loop já criado: ok
+    esp_netif_create_default_wifi_ap();
+
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    err = esp_wifi_init(&cfg);
+    if (err != ESP_OK) return err;
+
+    wifi_config_t wifi_config = {
+        .ap = {
+            .ssid = CONFIG_ESP_WIFI_SOFTAP_SSID,
+            .ssid_len = 0,
+            .channel = CONFIG_ESP_WIFI_SOFTAP_CHANNEL,
+            .password = CONFIG_ESP_WIFI_SOFTAP_PASSWORD,
+            .max_connection = CONFIG_ESP_WIFI_SOFTAP_MAX_STA_CONN,
+            .authmode = WIFI_AUTH_WPA_WPA2_PSK
+        },
+    };
+    if (strlen(CONFIG_ESP_WIFI_SOFTAP_PASSWORD) == 0) {
+        wifi_config.ap.authmode = WIFI_AUTH_OPEN;
+    }
+
+    err = esp_wifi_set_mode(WIFI_MODE_AP);
+    if (err == ESP_OK) err = esp_wifi_set_config(WIFI_IF_AP, &wifi_config);
+    if (err == ESP_OK) err = esp_wifi_start();
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "SoftAP iniciado: SSID %s", CONFIG_ESP_WIFI_SOFTAP_SSID);
+    }
+    return err;
+}
+
+// Com close_fn definido, fechar o socket fica por nossa conta
+static void web_close_fn(httpd_handle_t hd, int sockfd)
+{
+    live_feed_session_closed(hd, sockfd);
+    close(sockfd);
+}
+
+esp_err_t app_web_start(void)
 {
+    if (server) return ESP_OK;
+
+    esp_err_t err = wifi_init_softap();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "SoftAP: %s", esp_err_to_name(err));
+        return err;
+    }
+
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.max_uri_handlers = WEB_ROUTE_COUNT + WEB_EXTRA_HANDLERS;
+    config.max_open_sockets = CONFIG_RFID_HTTP_MAX_SOCKETS;
+    config.stack_size = CONFIG_RFID_HTTP_STACK_SIZE;
+    config.lru_purge_enable = true;     // cliente novo derruba o ocioso mais antigo
+    config.close_fn = web_close_fn;     // aba fechada libera a vaga do feed
+
+    err = httpd_start(&server, &config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "httpd_start: %s", esp_err_to_name(err));
+        return err;
+    }
+    mem_budget_track_task(MEM_SUB_HTTP, "httpd", config.stack_size);
+
+    for (size_t i = 0; i < WEB_ROUTE_COUNT && err == ESP_OK; i++) {
+        const web_route_t *r = &routes[i];
+        if (r->handler) {
+            httpd_uri_t uri = { .uri = r->uri, .method = r->method, .handler = r->handler };
+            err = httpd_register_uri_handler(server, &uri);
+        } else {
+            err = web_assets_register(server, r->uri, r->asset);
+        }
+        if (err != ESP_OK) ESP_LOGE(TAG, "Rota %s: %s", r->uri, esp_err_to_name(err));
+    }
+    if (err == ESP_OK) err = live_feed_register(server);
+    if (err != ESP_OK) return err;
 
-    if (httpd_start(&server, &config) == ESP_OK) {
-        // Rotas
-        httpd_uri_t uri_root   = { .uri = "/",            .method = HTTP_GET, .handler = root_get_handler };
-        httpd_uri_t uri_cfg    = { .uri = "/config",      .method = HTTP_GET, .handler = config_get_handler };
-        httpd_uri_t uri_logs   = { .uri = "/rfid_logs",   .method = HTTP_GET, .handler = logs_get_handler };
-        httpd_uri_t uri_users  = { .uri = "/users",       .method = HTTP_GET, .handler = users_get_handler };
-        httpd_uri_t uri_manage = { .uri = "/manage_users",.method = HTTP_GET, .handler = manage_users_handler };
-        httpd_uri_t uri_add    = { .uri = "/add_user",    .method = HTTP_GET, .handler = add_user_handler };
-        httpd_uri_t uri_remove = { .uri = "/remove_user", .method = HTTP_GET, .handler = remove_user_handler };
-
-        httpd_register_uri_handler(server, &uri_root);
-        httpd_register_uri_handler(server, &uri_cfg);
-        httpd_register_uri_handler(server, &uri_logs);
-        httpd_register_uri_handler(server, &uri_users);
-        httpd_register_uri_handler(server, &uri_manage);
-        httpd_register_uri_handler(server, &uri_add);
-        httpd_register_uri_handler(server, &uri_remove);
-
-        ESP_LOGI(TAG, "Servidor HTTP iniciado");
-    }
-    return server;
+    ESP_LOGI(TAG, "Servidor HTTP iniciado: %u rotas, %d conexoes", (unsigned)WEB_ROUTE_COUNT,
+             config.max_open_sockets);
+    return ESP_OK;
 }
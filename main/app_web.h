@@ -1,5 +1,4 @@
 #pragma once
-#include "esp_http_server.h"   // <--- ESSENCIAL p/ httpd_req_t
 #include "esp_err.h"
 
 #ifdef __cplusplus
@@ -7,32 +6,12 @@ extern "C" {
 #endif
 
 /**
- * @brief Inicia o servidor web principal
- */
-void start_webserver(void);
-
-/**
- * @brief Handler da página de configuração de rede/Zigbee
- *
- * Normalmente responde a /config
- */
-esp_err_t web_handle_config_get(httpd_req_t *req);
-esp_err_t web_handle_config_post(httpd_req_t *req);
-
-/**
- * @brief Handler da página de logs dos cartões RFID lidos
- *
- * Normalmente responde a /logs
- */
-esp_err_t web_handle_logs(httpd_req_t *req);
-
-/**
- * @brief Handler da página de configuração de usuários RFID
+ * @brief Sobe o SoftAP e o servidor HTTP único (UI, API JSON, /ws, /metrics)
  *
- * Normalmente responde a /users
+ * Rotas numa tabela em app_web.c; conexões e pilha pelo Kconfig
+ * (CONFIG_RFID_HTTP_MAX_SOCKETS, CONFIG_RFID_HTTP_STACK_SIZE).
  */
-esp_err_t web_handle_users_get(httpd_req_t *req);
-esp_err_t web_handle_users_post(httpd_req_t *req);
+esp_err_t app_web_start(void);
 
 #ifdef __cplusplus
 }
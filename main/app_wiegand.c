@@ -6,35 +6,40 @@
 #include "esp_timer.h"
 #include "esp_log.h"
 #include "app_wiegand.h"
-#include "app_zigbee.h"
+#include "app_output.h"
+#include "access_pipeline.h"
+#include "metrics.h"
+#include "mem_budget.h"
 
 // ---------------------------
 // Реализация протокола Wiegand (D0/D1)
-// Подход: прерывания по фронту на D0/D1 добавляют биты (0 или 1).
-// Таймер "тишины" завершает кадр (обычно 30..50 мс).
+// Подход: прерывания по фронту на D0/D1 только сдвигают бит в 64-битный
+// регистр (wiegand_capture.h). Готовые кадры через lock-free кольцо уходят
+// задаче-декодеру; она же закрывает последний кадр по паузе (адаптивной, см.
+// WG_GAP_FACTOR). Декодированная карта уходит в конвейер доступа (access_pipeline.c).
+// Из ISR не перезапускается esp_timer и не трогаются очереди FreeRTOS на каждый бит.
 // ---------------------------
 
-#define WG_MAX_BITS     64            // поддержим до 64 бит (26..58 типично)
-#define WG_FRAME_GAP_US 40000         // 40 мс таймаут между битами
+#include "wiegand_capture.h"
+#include "wiegand_format.h"
 
 static const char *TAG = "WIEGAND";
 static wiegand_pins_t wg_pins;
 
-// Буфер для бит
-static uint8_t bit_buf[WG_MAX_BITS] = {0};
-static volatile int bit_count = 0;
+static wg_capture_t wg_cap;
+static TaskHandle_t wg_task_handle = NULL;
+static esp_timer_handle_t wg_eof_timer = NULL;   // будит задачу точно к дедлайну кадра
 
 // UID последней карты (не парсим поля, просто собираем как байты)
 static uint8_t last_uid[16] = {0};
 static size_t last_uid_len = 0;
 
-static esp_timer_handle_t frame_timer;
-
 // --- Прототипы ---
 static void IRAM_ATTR isr_d0(void* arg);
 static void IRAM_ATTR isr_d1(void* arg);
-static void frame_timeout(void* arg);
-static void apply_relay_pulse(void);
+static void wg_decoder_task(void* arg);
+static void wg_eof_timer_cb(void* arg);
+static void handle_frame(const wg_frame_t *frame);
 
 // ---------------- Инициализация ----------------
 esp_err_t wiegand_init(const wiegand_pins_t *pins)
@@ -52,28 +57,27 @@ esp_err_t wiegand_init(const wiegand_pins_t *pins)
     };
     ESP_ERROR_CHECK(gpio_config(&in_cfg));
 
-    // Выходы: LED/BUZZER/RELAY
-    gpio_config_t out_cfg = {
-        .pin_bit_mask = (1ULL<<wg_pins.gpio_led) | (1ULL<<wg_pins.gpio_buzzer) | (1ULL<<wg_pins.gpio_relay),
-        .mode = GPIO_MODE_OUTPUT,
-        .pull_up_en = GPIO_PULLUP_DISABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE,
-    };
-    ESP_ERROR_CHECK(gpio_config(&out_cfg));
-    gpio_set_level(wg_pins.gpio_led, 0);
-    gpio_set_level(wg_pins.gpio_buzzer, 0);
-    gpio_set_level(wg_pins.gpio_relay, 0);
-
-    // Таймер завершения кадра
-    const esp_timer_create_args_t targs = {
-        .callback = &frame_timeout,
-        .name = "wg_frame",
-        .arg = NULL
+    // Выходы: LED/BUZZER/RELAY управляются планировщиком (app_output.c)
+    ESP_ERROR_CHECK(app_output_init(&wg_pins));
+
+    // Задача-декодер: забирает кадры из кольца и закрывает кадр по паузе
+    wg_capture_init(&wg_cap, WG_FRAME_GAP_US);
+    const esp_timer_create_args_t eof_args = {
+        .callback = wg_eof_timer_cb,
+        .name = "wg_eof",
     };
-    ESP_ERROR_CHECK(esp_timer_create(&targs, &frame_timer));
+    ESP_ERROR_CHECK(esp_timer_create(&eof_args, &wg_eof_timer));
+    if (mem_budget_task_create(MEM_SUB_READER, wg_decoder_task, "wg_decoder", 4096, NULL, 12, &wg_task_handle) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
 
-    // Прерывания
+    // Прерывания (сервис ISR мог быть уже установлен другим модулем).
+    // IRAM: пока задача хранения пишет/стирает flash, кэш выключен, и обычная
+    // ISR ждала бы до конца стирания — фронты внутри кадра терялись бы.
+    esp_err_t err = gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        return err;
+    }
     ESP_ERROR_CHECK(gpio_isr_handler_add(wg_pins.gpio_d0, isr_d0, NULL));
     ESP_ERROR_CHECK(gpio_isr_handler_add(wg_pins.gpio_d1, isr_d1, NULL));
 
@@ -83,70 +87,95 @@ esp_err_t wiegand_init(const wiegand_pins_t *pins)
 }
 
 // ----------- Обработчики прерываний -----------
-static inline void wg_push_bit(uint8_t v)
+// Только сдвиг бита и метка времени; задачу будим один раз на кадр
+static void IRAM_ATTR wg_edge(unsigned bit)
 {
-    if (bit_count < WG_MAX_BITS) {
-        bit_buf[bit_count++] = (v ? 1 : 0);
+    if (wg_capture_edge(&wg_cap, bit, esp_timer_get_time())) {
+        BaseType_t hp_task_woken = pdFALSE;
+        vTaskNotifyGiveFromISR(wg_task_handle, &hp_task_woken);
+        portYIELD_FROM_ISR(hp_task_woken);
     }
-    // перезапускаем таймер "конца кадра"
-    esp_timer_stop(frame_timer);
-    esp_timer_start_once(frame_timer, WG_FRAME_GAP_US);
 }
 
 static void IRAM_ATTR isr_d0(void* arg)
 {
     // Импульс на D0 обозначает бит '0'
-    wg_push_bit(0);
+    wg_edge(0);
 }
 
 static void IRAM_ATTR isr_d1(void* arg)
 {
     // Импульс на D1 обозначает бит '1'
-    wg_push_bit(1);
+    wg_edge(1);
 }
 
-// ---------- Когда кадр завершился ----------
-static void frame_timeout(void* arg)
+// ---------- Задача-декодер ----------
+static void wg_eof_timer_cb(void* arg)
 {
-    // простая упаковка бит в байты слева направо
-    uint8_t bytes[16] = {0};
-    int nbits = bit_count;
-    int nbytes = (nbits + 7) / 8;
-    if (nbytes > 16) nbytes = 16;
-
-    for (int i = 0; i < nbits && i < 128; ++i) {
-        int byte_index = i / 8;
-        int bit_index = 7 - (i % 8); // MSB-first
-        if (bit_buf[i]) bytes[byte_index] |= (1 << bit_index);
-    }
+    xTaskNotifyGive(wg_task_handle);
+}
 
-    // сохраним как "последний UID"
-    memcpy(last_uid, bytes, nbytes);
-    last_uid_len = nbytes;
+static void wg_decoder_task(void* arg)
+{
+    wg_frame_t frame;
+
+    for (;;) {
+        // Сначала всё, что ISR уже закрыл сам
+        while (wg_capture_pop(&wg_cap, &frame)) {
+            handle_frame(&frame);
+        }
+
+        // Открытый кадр: ждём до его дедлайна, иначе — до следующего фронта.
+        // Дедлайн отмеряет esp_timer: ожидание в тиках (CONFIG_FREERTOS_HZ=100)
+        // добавляло до 10 мс к закрытию кадра (host/wiegand_sim --tick 10000).
+        int64_t deadline;
+        if (wg_capture_pending(&wg_cap, &deadline)) {
+            int64_t now = esp_timer_get_time();
+            if (wg_capture_poll(&wg_cap, now, &frame)) {
+                handle_frame(&frame);
+                continue;
+            }
+            esp_timer_stop(wg_eof_timer); // ESP_ERR_INVALID_STATE, если не запущен
+            // deadline <= now: кадр между вызовами закрыла ISR, она же и разбудит
+            esp_timer_start_once(wg_eof_timer, deadline > now ? (uint64_t)(deadline - now) : 1);
+        }
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
 
-    // индикация (мигнем светодиодом/бип)
-    gpio_set_level(wg_pins.gpio_led, 1);
-    gpio_set_level(wg_pins.gpio_buzzer, 1);
-    apply_relay_pulse();
+// ---------- Кадр завершён ----------
+static void handle_frame(const wg_frame_t *frame)
+{
+    // Плохие кадры (шум, обрыв, ошибка чётности) дальше не идут
+    wg_credential_t cred;
+    wg_decode_result_t res = (frame->nbits > WG_MAX_BITS) ? WG_DECODE_BAD_LENGTH
+                           : wg_decode(frame->bits, frame->nbits, &cred);
+    if (res != WG_DECODE_OK) {
+        metrics_inc(res == WG_DECODE_BAD_PARITY ? MET_WG_FRAMES_BAD_PARITY : MET_WG_FRAMES_BAD_LENGTH);
+        ESP_LOGW(TAG, "Frame rejected: %u bits, %s", frame->nbits,
+                 res == WG_DECODE_BAD_PARITY ? "parity error" : "unknown length");
+        return;
+    }
 
-    // Сообщим в Zigbee
-    app_zigbee_report_uid(last_uid, last_uid_len);
+    metrics_inc(MET_WG_FRAMES_OK);
 
-    // сброс
-    vTaskDelay(pdMS_TO_TICKS(50));
-    gpio_set_level(wg_pins.gpio_led, 0);
-    gpio_set_level(wg_pins.gpio_buzzer, 0);
+    // упаковка бит в байты слева направо (MSB-first)
+    uint8_t bytes[8] = {0};
+    int nbytes = (frame->nbits + 7) / 8;
+    uint64_t aligned = frame->bits << (64 - frame->nbits);
+    for (int i = 0; i < nbytes; ++i) {
+        bytes[i] = (uint8_t)(aligned >> (56 - 8 * i));
+    }
 
-    bit_count = 0;
-    memset(bit_buf, 0, sizeof(bit_buf));
-}
+    // сохраним как "последний UID"
+    memcpy(last_uid, bytes, nbytes);
+    last_uid_len = nbytes;
 
-static void apply_relay_pulse(void)
-{
-    // простейший импульс 500 мс
-    gpio_set_level(wg_pins.gpio_relay, 1);
-    vTaskDelay(pdMS_TO_TICKS(500));
-    gpio_set_level(wg_pins.gpio_relay, 0);
+    // решение, реле, лог и Zigbee — в конвейере; здесь только постановка в очередь
+    if (access_pipeline_submit(&cred, ACCESS_READER_DEFAULT, frame->t_last_us,
+                               esp_timer_get_time()) != ESP_OK) {
+        ESP_LOGW(TAG, "Access pipeline busy, card dropped");
+    }
 }
 
 // ---------- API ----------
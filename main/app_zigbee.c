@@ -1,6 +1,10 @@
 #include <string.h>
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
 
 // ===== ВНИМАНИЕ =====
 // Для Zigbee используются заголовки из ESP-Zigbee-SDK.
@@ -9,11 +13,30 @@
 #include "esp_zigbee_zcl.h"
 
 #include "app_zigbee.h"
+#include "time_service.h"
+#include "access_policy.h"
+#include "metrics.h"
+#include "mem_budget.h"
 
 #define APP_ENDPOINT             10
 #define APP_PROFILE_ID           ESP_ZB_AF_HA_PROFILE_ID
 #define CLUSTER_CUSTOM_ID        0xFC00
 #define ATTR_LAST_UID_ID         0x0001
+#define ATTR_ACCESS_EVENTS_ID    0x0002     // octet string, пачка событий (см. ниже)
+#define ATTR_POLICY_CMD_ID       0x0003     // char string, запись = команда политики доступа
+#define POLICY_CMD_MAX           96
+#define COORD_ENDPOINT           1          // endpoint координатора (ZHA/Z2M)
+#define ZCL_TIME_INVALID         0xFFFFFFFFu
+
+#define ZB_TASK_STACK            4096
+#define ZB_TASK_PRIO             5          // как у хранилища; ниже решения (13) и выходов (14)
+
+#ifndef ESP_ZB_DEFAULT_RADIO_CONFIG
+#define ESP_ZB_DEFAULT_RADIO_CONFIG()  { .radio_mode = ZB_RADIO_MODE_NATIVE }
+#endif
+#ifndef ESP_ZB_DEFAULT_HOST_CONFIG
+#define ESP_ZB_DEFAULT_HOST_CONFIG()   { .host_connection_mode = ZB_HOST_CONNECTION_MODE_NONE }
+#endif
 
 static const char *TAG = "ZB";
 
@@ -21,6 +44,93 @@ static const char *TAG = "ZB";
 // Хранение последнего UID как строка ZCL (первый байт длина)
 // ---------
 static uint8_t last_uid_zcl[1 + 16] = {0};
+// Последняя команда политики (строка ZCL); ответ — в логе
+static uint8_t policy_cmd_zcl[1 + POLICY_CMD_MAX] = {0};
+
+static bool time_sync_started = false;
+
+// ---------
+// Команды из других задач
+// ---------
+// Стек живёт в своей задаче (zb_task, esp_zb_stack_main_loop) и трогается
+// только из неё. Остальные задачи кладут команду в очередь и будят стек:
+// под esp_zb_lock ставят будильник на 0 мс, обработчик (pump_cb) выбирает
+// очередь уже в контексте стека. Опроса нет: задержка от постановки до
+// отправки — время до ближайшего планирования zb_task.
+#define ZB_CMD_QUEUE_LEN         16
+#define ZB_KICK_LOCK_MS          20
+#define ZB_PUMP_PERIOD_MS        2000       // страховка, если будить не удалось
+
+typedef enum {
+    ZB_CMD_REPORT_ACCESS,
+} zb_cmd_type_t;
+
+typedef struct {
+    uint64_t cred;
+    uint32_t time;
+    uint8_t flags;
+    int64_t t_enq_us;                       // постановка в очередь команд
+} zb_queued_event_t;
+
+typedef struct {
+    uint8_t type;                           // zb_cmd_type_t
+    union {
+        struct {
+            zb_queued_event_t ev;
+            char uid[17];
+        } report;
+    };
+} zb_cmd_t;
+
+static QueueHandle_t zb_cmd_queue;
+static volatile bool zb_started;           // esp_zb_lock уже можно брать
+
+// ---------
+// Очередь событий для координатора
+// ---------
+// Кольцо в RAM, только в контексте стека. При переполнении вытесняется
+// самое старое событие. Кадр снимается с очереди только после
+// APS-подтверждения; ошибка или таймаут — повтор того же окна с
+// экспоненциальной паузой. Без сети события копятся и уходят после
+// (пере)подключения.
+//
+// Формат ATTR_ACCESS_EVENTS (octet string, первый байт ZCL — длина):
+//   [ver=2][n][seq u16 LE][boot u16 LE] + n × { cred u64 LE, time u32 LE, flags u8 }
+//   flags: бит 0-1 решение, бит 2 time — unix, биты 3-7 считыватель.
+// seq — номер первого события; повтор после потерянного ACK приходит с тем
+// же seq, координатор отбрасывает дубликаты.
+// Кольцо живёт в RAM, поэтому все события в нём — из текущей загрузки.
+// Время без синхронизации переводится в unix при отправке, как только часы
+// известны; событие, ушедшее до этого, несёт секунды с загрузки, а boot
+// (time_service_boot_id) говорит, с какой именно.
+#define ZB_QUEUE_LEN             64
+#define ZB_BATCH_MAX             5          // 6 + 5*13 байт: кадр без фрагментации APS
+#define ZB_EVENT_SIZE            13
+#define ZB_FRAME_HDR             6
+#define ZB_FRAME_VERSION         2
+#define ZB_FLAG_UNIX             0x04
+#define ZB_ACK_TIMEOUT_MS        3000
+#define ZB_BACKOFF_MIN_MS        1000
+#define ZB_BACKOFF_MAX_MS        60000
+
+static zb_queued_event_t zb_queue[ZB_QUEUE_LEN];
+static uint32_t zb_head_seq;               // seq самого старого события в кольце
+static uint32_t zb_count;
+static bool zb_joined;
+static bool zb_in_flight;
+static uint8_t zb_in_flight_tsn;
+static uint32_t zb_in_flight_seq;
+static uint32_t zb_in_flight_n;
+static uint32_t zb_sent_seq;               // события до него уже были в эфире
+static uint8_t zb_ack_gen;                 // отличает устаревшие таймауты
+static uint32_t zb_backoff_ms;
+static int64_t zb_next_try_us;
+static uint8_t zb_frame[1 + ZB_FRAME_HDR + ZB_BATCH_MAX * ZB_EVENT_SIZE];
+
+// Пишет контекст стека, читает кто угодно через app_zb_get_stats
+static app_zb_stats_t zb_stats;
+static uint32_t zb_cmd_dropped;            // очередь команд полна (пишут производители)
+static portMUX_TYPE zb_stats_mux = portMUX_INITIALIZER_UNLOCKED;
 
 // ---------- Вспомогательные билдеры для эндпоинта ----------
 static esp_zb_cluster_list_t *build_cluster_list(void)
@@ -37,6 +147,9 @@ static esp_zb_cluster_list_t *build_cluster_list(void)
     };
     esp_zb_attribute_list_t *identify = esp_zb_identify_cluster_create(&identify_cfg);
 
+    // Time (клиент): читаем часы координатора, своих атрибутов нет
+    esp_zb_attribute_list_t *time_client = esp_zb_zcl_attr_list_create(ESP_ZB_ZCL_CLUSTER_ID_TIME);
+
     // Custom cluster (диапазон >0x8000 допустим для вендорских расширений)
     esp_zb_attribute_list_t *custom = esp_zb_zcl_attr_list_create(CLUSTER_CUSTOM_ID);
     esp_zb_zcl_attr_t last_uid_attr = {
@@ -46,10 +159,25 @@ static esp_zb_cluster_list_t *build_cluster_list(void)
         .data_p = &last_uid_zcl[0],
     };
     esp_zb_zcl_attr_list_add_attr(custom, &last_uid_attr);
+    esp_zb_zcl_attr_t events_attr = {
+        .id = ATTR_ACCESS_EVENTS_ID,
+        .type = ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING,
+        .access = ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING,
+        .data_p = &zb_frame[0],
+    };
+    esp_zb_zcl_attr_list_add_attr(custom, &events_attr);
+    esp_zb_zcl_attr_t policy_attr = {
+        .id = ATTR_POLICY_CMD_ID,
+        .type = ESP_ZB_ZCL_ATTR_TYPE_CHAR_STRING,
+        .access = ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE,
+        .data_p = &policy_cmd_zcl[0],
+    };
+    esp_zb_zcl_attr_list_add_attr(custom, &policy_attr);
 
     esp_zb_cluster_list_t *cluster_list = esp_zb_cluster_list_create();
     esp_zb_cluster_list_add_basic_cluster(cluster_list, basic, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
     esp_zb_cluster_list_add_identify_cluster(cluster_list, identify, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
+    esp_zb_cluster_list_add_time_cluster(cluster_list, time_client, ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE);
     esp_zb_cluster_list_add_custom_cluster(cluster_list, custom, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
 
     return cluster_list;
@@ -68,46 +196,429 @@ static esp_zb_ep_list_t *build_endpoint_list(void)
     return ep_list;
 }
 
-// --------- Инициализация Zigbee ---------
-void app_zb_init_start(void)
+// --------- Синхронизация часов (кластер Time координатора) ---------
+// Запрос раз в час; ответ разбирается в zb_action_handler. Момент приёма
+// (монотонный) фиксируется сразу, задержка сети — десятки мс.
+static void time_sync_cb(uint8_t param)
+{
+    uint16_t attrs[] = { ESP_ZB_ZCL_ATTR_TIME_TIME_ID };
+    esp_zb_zcl_read_attr_cmd_t cmd = {
+        .zcl_basic_cmd = {
+            .dst_addr_u.addr_short = 0x0000,
+            .dst_endpoint = COORD_ENDPOINT,
+            .src_endpoint = APP_ENDPOINT,
+        },
+        .address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+        .clusterID = ESP_ZB_ZCL_CLUSTER_ID_TIME,
+        .attr_number = 1,
+        .attr_field = attrs,
+    };
+    esp_zb_zcl_read_attr_cmd_req(&cmd);
+
+    // Пока часы не известны — чаще; ответ без времени просто ждёт повтора
+    esp_zb_scheduler_alarm(time_sync_cb, 0, time_service_synced() ? TIME_SYNC_PERIOD_MS : TIME_SYNC_RETRY_MS);
+}
+
+static void start_time_sync(void)
+{
+    if (time_sync_started) return;
+    time_sync_started = true;
+    esp_zb_scheduler_alarm(time_sync_cb, 0, 1000);
+}
+
+static esp_err_t handle_read_attr_resp(const esp_zb_zcl_cmd_read_attr_resp_message_t *msg)
+{
+    int64_t t_us = esp_timer_get_time();
+    if (msg->info.status != ESP_ZB_ZCL_STATUS_SUCCESS || msg->info.cluster != ESP_ZB_ZCL_CLUSTER_ID_TIME) {
+        return ESP_OK;
+    }
+
+    for (esp_zb_zcl_read_attr_resp_variable_t *var = msg->variables; var; var = var->next) {
+        if (var->status != ESP_ZB_ZCL_STATUS_SUCCESS || var->attribute.id != ESP_ZB_ZCL_ATTR_TIME_TIME_ID ||
+            var->attribute.data.type != ESP_ZB_ZCL_ATTR_TYPE_UTC_TIME || !var->attribute.data.value) {
+            continue;
+        }
+        uint32_t zcl_time;
+        memcpy(&zcl_time, var->attribute.data.value, sizeof(zcl_time));
+        if (zcl_time == ZCL_TIME_INVALID || zcl_time == 0) {
+            ESP_LOGW(TAG, "Coordinator has no valid time yet");
+            continue;
+        }
+        // UTCTime ZCL — секунды с 2000-01-01
+        time_service_sync(zcl_time + TIME_ZCL_EPOCH_OFFSET, t_us);
+    }
+    return ESP_OK;
+}
+
+// --------- Отправка очереди событий ---------
+static void put_le(uint8_t *p, uint64_t v, int n)
+{
+    for (int i = 0; i < n; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static void pump_cb(uint8_t param);
+
+static void schedule_retry(void)
+{
+    portENTER_CRITICAL(&zb_stats_mux);
+    zb_stats.retries++;
+    portEXIT_CRITICAL(&zb_stats_mux);
+    zb_backoff_ms = zb_backoff_ms ? zb_backoff_ms * 2 : ZB_BACKOFF_MIN_MS;
+    if (zb_backoff_ms > ZB_BACKOFF_MAX_MS) zb_backoff_ms = ZB_BACKOFF_MAX_MS;
+    zb_next_try_us = esp_timer_get_time() + (int64_t)zb_backoff_ms * 1000;
+    esp_zb_scheduler_alarm(pump_cb, 0, zb_backoff_ms);
+}
+
+static void ack_timeout_cb(uint8_t gen)
+{
+    if (!zb_in_flight || gen != zb_ack_gen) return;
+    zb_in_flight = false;
+    schedule_retry();
+    ESP_LOGW(TAG, "No APS ack for events #%lu (%lu), retry in %lu ms", (unsigned long)zb_in_flight_seq,
+             (unsigned long)zb_in_flight_n, (unsigned long)zb_backoff_ms);
+}
+
+static void latency_add(app_zb_latency_t *lat, int64_t us)
+{
+    uint32_t v = us < 0 ? 0 : (us > UINT32_MAX ? UINT32_MAX : (uint32_t)us);
+    lat->count++;
+    lat->last_us = v;
+    lat->sum_us += v;
+    if (v > lat->max_us) lat->max_us = v;
+}
+
+static void queue_push(const zb_queued_event_t *e)
+{
+    portENTER_CRITICAL(&zb_stats_mux);
+    if (zb_count == ZB_QUEUE_LEN) {
+        zb_head_seq++;              // вытесняем самое старое
+        zb_count--;
+        zb_stats.dropped++;
+    }
+    zb_queue[(zb_head_seq + zb_count) % ZB_QUEUE_LEN] = *e;
+    uint32_t count = ++zb_count;
+    portEXIT_CRITICAL(&zb_stats_mux);
+    metrics_gauge_max(MET_QUEUE_ZB_EVENTS, count);
+}
+
+static void set_last_uid(const char *uid)
+{
+    size_t len = strnlen(uid, sizeof(last_uid_zcl) - 1);
+    last_uid_zcl[0] = (uint8_t)len;
+    memcpy(&last_uid_zcl[1], uid, len);
+    esp_zb_zcl_set_attribute_val(APP_ENDPOINT, CLUSTER_CUSTOM_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                 ATTR_LAST_UID_ID, last_uid_zcl, false);
+}
+
+static void drain_commands(void)
+{
+    zb_cmd_t cmd;
+    while (xQueueReceive(zb_cmd_queue, &cmd, 0) == pdTRUE) {
+        metrics_gauge_max(MET_QUEUE_ZB_CMD, uxQueueMessagesWaiting(zb_cmd_queue) + 1);
+        switch (cmd.type) {
+        case ZB_CMD_REPORT_ACCESS:
+            queue_push(&cmd.report.ev);
+            if (cmd.report.uid[0]) set_last_uid(cmd.report.uid);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+// Одна пачка за раз: следующая — после ACK текущей
+static void pump_cb(uint8_t param)
+{
+    drain_commands();
+    int64_t now = esp_timer_get_time();
+    if (!zb_joined || zb_in_flight || now < zb_next_try_us) return;
+
+    uint32_t n = zb_count < ZB_BATCH_MAX ? zb_count : ZB_BATCH_MAX;
+    uint32_t seq = zb_head_seq;
+    uint8_t *p = &zb_frame[1 + ZB_FRAME_HDR];
+    for (uint32_t i = 0; i < n; i++) {
+        zb_queued_event_t *e = &zb_queue[(seq + i) % ZB_QUEUE_LEN];
+        uint32_t unix_s;
+        if (!(e->flags & ZB_FLAG_UNIX) && time_service_to_unix((int64_t)e->time * 1000000, &unix_s)) {
+            e->time = unix_s;       // в кольце: повтор уйдёт уже с unix
+            e->flags |= ZB_FLAG_UNIX;
+        }
+        put_le(p, e->cred, 8);
+        put_le(p + 8, e->time, 4);
+        p[12] = e->flags;
+        p += ZB_EVENT_SIZE;
+    }
+    if (n == 0) return;
+
+    zb_frame[0] = (uint8_t)(p - &zb_frame[1]);
+    zb_frame[1] = ZB_FRAME_VERSION;
+    zb_frame[2] = (uint8_t)n;
+    put_le(&zb_frame[3], (uint16_t)seq, 2);
+    put_le(&zb_frame[5], time_service_boot_id(), 2);
+    esp_zb_zcl_set_attribute_val(APP_ENDPOINT, CLUSTER_CUSTOM_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                 ATTR_ACCESS_EVENTS_ID, zb_frame, false);
+
+    esp_zb_zcl_report_attr_cmd_t cmd = {
+        .zcl_basic_cmd = {
+            .dst_addr_u.addr_short = 0x0000,
+            .dst_endpoint = COORD_ENDPOINT,
+            .src_endpoint = APP_ENDPOINT,
+        },
+        .address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+        .clusterID = CLUSTER_CUSTOM_ID,
+        .direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_CLI,
+        .attributeID = ATTR_ACCESS_EVENTS_ID,
+    };
+    zb_in_flight_tsn = esp_zb_zcl_report_attr_cmd_req(&cmd);
+    metrics_inc(MET_ZB_FRAMES_TX);
+
+    // Постановка -> эфир: только первая попытка каждого события
+    portENTER_CRITICAL(&zb_stats_mux);
+    for (uint32_t i = 0; i < n; i++) {
+        if ((int32_t)(seq + i - zb_sent_seq) < 0) continue;
+        latency_add(&zb_stats.to_air, now - zb_queue[(seq + i) % ZB_QUEUE_LEN].t_enq_us);
+    }
+    portEXIT_CRITICAL(&zb_stats_mux);
+    if ((int32_t)(seq + n - zb_sent_seq) > 0) zb_sent_seq = seq + n;
+
+    zb_in_flight = true;
+    zb_in_flight_seq = seq;
+    zb_in_flight_n = n;
+    esp_zb_scheduler_alarm(ack_timeout_cb, ++zb_ack_gen, ZB_ACK_TIMEOUT_MS);
+}
+
+static void pump_periodic_cb(uint8_t param)
+{
+    pump_cb(0);
+    esp_zb_scheduler_alarm(pump_periodic_cb, 0, ZB_PUMP_PERIOD_MS);
+}
+
+// Результат APS для отправленных нами команд
+static void send_status_cb(esp_zb_zcl_command_send_status_message_t message)
+{
+    if (!zb_in_flight || message.tsn != zb_in_flight_tsn) return;
+    zb_in_flight = false;
+    zb_ack_gen++;
+
+    if (message.status != ESP_OK) {
+        ESP_LOGW(TAG, "Report of events #%lu failed (%s)", (unsigned long)zb_in_flight_seq,
+                 esp_err_to_name(message.status));
+        schedule_retry();
+        return;
+    }
+
+    // Пока кадр летел, переполнение могло вытеснить часть окна
+    int64_t now = esp_timer_get_time();
+    uint32_t end = zb_in_flight_seq + zb_in_flight_n;
+    portENTER_CRITICAL(&zb_stats_mux);
+    while (zb_count > 0 && (int32_t)(end - zb_head_seq) > 0) {
+        int64_t to_ack_us = now - zb_queue[zb_head_seq % ZB_QUEUE_LEN].t_enq_us;
+        latency_add(&zb_stats.to_ack, to_ack_us);
+        metrics_observe_us(MET_H_ZB_TO_ACK, to_ack_us);
+        zb_head_seq++;
+        zb_count--;
+    }
+    zb_stats.frames_sent++;
+    zb_stats.events_sent += zb_in_flight_n;
+    portEXIT_CRITICAL(&zb_stats_mux);
+    ESP_LOGD(TAG, "Events #%lu (%lu) acked, enqueue->air last %lu us, ->ack last %lu us",
+             (unsigned long)zb_in_flight_seq, (unsigned long)zb_in_flight_n,
+             (unsigned long)zb_stats.to_air.last_us, (unsigned long)zb_stats.to_ack.last_us);
+    zb_backoff_ms = 0;
+    zb_next_try_us = 0;
+    pump_cb(0);
+}
+
+static void set_joined(bool joined)
+{
+    zb_joined = joined;
+    if (!joined) return;
+
+    // Переподключение: очередь уходит сразу, без накопленной паузы
+    zb_backoff_ms = 0;
+    zb_next_try_us = 0;
+    pump_cb(0);
+}
+
+// Запись ATTR_POLICY_CMD координатором: тот же текст "op=...", что и в HTTP.
+// Компиляция идёт в фоне (access_policy.c), здесь только разбор.
+static esp_err_t handle_set_attr_value(const esp_zb_zcl_set_attr_value_message_t *msg)
+{
+    if (msg->info.status != ESP_ZB_ZCL_STATUS_SUCCESS || msg->info.cluster != CLUSTER_CUSTOM_ID ||
+        msg->attribute.id != ATTR_POLICY_CMD_ID || !msg->attribute.data.value) {
+        return ESP_OK;
+    }
+    const uint8_t *zstr = msg->attribute.data.value;
+    size_t len = zstr[0] < POLICY_CMD_MAX ? zstr[0] : POLICY_CMD_MAX;
+    char cmd[POLICY_CMD_MAX + 1], reply[64];
+    memcpy(cmd, &zstr[1], len);
+    cmd[len] = '\0';
+
+    esp_err_t err = access_policy_apply(cmd, reply, sizeof(reply));
+    ESP_LOGI(TAG, "Policy command from coordinator: %s -> %s", cmd, reply);
+    return err == ESP_OK ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id, const void *message)
+{
+    switch (callback_id) {
+    case ESP_ZB_CORE_CMD_READ_ATTR_RESP_CB_ID:
+        return handle_read_attr_resp((const esp_zb_zcl_cmd_read_attr_resp_message_t *)message);
+    case ESP_ZB_CORE_SET_ATTR_VALUE_CB_ID:
+        return handle_set_attr_value((const esp_zb_zcl_set_attr_value_message_t *)message);
+    default:
+        return ESP_OK;
+    }
+}
+
+// --------- Сигналы стека (обязательный колбэк SDK) ---------
+static void start_steering_cb(uint8_t mode_mask)
+{
+    esp_zb_bdb_start_top_level_commissioning(mode_mask);
+}
+
+void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
+{
+    esp_err_t status = signal_struct->esp_err_status;
+    esp_zb_app_signal_type_t sig = *signal_struct->p_app_signal;
+
+    switch (sig) {
+    case ESP_ZB_ZDO_SIGNAL_SKIP_STARTUP:
+        // esp_zb_start(false): стек ждёт, пока приложение запустит BDB
+        esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_INITIALIZATION);
+        break;
+    case ESP_ZB_BDB_SIGNAL_DEVICE_FIRST_START:
+    case ESP_ZB_BDB_SIGNAL_DEVICE_REBOOT:
+        if (status == ESP_OK && esp_zb_bdb_is_factory_new()) {
+            esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_NETWORK_STEERING);
+        } else if (status == ESP_OK) {
+            start_time_sync();      // уже в сети после перезагрузки
+            set_joined(true);
+        } else {
+            ESP_LOGW(TAG, "Stack init failed (%s), retrying", esp_err_to_name(status));
+            esp_zb_scheduler_alarm((esp_zb_callback_t)start_steering_cb,
+                                   ESP_ZB_BDB_MODE_INITIALIZATION, 1000);
+        }
+        break;
+    case ESP_ZB_BDB_SIGNAL_STEERING:
+        if (status == ESP_OK) {
+            ESP_LOGI(TAG, "Joined network, PAN 0x%04x, channel %d",
+                     esp_zb_get_pan_id(), esp_zb_get_current_channel());
+            start_time_sync();
+            set_joined(true);
+        } else {
+            ESP_LOGW(TAG, "Network steering failed (%s), retrying", esp_err_to_name(status));
+            esp_zb_scheduler_alarm((esp_zb_callback_t)start_steering_cb,
+                                   ESP_ZB_BDB_MODE_NETWORK_STEERING, 1000);
+        }
+        break;
+    case ESP_ZB_ZDO_SIGNAL_LEAVE:
+        ESP_LOGW(TAG, "Left network, events are kept until rejoin");
+        set_joined(false);
+        break;
+    default:
+        break;
+    }
+}
+
+// --------- Задача стека ---------
+static void zb_task(void *arg)
 {
     ESP_LOGI(TAG, "Init Zigbee stack (Router)");
 
     // Конфиг сети: роутер (для ZHA обычно удобно)
-    esp_zb_cfg_t zb_nwk_cfg = ESP_ZB_ZR_CONFIG();
+    esp_zb_cfg_t zb_nwk_cfg = {
+        .esp_zb_role = ESP_ZB_DEVICE_TYPE_ROUTER,
+        .install_code_policy = false,
+        .nwk_cfg.zczr_cfg = {
+            .max_children = 10,
+        },
+    };
     esp_zb_init(&zb_nwk_cfg);
 
     // Каналы: разрешим все, координатор выберет
     esp_zb_set_primary_network_channel_set(ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK);
 
     esp_zb_device_register(build_endpoint_list());
-    esp_zb_start(true);
+    esp_zb_core_action_handler_register(zb_action_handler);
+    esp_zb_zcl_command_send_status_handler_register(send_status_cb);
+    ESP_ERROR_CHECK(esp_zb_start(false));
+
+    esp_zb_scheduler_alarm(pump_periodic_cb, 0, ZB_PUMP_PERIOD_MS);
+    zb_started = true;
+
+    // Блокируется на событиях стека и будильниках, не возвращается
+    esp_zb_stack_main_loop();
+    vTaskDelete(NULL);
 }
 
-// --------- Отправка отчета об атрибуте при считывании карты ---------
-void app_zb_report_uid(const uint8_t *uid, size_t uid_len)
+esp_err_t app_zb_start(void)
 {
-    if (!uid) return;
-    if (uid_len > 16) uid_len = 16;
+    if (zb_cmd_queue) return ESP_OK;
 
-    last_uid_zcl[0] = (uint8_t)uid_len;
-    memcpy(&last_uid_zcl[1], uid, uid_len);
+    // Конфигурация радио + хоста
+    esp_zb_platform_config_t platform_config = {
+        .radio_config = ESP_ZB_DEFAULT_RADIO_CONFIG(),
+        .host_config  = ESP_ZB_DEFAULT_HOST_CONFIG(),
+    };
+    esp_err_t err = esp_zb_platform_config(&platform_config);
+    if (err != ESP_OK) return err;
 
-    // Локально обновим значение атрибута
-    esp_zb_zcl_set_attribute_val(APP_ENDPOINT, CLUSTER_CUSTOM_ID,
-                                 ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
-                                 ATTR_LAST_UID_ID, last_uid_zcl, true);
+    zb_cmd_queue = xQueueCreate(ZB_CMD_QUEUE_LEN, sizeof(zb_cmd_t));
+    if (!zb_cmd_queue) return ESP_ERR_NO_MEM;
 
-    // Отправим отчет координатору (обычно короткий адрес 0x0000, endpoint 1 у ZHA)
-    esp_zb_zcl_report_attr_cmd_t cmd = {
-        .dst_addr_u.addr_short = 0x0000,
-        .address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
-        .dst_endpoint = 1,
-        .src_endpoint = APP_ENDPOINT,
-        .clusterID = CLUSTER_CUSTOM_ID,
-        .attrID = ATTR_LAST_UID_ID,
+    if (mem_budget_task_create(MEM_SUB_ZIGBEE, zb_task, "zigbee", ZB_TASK_STACK, NULL, ZB_TASK_PRIO, NULL) != pdPASS) {
+        vQueueDelete(zb_cmd_queue);
+        zb_cmd_queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+// --------- Команды из других задач ---------
+static esp_err_t send_command(const zb_cmd_t *cmd)
+{
+    if (!zb_cmd_queue) return ESP_ERR_INVALID_STATE;
+    if (xQueueSend(zb_cmd_queue, cmd, 0) != pdTRUE) {
+        portENTER_CRITICAL(&zb_stats_mux);
+        zb_cmd_dropped++;
+        portEXIT_CRITICAL(&zb_stats_mux);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Будим стек; до старта или при занятом замке подберёт pump_periodic_cb
+    if (zb_started && esp_zb_lock_acquire(pdMS_TO_TICKS(ZB_KICK_LOCK_MS))) {
+        esp_zb_scheduler_alarm(pump_cb, 0, 0);
+        esp_zb_lock_release();
+    }
+    return ESP_OK;
+}
+
+esp_err_t app_zb_report_access(const app_zb_event_t *ev)
+{
+    if (!ev) return ESP_ERR_INVALID_ARG;
+
+    zb_cmd_t cmd = {
+        .type = ZB_CMD_REPORT_ACCESS,
+        .report.ev = {
+            .cred = ev->cred,
+            .time = ev->time,
+            .flags = (uint8_t)((ev->decision & 0x03) | (ev->time_valid ? ZB_FLAG_UNIX : 0) | ((ev->reader & 0x1F) << 3)),
+            .t_enq_us = esp_timer_get_time(),
+        },
     };
-    esp_zb_zcl_report_attr_cmd_req(&cmd);
+    if (ev->uid) {
+        strncpy(cmd.report.uid, ev->uid, sizeof(cmd.report.uid) - 1);
+    }
+    return send_command(&cmd);
+}
 
-    ESP_LOGI(TAG, "UID reported via Zigbee (%d bytes)", (int)uid_len);
+void app_zb_get_stats(app_zb_stats_t *out)
+{
+    portENTER_CRITICAL(&zb_stats_mux);
+    *out = zb_stats;
+    out->dropped += zb_cmd_dropped;
+    out->queued = zb_count;
+    out->joined = zb_joined;
+    portEXIT_CRITICAL(&zb_stats_mux);
 }
@@ -1,13 +1,54 @@
 #pragma once
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include "esp_err.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-void app_zb_init_start(void);
-void app_zb_report_uid(const uint8_t *uid, size_t uid_len);
+// Событие доступа для координатора. В кадр уходит в упакованном виде
+// (атрибут ATTR_ACCESS_EVENTS кастомного кластера, см. app_zigbee.c).
+typedef struct {
+    uint64_t cred;          // wg_credential_t.id
+    uint32_t time;          // unix, либо секунды с загрузки если !time_valid
+    uint8_t decision;       // RFID_LOG_DENIED / RFID_LOG_GRANTED
+    uint8_t reader;         // 0..31
+    bool time_valid;
+    const char *uid;        // текстовый UID для ATTR_LAST_UID, может быть NULL
+} app_zb_event_t;
+
+// Задержка от app_zb_report_access до события стека
+typedef struct {
+    uint32_t count;
+    uint32_t last_us;
+    uint32_t max_us;
+    uint64_t sum_us;        // среднее = sum_us / count
+} app_zb_latency_t;
+
+typedef struct {
+    uint32_t queued;        // сейчас в очереди
+    uint32_t dropped;       // вытеснены при переполнении (самые старые) или очередь команд полна
+    uint32_t frames_sent;   // кадры, подтверждённые APS
+    uint32_t events_sent;
+    uint32_t retries;       // повторы после ошибки/таймаута APS
+    bool joined;
+    app_zb_latency_t to_air;    // до первой передачи кадра с событием
+    app_zb_latency_t to_ack;    // до APS-подтверждения
+} app_zb_stats_t;
+
+// Платформа, очередь команд и задача стека (esp_zb_stack_main_loop).
+// Сам стек трогается только из этой задачи; функции ниже можно вызывать
+// из любой задачи — они лишь ставят команду в очередь.
+esp_err_t app_zb_start(void);
+
+// Ставит событие в очередь и будит отправку в контексте стека. Не блокирует
+// дольше ~20 мс; без сети события копятся и уходят после подключения.
+// ESP_ERR_NO_MEM — очередь команд полна, событие потеряно.
+esp_err_t app_zb_report_access(const app_zb_event_t *ev);
+
+void app_zb_get_stats(app_zb_stats_t *out);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,135 @@
+#include <string.h>
+#include "deny_cache.h"
+
+// ====================== Funções internas ======================
+
+static bool entry_expired(const deny_entry_t *e, int64_t now_us)
+{
+    return now_us - e->t_last_us >= DENY_WINDOW_US && now_us >= e->blocked_until_us;
+}
+
+static int64_t entry_flush_at(const deny_entry_t *e)
+{
+    int64_t end = e->t_last_us + DENY_WINDOW_US;
+    if (e->blocked_until_us > end) end = e->blocked_until_us;
+    int64_t period = e->t_first_us + DENY_FLUSH_PERIOD_US;
+    return (e->pending > 0 && period < end) ? period : end;
+}
+
+static void take_summary(deny_entry_t *e, deny_summary_t *out)
+{
+    out->cred = e->cred;
+    out->count = e->pending;
+    out->t_first_us = e->t_first_us;
+    out->t_last_us = e->t_last_us;
+    e->pending = 0;
+}
+
+static deny_entry_t *find(deny_cache_t *dc, uint64_t id)
+{
+    for (int i = 0; i < DENY_CACHE_SIZE; i++) {
+        if (dc->entries[i].cred.id == id) return &dc->entries[i];
+    }
+    return NULL;
+}
+
+// ====================== API pública ======================
+
+void deny_cache_init(deny_cache_t *dc)
+{
+    memset(dc, 0, sizeof(*dc));
+}
+
+deny_verdict_t deny_cache_check(deny_cache_t *dc, const wg_credential_t *cred,
+                                uint32_t users_version, int64_t now_us)
+{
+    deny_entry_t *e = find(dc, cred->id);
+    if (!e || e->users_version != users_version || entry_expired(e, now_us)) {
+        return DENY_MISS;
+    }
+
+    if (e->pending == 0) e->t_first_us = now_us;
+    e->pending++;
+    e->t_last_us = now_us;
+    dc->hits++;
+
+    if (now_us < e->blocked_until_us) {
+        dc->blocked++;
+        return DENY_BLOCKED;
+    }
+
+    // Insistência: bloqueia por 2 s, 4 s, 8 s... até DENY_BACKOFF_MAX_US
+    if (++e->attempts >= DENY_BACKOFF_ATTEMPTS) {
+        int64_t backoff = DENY_BACKOFF_BASE_US << e->strikes;
+        if (backoff >= DENY_BACKOFF_MAX_US) {
+            backoff = DENY_BACKOFF_MAX_US;
+        } else {
+            e->strikes++;
+        }
+        e->blocked_until_us = now_us + backoff;
+        e->attempts = 0;
+    }
+    return DENY_HIT;
+}
+
+bool deny_cache_add(deny_cache_t *dc, const wg_credential_t *cred,
+                    uint32_t users_version, int64_t now_us, deny_summary_t *evicted)
+{
+    bool has_evicted = false;
+    deny_entry_t *e = find(dc, cred->id);
+
+    if (!e) {
+        // Entrada livre ou, se não houver, a de tentativa mais antiga
+        e = &dc->entries[0];
+        for (int i = 0; i < DENY_CACHE_SIZE; i++) {
+            deny_entry_t *c = &dc->entries[i];
+            if (c->cred.id == 0) { e = c; break; }
+            if (c->t_last_us < e->t_last_us) e = c;
+        }
+        if (e->cred.id != 0 && e->pending > 0) {
+            take_summary(e, evicted);
+            has_evicted = true;
+        }
+    } else if (e->pending > 0) {
+        // Versão antiga ou janela vencida ainda não descarregada
+        take_summary(e, evicted);
+        has_evicted = true;
+    }
+
+    memset(e, 0, sizeof(*e));
+    e->cred = *cred;
+    e->users_version = users_version;
+    e->t_first_us = now_us;
+    e->t_last_us = now_us;
+    e->attempts = 1;
+    return has_evicted;
+}
+
+bool deny_cache_flush(deny_cache_t *dc, int64_t now_us, deny_summary_t *out)
+{
+    for (int i = 0; i < DENY_CACHE_SIZE; i++) {
+        deny_entry_t *e = &dc->entries[i];
+        if (e->cred.id == 0) continue;
+
+        bool expired = entry_expired(e, now_us);
+        if (e->pending > 0 && (expired || now_us - e->t_first_us >= DENY_FLUSH_PERIOD_US)) {
+            take_summary(e, out);
+            if (expired) e->cred.id = 0;
+            return true;
+        }
+        if (expired) e->cred.id = 0;
+    }
+    return false;
+}
+
+int64_t deny_cache_next_flush(const deny_cache_t *dc)
+{
+    int64_t next = INT64_MAX;
+    for (int i = 0; i < DENY_CACHE_SIZE; i++) {
+        const deny_entry_t *e = &dc->entries[i];
+        if (e->cred.id == 0 || e->pending == 0) continue;
+        int64_t t = entry_flush_at(e);
+        if (t < next) next = t;
+    }
+    return next;
+}
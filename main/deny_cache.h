@@ -0,0 +1,82 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "wiegand_format.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Cache de credenciais negadas recentemente.
+//
+// Um cartão clonado ou desconhecido encostado no leitor gera um quadro a
+// cada poucas centenas de ms. A primeira tentativa passa pela busca normal
+// e é registrada no log; as repetições dentro da janela são negadas pelo
+// cache, sem tocar na tabela de usuários nem na flash, e viram um único
+// registro agregado "N tentativas entre t0 e t1".
+//
+// Quem insiste além de DENY_BACKOFF_ATTEMPTS tentativas na janela entra em
+// backoff exponencial: durante o bloqueio nem a sequência de saída é tocada.
+// Não é thread-safe: pertence ao estágio de decisão (access_pipeline.c).
+// Não depende do ESP-IDF.
+
+#define DENY_CACHE_SIZE         16
+#define DENY_WINDOW_US          (10 * 1000000LL)   // sem tentativas por 10 s = fim da rajada
+#define DENY_FLUSH_PERIOD_US    (60 * 1000000LL)   // rajada longa: um registro por minuto
+#define DENY_BACKOFF_ATTEMPTS   5
+#define DENY_BACKOFF_BASE_US    (2 * 1000000LL)
+#define DENY_BACKOFF_MAX_US     (64 * 1000000LL)
+
+typedef enum {
+    DENY_MISS = 0,      // não está no cache: fazer a busca normal
+    DENY_HIT,           // negado pelo cache (contado no agregado)
+    DENY_BLOCKED,       // negado e em backoff: não acionar saídas
+} deny_verdict_t;
+
+typedef struct {
+    wg_credential_t cred;       // cred.id == 0: entrada livre
+    uint32_t users_version;     // versão da tabela de usuários na negação
+    int64_t  t_first_us;        // primeira tentativa ainda não registrada
+    int64_t  t_last_us;         // última tentativa
+    int64_t  blocked_until_us;
+    uint32_t pending;           // tentativas ainda não registradas no log
+    uint32_t attempts;          // tentativas desde o último backoff
+    uint8_t  strikes;           // nível do backoff exponencial
+} deny_entry_t;
+
+// Registro agregado pronto para o log
+typedef struct {
+    wg_credential_t cred;
+    uint32_t count;
+    int64_t  t_first_us;
+    int64_t  t_last_us;
+} deny_summary_t;
+
+typedef struct {
+    deny_entry_t entries[DENY_CACHE_SIZE];
+    uint32_t hits;
+    uint32_t blocked;
+} deny_cache_t;
+
+void deny_cache_init(deny_cache_t *dc);
+
+// users_version muda a cada alteração da tabela de usuários: entradas de
+// uma versão anterior são ignoradas (o cartão pode ter sido cadastrado).
+deny_verdict_t deny_cache_check(deny_cache_t *dc, const wg_credential_t *cred,
+                                uint32_t users_version, int64_t now_us);
+
+// Registra uma negação vinda da busca normal. Se for preciso despejar uma
+// entrada com tentativas pendentes, devolve o agregado dela em *evicted.
+bool deny_cache_add(deny_cache_t *dc, const wg_credential_t *cred,
+                    uint32_t users_version, int64_t now_us, deny_summary_t *evicted);
+
+// Retira um agregado vencido (rajada terminada ou longa demais).
+// Chamar em laço até retornar false.
+bool deny_cache_flush(deny_cache_t *dc, int64_t now_us, deny_summary_t *out);
+
+// Próximo instante em que deny_cache_flush terá algo; INT64_MAX se nenhum
+int64_t deny_cache_next_flush(const deny_cache_t *dc);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,313 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+
+#include "fast_boot.h"
+#include "access_policy.h"
+#include "mem_budget.h"
+#include "rfid_storage.h"
+
+static const char *TAG = "FAST_BOOT";
+
+#define ACL_MAGIC           0x4C434142u     // "BACL"
+#define ACL_VERSION         1
+#define ACL_SECTOR_SIZE     4096
+#define ACL_ENTRIES_OFFSET  32              // entradas depois do cabeçalho, no mesmo slot
+#define ACL_KEY_MASK        (~(uint64_t)0xFF)
+#define ACL_WRITER_PRIO     1               // abaixo da recompilação da política (2)
+#define ACL_DEBOUNCE_MS     1000            // importações e scripts viram uma gravação só
+
+_Static_assert(POLICY_MAX_DOORS <= 8, "portas nos 8 bits baixos da entrada");
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t entry_size;
+    uint32_t seq;               // maior sequência válida vence
+    uint32_t count;
+    uint32_t crc;               // CRC32 das entradas
+    uint32_t hdr_crc;           // CRC32 dos campos acima
+} acl_hdr_t;
+
+_Static_assert(sizeof(acl_hdr_t) <= ACL_ENTRIES_OFFSET, "cabecalho maior que o espaco reservado");
+
+static const esp_partition_t *part = NULL;
+static uint32_t slot_size = 0;
+
+// Snapshot em uso na decisão: ordenado, só leitura até o release
+static uint64_t *acl = NULL;
+static uint32_t acl_count = 0;
+
+// Slot gravado mais recente (para alternar e para pular gravações iguais)
+static int cur_slot = -1;
+static acl_hdr_t cur_hdr;
+static bool cur_intact = false;     // entradas conferidas: dá para comparar pelo CRC
+
+static TaskHandle_t writer_handle = NULL;
+static fast_boot_stats_t stats;
+
+static const char *const stage_names[FAST_BOOT_STAGE_COUNT] = {
+    [FAST_BOOT_ACL]            = "acl",
+    [FAST_BOOT_READER]         = "reader",
+    [FAST_BOOT_FIRST_DECISION] = "first_decision",
+    [FAST_BOOT_FULL_ACL]       = "full_acl",
+    [FAST_BOOT_SERVICES]       = "services",
+};
+
+// ====================== Formato ======================
+
+// FNV-1a 64; os 8 bits baixos dão lugar à máscara de portas
+static uint64_t acl_key(const char *uid) {
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (; *uid; uid++) {
+        h ^= (uint8_t)*uid;
+        h *= 0x100000001B3ULL;
+    }
+    return h & ACL_KEY_MASK;
+}
+
+static uint32_t hdr_crc(const acl_hdr_t *hdr) {
+    return esp_rom_crc32_le(0, (const uint8_t *)hdr, offsetof(acl_hdr_t, hdr_crc));
+}
+
+static bool open_partition(void) {
+    if (part) return true;
+    part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, FAST_BOOT_PARTITION);
+    if (!part) return false;
+    slot_size = (part->size / 2) & ~(uint32_t)(ACL_SECTOR_SIZE - 1);
+    return slot_size >= ACL_SECTOR_SIZE;
+}
+
+static uint32_t slot_capacity(void) {
+    return (slot_size - ACL_ENTRIES_OFFSET) / sizeof(uint64_t);
+}
+
+static bool read_hdr(int slot, acl_hdr_t *hdr) {
+    if (esp_partition_read(part, (size_t)slot * slot_size, hdr, sizeof(*hdr)) != ESP_OK) return false;
+    return hdr->magic == ACL_MAGIC && hdr->version == ACL_VERSION && hdr->entry_size == sizeof(uint64_t) &&
+           hdr->count <= slot_capacity() && hdr->hdr_crc == hdr_crc(hdr);
+}
+
+// Entradas do slot com CRC conferido; NULL se não bater (ou sem memória)
+static uint64_t *read_entries(int slot, const acl_hdr_t *hdr) {
+    uint64_t *e = malloc(hdr->count ? hdr->count * sizeof(uint64_t) : 1);
+    if (!e) return NULL;
+    size_t size = hdr->count * sizeof(uint64_t);
+    if ((size && esp_partition_read(part, (size_t)slot * slot_size + ACL_ENTRIES_OFFSET, e, size) != ESP_OK) ||
+        esp_rom_crc32_le(0, (const uint8_t *)e, size) != hdr->crc) {
+        free(e);
+        return NULL;
+    }
+    return e;
+}
+
+// ====================== Leitura no boot ======================
+
+esp_err_t fast_boot_load_acl(void) {
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+
+    if (!open_partition()) {
+        ESP_LOGW(TAG, "Particao %s ausente: decisao espera as tabelas completas", FAST_BOOT_PARTITION);
+    } else {
+        acl_hdr_t hdr[2];
+        bool valid[2] = { read_hdr(0, &hdr[0]), read_hdr(1, &hdr[1]) };
+
+        // Mais novo primeiro; se as entradas não baterem, o outro slot
+        int order[2] = { 0, 1 };
+        if (valid[0] && valid[1] && (int32_t)(hdr[1].seq - hdr[0].seq) > 0) {
+            order[0] = 1;
+            order[1] = 0;
+        }
+        for (int i = 0; i < 2 && !acl; i++) {
+            int slot = order[i];
+            if (!valid[slot]) continue;
+            acl = read_entries(slot, &hdr[slot]);
+            if (acl) {
+                acl_count = hdr[slot].count;
+                cur_slot = slot;
+                cur_hdr = hdr[slot];
+                cur_intact = true;
+                err = ESP_OK;
+            } else {
+                ESP_LOGW(TAG, "Slot %d com CRC invalido", slot);
+            }
+        }
+        // Slot válido mais novo, mesmo sem as entradas: a próxima gravação vai no outro
+        if (cur_slot < 0 && (valid[0] || valid[1])) {
+            cur_slot = order[0];
+            cur_hdr = hdr[order[0]];
+        }
+    }
+
+    stats.acl_load_us = (uint32_t)(esp_timer_get_time() - t0);
+    stats.acl_entries = acl_count;
+    stats.acl_seq = acl ? cur_hdr.seq : 0;
+    fast_boot_mark(FAST_BOOT_ACL);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "ACL de boot: %lu entradas, seq %lu, %lu us", (unsigned long)acl_count,
+                 (unsigned long)cur_hdr.seq, (unsigned long)stats.acl_load_us);
+    }
+    return err;
+}
+
+bool fast_boot_acl_loaded(void) {
+    return acl != NULL;
+}
+
+bool fast_boot_acl_check(const char *uid, uint8_t door) {
+    if (!acl || door >= POLICY_MAX_DOORS) return false;
+    uint64_t key = acl_key(uid);
+    uint32_t lo = 0, hi = acl_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        uint64_t k = acl[mid] & ACL_KEY_MASK;
+        if (k == key) return (acl[mid] & (1u << door)) != 0;
+        if (k < key) lo = mid + 1; else hi = mid;
+    }
+    return false;
+}
+
+void fast_boot_acl_release(void) {
+    free(acl);
+    acl = NULL;
+    acl_count = 0;
+}
+
+// ====================== Gravação ======================
+
+typedef struct {
+    uint64_t *entries;
+    uint32_t n;
+} acl_build_t;
+
+// Com user_lock (rfid_for_each_user): só o hash e a política, sem flash
+static void add_user(const rfid_user_t *user, void *arg) {
+    acl_build_t *b = arg;
+    uint8_t doors = 0;
+    for (int d = 0; d < POLICY_MAX_DOORS; d++) {
+        if (access_policy_check(user->uid, (uint8_t)d, false, 0)) doors |= (uint8_t)(1u << d);
+    }
+    // Sem porta liberada a ACL de boot já nega: não precisa da entrada
+    if (doors) b->entries[b->n++] = acl_key(user->uid) | doors;
+}
+
+static int cmp_entry(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Slot inativo: apaga, grava as entradas e o cabeçalho por último. Até o
+// cabeçalho estar inteiro, vale o outro slot.
+static esp_err_t write_slot(const uint64_t *entries, uint32_t n, uint32_t crc) {
+    int slot = cur_slot >= 0 ? !cur_slot : 0;
+    size_t off = (size_t)slot * slot_size;
+    acl_hdr_t hdr = {
+        .magic = ACL_MAGIC,
+        .version = ACL_VERSION,
+        .entry_size = sizeof(uint64_t),
+        .seq = cur_slot >= 0 ? cur_hdr.seq + 1 : 1,
+        .count = n,
+        .crc = crc,
+    };
+    hdr.hdr_crc = hdr_crc(&hdr);
+
+    esp_err_t err = esp_partition_erase_range(part, off, slot_size);
+    if (err == ESP_OK && n) {
+        err = esp_partition_write(part, off + ACL_ENTRIES_OFFSET, entries, n * sizeof(uint64_t));
+    }
+    if (err == ESP_OK) err = esp_partition_write(part, off, &hdr, sizeof(hdr));
+    if (err == ESP_OK) {
+        cur_slot = slot;
+        cur_hdr = hdr;
+        cur_intact = true;
+        stats.acl_writes++;
+        ESP_LOGI(TAG, "ACL de boot gravada: %lu entradas, seq %lu", (unsigned long)n, (unsigned long)hdr.seq);
+    }
+    return err;
+}
+
+esp_err_t fast_boot_save_acl(void) {
+    if (!open_partition()) return ESP_ERR_NOT_FOUND;
+
+    acl_build_t b = { .entries = malloc(MAX_USERS * sizeof(uint64_t)) };
+    if (!b.entries) return ESP_ERR_NO_MEM;
+    rfid_for_each_user(add_user, &b);
+    qsort(b.entries, b.n, sizeof(uint64_t), cmp_entry);
+
+    esp_err_t err = ESP_OK;
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)b.entries, b.n * sizeof(uint64_t));
+    if (cur_intact && cur_hdr.count == b.n && cur_hdr.crc == crc) {
+        // Igual ao gravado: nada a fazer
+    } else if (b.n > slot_capacity()) {
+        ESP_LOGE(TAG, "%lu entradas nao cabem no slot (%lu)", (unsigned long)b.n, (unsigned long)slot_capacity());
+        err = ESP_ERR_INVALID_SIZE;
+    } else {
+        err = write_slot(b.entries, b.n, crc);
+        if (err != ESP_OK) ESP_LOGE(TAG, "Falha ao gravar ACL de boot: %s", esp_err_to_name(err));
+    }
+    free(b.entries);
+    return err;
+}
+
+static void writer_task(void *arg) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        vTaskDelay(pdMS_TO_TICKS(ACL_DEBOUNCE_MS));
+        ulTaskNotifyTake(pdTRUE, 0);
+        fast_boot_save_acl();
+    }
+}
+
+esp_err_t fast_boot_writer_start(void) {
+    if (writer_handle) return ESP_OK;
+    if (mem_budget_task_create(MEM_SUB_STORAGE, writer_task, "boot_acl", 3072, NULL, ACL_WRITER_PRIO,
+                               &writer_handle) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    // Primeira conferência: snapshot ausente ou de antes de uma queda de energia
+    xTaskNotifyGive(writer_handle);
+    return ESP_OK;
+}
+
+void fast_boot_acl_changed(void) {
+    if (writer_handle) xTaskNotifyGive(writer_handle);
+}
+
+// ====================== Marcos ======================
+
+void fast_boot_mark(fast_boot_stage_t stage) {
+    if (stage < FAST_BOOT_STAGE_COUNT && stats.stage_us[stage] == 0) {
+        stats.stage_us[stage] = esp_timer_get_time();
+    }
+}
+
+void fast_boot_mark_decision(bool from_boot_acl) {
+    if (stats.stage_us[FAST_BOOT_FIRST_DECISION] != 0) return;
+    stats.first_from_boot_acl = from_boot_acl;
+    fast_boot_mark(FAST_BOOT_FIRST_DECISION);
+    ESP_LOGI(TAG, "Primeira decisao em %lld ms desde o boot (%s)",
+             (long long)(stats.stage_us[FAST_BOOT_FIRST_DECISION] / 1000),
+             from_boot_acl ? "ACL de boot" : "tabelas completas");
+}
+
+const char *fast_boot_stage_name(fast_boot_stage_t stage) {
+    return stage < FAST_BOOT_STAGE_COUNT ? stage_names[stage] : "?";
+}
+
+void fast_boot_get_stats(fast_boot_stats_t *out) {
+    *out = stats;
+}
+
+void fast_boot_report(void) {
+    ESP_LOGI(TAG, "Boot (ms desde o inicio do app): acl %lld, leitor %lld, tabelas %lld, servicos %lld",
+             (long long)(stats.stage_us[FAST_BOOT_ACL] / 1000), (long long)(stats.stage_us[FAST_BOOT_READER] / 1000),
+             (long long)(stats.stage_us[FAST_BOOT_FULL_ACL] / 1000),
+             (long long)(stats.stage_us[FAST_BOOT_SERVICES] / 1000));
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Boot rápido: a porta funciona antes do armazenamento e dos rádios.
+//
+// A tabela de usuários (snapshot em usersnap + WAL) e a política só ficam prontas
+// depois do nvs_flash_init, da leitura dos blobs e do replay do journal. Até
+// lá a decisão usa a ACL de boot: um snapshot compacto, na partição
+// "bootacl" (leitura direta, sem NVS), com uma entrada de 8 bytes por
+// usuário liberado em alguma porta sem depender de horário.
+//
+// Sem hora de parede só valem regras POLICY_ALWAYS, e a hora só chega com o
+// Zigbee; então a ACL de boot decide igual às tabelas completas nessa janela.
+// Entrada = 56 bits altos do hash FNV-1a 64 do UID | máscara de portas.
+//
+// Dois slots com número de sequência: grava o inativo (entradas antes do
+// cabeçalho) e o cabeçalho com CRC por último. Reset no meio da gravação
+// deixa o slot anterior valendo. A task de regravação só escreve quando o
+// conteúdo mudou (mesmo CRC e contagem: nada a fazer).
+
+#define FAST_BOOT_PARTITION     "bootacl"
+
+// Marcos do boot, em µs de esp_timer desde o início da aplicação
+typedef enum {
+    FAST_BOOT_ACL = 0,          // snapshot lido (ou ausente)
+    FAST_BOOT_READER,           // captura Wiegand e decisão no ar
+    FAST_BOOT_FIRST_DECISION,   // primeiro cartão decidido
+    FAST_BOOT_FULL_ACL,         // usuários e política completos; log liberado
+    FAST_BOOT_SERVICES,         // Zigbee e HTTP iniciados
+    FAST_BOOT_STAGE_COUNT
+} fast_boot_stage_t;
+
+typedef struct {
+    int64_t stage_us[FAST_BOOT_STAGE_COUNT];    // 0 = ainda não
+    uint32_t acl_entries;       // entradas do snapshot carregado
+    uint32_t acl_load_us;       // leitura + validação
+    uint32_t acl_seq;           // sequência do slot em uso
+    uint32_t acl_writes;        // snapshots gravados neste boot
+    bool first_from_boot_acl;   // primeira decisão tomada pela ACL de boot
+} fast_boot_stats_t;
+
+// Estágio 0: lê e valida o snapshot. ESP_ERR_NOT_FOUND sem snapshot válido
+// (a decisão espera as tabelas completas).
+esp_err_t fast_boot_load_acl(void);
+bool fast_boot_acl_loaded(void);
+
+// Caminho da decisão até as tabelas completas; sem lock nem flash
+bool fast_boot_acl_check(const char *uid, uint8_t door);
+
+// Tabelas completas no ar: libera a RAM do snapshot. Só a task de decisão
+// chama (é a única leitora).
+void fast_boot_acl_release(void);
+
+// Monta o snapshot das tabelas atuais e grava se mudou (bloqueia na flash)
+esp_err_t fast_boot_save_acl(void);
+
+// Task de regravação; depois de rfid_storage_init e access_policy_init
+esp_err_t fast_boot_writer_start(void);
+
+// Usuários ou política mudaram: regrava em segundo plano (não bloqueia)
+void fast_boot_acl_changed(void);
+
+// Primeiro registro de cada marco vale
+void fast_boot_mark(fast_boot_stage_t stage);
+// Task de decisão, a cada cartão: marca FAST_BOOT_FIRST_DECISION uma vez
+void fast_boot_mark_decision(bool from_boot_acl);
+const char *fast_boot_stage_name(fast_boot_stage_t stage);
+void fast_boot_get_stats(fast_boot_stats_t *out);
+void fast_boot_report(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,445 @@
+#include "flash_journal.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+
+#define JNL_SECTOR_SIZE  4096
+#define JNL_MAGIC        0x4C4E4A52u   // "RJNL"
+#define JNL_VERSION      2
+#define JNL_VERSION_V1   1             // legado: cabeçalho sem tags
+
+static const char *TAG = "flash_journal";
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t base_seq;
+    uint16_t rec_size;
+    uint8_t  version;
+    uint8_t  crc;       // CRC8 dos campos anteriores (+ tags no formato 2)
+} jnl_sector_hdr_t;
+
+// Formato 2: o mesmo cabeçalho seguido das tags
+typedef struct __attribute__((packed)) {
+    jnl_sector_hdr_t h;
+    uint32_t tag[FLASH_JOURNAL_TAGS];
+} jnl_sector_hdr_v2_t;
+
+// ====================== Funções internas ======================
+
+static uint8_t hdr_crc(const jnl_sector_hdr_v2_t *hdr)
+{
+    uint8_t crc = esp_rom_crc8_le(0, (const uint8_t *)&hdr->h, offsetof(jnl_sector_hdr_t, crc));
+    if (hdr->h.version != JNL_VERSION_V1) {
+        crc = esp_rom_crc8_le(crc, (const uint8_t *)hdr->tag, sizeof(hdr->tag));
+    }
+    return crc;
+}
+
+// Lê o cabeçalho do setor s; false se vazio ou inválido
+static bool read_hdr(const esp_partition_t *part, uint16_t s, jnl_sector_hdr_v2_t *hdr)
+{
+    if (esp_partition_read(part, (size_t)s * JNL_SECTOR_SIZE, hdr, sizeof(*hdr)) != ESP_OK) {
+        return false;
+    }
+    if (hdr->h.magic != JNL_MAGIC) return false;
+    if (hdr->h.version != JNL_VERSION && hdr->h.version != JNL_VERSION_V1) return false;
+    if (hdr->h.crc != hdr_crc(hdr)) return false;
+    if (hdr->h.version == JNL_VERSION_V1) {
+        memset(hdr->tag, 0, sizeof(hdr->tag));
+    }
+    return true;
+}
+
+static inline size_t slot_offset(const flash_journal_t *j, uint16_t sector, uint16_t slot)
+{
+    return (size_t)sector * JNL_SECTOR_SIZE + j->hdr_size + (size_t)slot * j->slot_size;
+}
+
+static bool all_erased(const uint8_t *p, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+static bool slot_is_empty(flash_journal_t *j, uint16_t sector, uint16_t slot, uint8_t *buf)
+{
+    if (esp_partition_read(j->part, slot_offset(j, sector, slot), buf, j->slot_size) != ESP_OK) {
+        return false;
+    }
+    return all_erased(buf, j->slot_size);
+}
+
+static void update_tail(flash_journal_t *j)
+{
+    uint32_t tail = j->head_seq;
+    for (uint16_t s = 0; s < j->n_sectors; s++) {
+        if (j->sector_base[s] != 0 && j->sector_base[s] < tail) {
+            tail = j->sector_base[s];
+        }
+    }
+    j->tail_seq = tail;
+}
+
+// Apaga o setor s (descartando os registros mais antigos)
+static esp_err_t erase_sector(flash_journal_t *j, uint16_t s)
+{
+    j->sector_base[s] = 0;
+    update_tail(j);
+    return esp_partition_erase_range(j->part, (size_t)s * JNL_SECTOR_SIZE, JNL_SECTOR_SIZE);
+}
+
+// Apaga o setor s e grava o cabeçalho com a seq atual e as tags dadas
+static esp_err_t open_sector_at(flash_journal_t *j, uint16_t s, const uint32_t tag[FLASH_JOURNAL_TAGS])
+{
+    esp_err_t err = ESP_OK;
+    if (j->spare_sector != s) {
+        err = erase_sector(j, s);
+    }
+    j->spare_sector = -1;
+    if (err != ESP_OK) return err;
+
+    jnl_sector_hdr_v2_t hdr = {
+        .h = {
+            .magic = JNL_MAGIC,
+            .base_seq = j->head_seq,
+            .rec_size = j->rec_size,
+            .version = j->version,
+        },
+    };
+    memcpy(hdr.tag, tag, sizeof(hdr.tag));
+    hdr.h.crc = hdr_crc(&hdr);
+    err = esp_partition_write(j->part, (size_t)s * JNL_SECTOR_SIZE, &hdr, j->hdr_size);
+    if (err != ESP_OK) return err;
+
+    j->sector_base[s] = j->head_seq;
+    memcpy(j->sector_tag[s], tag, sizeof(j->sector_tag[s]));
+    j->head_sector = s;
+    j->head_slot = 0;
+    update_tail(j);
+    return ESP_OK;
+}
+
+// Apaga o próximo setor (o mais antigo); as tags continuam as do setor atual
+static esp_err_t open_next_sector(flash_journal_t *j)
+{
+    uint32_t tag[FLASH_JOURNAL_TAGS];
+    memcpy(tag, j->sector_tag[j->head_sector], sizeof(tag));
+    return open_sector_at(j, (uint16_t)((j->head_sector + 1) % j->n_sectors), tag);
+}
+
+static esp_err_t format(flash_journal_t *j)
+{
+    ESP_LOGW(TAG, "Formatando journal '%s'", j->part->label);
+    esp_err_t err = esp_partition_erase_range(j->part, 0, (size_t)j->n_sectors * JNL_SECTOR_SIZE);
+    memset(j->sector_base, 0, j->n_sectors * sizeof(uint32_t));
+    memset(j->sector_tag, 0, j->n_sectors * sizeof(j->sector_tag[0]));
+    j->spare_sector = -1;
+    return err;
+}
+
+static void set_layout(flash_journal_t *j, uint8_t version)
+{
+    j->version = version;
+    j->hdr_size = (version == JNL_VERSION_V1) ? sizeof(jnl_sector_hdr_t) : sizeof(jnl_sector_hdr_v2_t);
+    j->slots_per_sector = (JNL_SECTOR_SIZE - j->hdr_size) / j->slot_size;
+}
+
+// ====================== API pública ======================
+
+esp_err_t flash_journal_open(flash_journal_t *j, const char *label, uint16_t rec_size)
+{
+    memset(j, 0, sizeof(*j));
+    j->spare_sector = -1;
+    j->part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (!j->part) {
+        ESP_LOGE(TAG, "Particao '%s' nao encontrada", label);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    j->rec_size = rec_size;
+    j->slot_size = rec_size + 1;
+    j->n_sectors = j->part->size / JNL_SECTOR_SIZE;
+    set_layout(j, JNL_VERSION);
+    if (j->n_sectors < 2 || j->slots_per_sector == 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    j->sector_base = calloc(j->n_sectors, sizeof(uint32_t));
+    j->sector_tag = calloc(j->n_sectors, sizeof(j->sector_tag[0]));
+    j->lock = xSemaphoreCreateMutex();
+    if (!j->sector_base || !j->sector_tag || !j->lock) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // 1) Cabeçalhos: um read por setor. O formato montado é o dos setores
+    //    existentes; misturado ou com outro rec_size, reformata.
+    bool mismatch = false;
+    uint8_t found_version = 0;
+    for (uint16_t s = 0; s < j->n_sectors; s++) {
+        jnl_sector_hdr_v2_t hdr;
+        if (!read_hdr(j->part, s, &hdr)) {
+            continue; // vazio ou cabeçalho incompleto: será apagado antes do uso
+        }
+        if (hdr.h.rec_size != rec_size || (found_version && hdr.h.version != found_version)) {
+            mismatch = true;
+            break;
+        }
+        found_version = hdr.h.version;
+        j->sector_base[s] = hdr.h.base_seq;
+        memcpy(j->sector_tag[s], hdr.tag, sizeof(hdr.tag));
+    }
+    if (mismatch) {
+        esp_err_t err = format(j);
+        if (err != ESP_OK) return err;
+        found_version = 0;
+    }
+    if (found_version == JNL_VERSION_V1) {
+        set_layout(j, JNL_VERSION_V1);
+    }
+
+    // 2) Setor mais recente
+    bool found = false;
+    for (uint16_t s = 0; s < j->n_sectors; s++) {
+        if (j->sector_base[s] != 0 && (!found || j->sector_base[s] > j->sector_base[j->head_sector])) {
+            j->head_sector = s;
+            found = true;
+        }
+    }
+
+    if (!found) {
+        // Journal vazio: o primeiro append abre o setor 0
+        j->head_sector = j->n_sectors - 1;
+        j->head_slot = j->slots_per_sector;
+        j->head_seq = 1;
+        j->tail_seq = 1;
+    } else {
+        // 3) Busca binária do primeiro slot livre (slots são gravados em ordem)
+        uint8_t buf[j->slot_size];
+        uint16_t lo = 0, hi = j->slots_per_sector;
+        while (lo < hi) {
+            uint16_t mid = lo + (hi - lo) / 2;
+            if (slot_is_empty(j, j->head_sector, mid, buf)) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        j->head_slot = lo;
+        j->head_seq = j->sector_base[j->head_sector] + lo;
+        update_tail(j);
+    }
+
+    ESP_LOGI(TAG, "Journal '%s' v%u: %u setores x %u registros, seq [%lu, %lu)",
+             label, j->version, j->n_sectors, j->slots_per_sector,
+             (unsigned long)j->tail_seq, (unsigned long)j->head_seq);
+    return ESP_OK;
+}
+
+void flash_journal_close(flash_journal_t *j)
+{
+    free(j->sector_base);
+    free(j->sector_tag);
+    if (j->lock) vSemaphoreDelete(j->lock);
+    memset(j, 0, sizeof(*j));
+}
+
+esp_err_t flash_journal_probe(const char *label, uint16_t *rec_size, uint8_t *version)
+{
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                           ESP_PARTITION_SUBTYPE_ANY, label);
+    if (!part) return ESP_ERR_NOT_FOUND;
+
+    for (uint16_t s = 0; s < part->size / JNL_SECTOR_SIZE; s++) {
+        jnl_sector_hdr_v2_t hdr;
+        if (read_hdr(part, s, &hdr)) {
+            *rec_size = hdr.h.rec_size;
+            *version = hdr.h.version;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t flash_journal_append(flash_journal_t *j, const void *rec, uint32_t *seq_out)
+{
+    if (!j->part) return ESP_ERR_INVALID_STATE;
+
+    uint8_t buf[j->slot_size];
+    memcpy(buf, rec, j->rec_size);
+    buf[j->rec_size] = esp_rom_crc8_le(0, buf, j->rec_size);
+
+    xSemaphoreTake(j->lock, portMAX_DELAY);
+
+    esp_err_t err = ESP_OK;
+    if (j->head_slot >= j->slots_per_sector) {
+        err = open_next_sector(j);
+    }
+    if (err == ESP_OK) {
+        err = esp_partition_write(j->part, slot_offset(j, j->head_sector, j->head_slot), buf, j->slot_size);
+        // Mesmo com erro o slot fica inutilizado: avança para não regravar sobre ele
+        if (seq_out) *seq_out = j->head_seq;
+        j->head_slot++;
+        j->head_seq++;
+    }
+
+    xSemaphoreGive(j->lock);
+    return err;
+}
+
+esp_err_t flash_journal_append_batch(flash_journal_t *j, const void *recs, size_t n, uint32_t *first_seq)
+{
+    if (!j->part) return ESP_ERR_INVALID_STATE;
+    if (n == 0) return ESP_OK;
+
+    size_t max_run = n < j->slots_per_sector ? n : j->slots_per_sector;
+    uint8_t *buf = malloc(max_run * j->slot_size);
+    if (!buf) return ESP_ERR_NO_MEM;
+
+    xSemaphoreTake(j->lock, portMAX_DELAY);
+
+    esp_err_t err = ESP_OK;
+    const uint8_t *src = recs;
+    size_t done = 0;
+    if (first_seq) *first_seq = j->head_seq;
+
+    while (done < n && err == ESP_OK) {
+        if (j->head_slot >= j->slots_per_sector) {
+            err = open_next_sector(j);
+            if (err != ESP_OK) break;
+        }
+
+        // Quantos cabem no setor atual: uma escrita por trecho contíguo
+        size_t run = j->slots_per_sector - j->head_slot;
+        if (run > n - done) run = n - done;
+        for (size_t i = 0; i < run; i++) {
+            uint8_t *slot = buf + i * j->slot_size;
+            memcpy(slot, src + (done + i) * j->rec_size, j->rec_size);
+            slot[j->rec_size] = esp_rom_crc8_le(0, slot, j->rec_size);
+        }
+        err = esp_partition_write(j->part, slot_offset(j, j->head_sector, j->head_slot),
+                                  buf, run * j->slot_size);
+        // Mesmo com erro os slots ficam inutilizados: avança para não regravar sobre eles
+        j->head_slot += run;
+        j->head_seq += run;
+        done += run;
+    }
+
+    xSemaphoreGive(j->lock);
+    free(buf);
+    return err;
+}
+
+esp_err_t flash_journal_prepare(flash_journal_t *j)
+{
+    if (!j->part) return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(j->lock, portMAX_DELAY);
+    esp_err_t err = ESP_OK;
+    uint16_t s = (uint16_t)((j->head_sector + 1) % j->n_sectors);
+    if (j->spare_sector != s && j->head_slot >= (j->slots_per_sector * 3) / 4) {
+        err = erase_sector(j, s);
+        j->spare_sector = (err == ESP_OK) ? s : -1;
+    }
+    xSemaphoreGive(j->lock);
+    return err;
+}
+
+uint16_t flash_journal_head_room(flash_journal_t *j, uint32_t tag[FLASH_JOURNAL_TAGS])
+{
+    if (!j->part) return 0;
+
+    xSemaphoreTake(j->lock, portMAX_DELAY);
+    uint16_t room = 0;
+    if (j->sector_base[j->head_sector] != 0 && j->head_slot < j->slots_per_sector) {
+        room = j->slots_per_sector - j->head_slot;
+    }
+    memcpy(tag, j->sector_tag[j->head_sector], sizeof(j->sector_tag[0]));
+    xSemaphoreGive(j->lock);
+    return room;
+}
+
+esp_err_t flash_journal_open_sector(flash_journal_t *j, const uint32_t tag[FLASH_JOURNAL_TAGS])
+{
+    if (!j->part) return ESP_ERR_INVALID_STATE;
+    if (j->version == JNL_VERSION_V1) return ESP_ERR_NOT_SUPPORTED;
+
+    xSemaphoreTake(j->lock, portMAX_DELAY);
+    // Setor atual ainda sem registros: regrava-o em vez de deixar dois
+    // setores com a mesma seq base
+    uint16_t s = (uint16_t)((j->head_sector + 1) % j->n_sectors);
+    if (j->sector_base[j->head_sector] != 0 && j->head_slot == 0) {
+        s = j->head_sector;
+    }
+    esp_err_t err = open_sector_at(j, s, tag);
+    xSemaphoreGive(j->lock);
+    return err;
+}
+
+esp_err_t flash_journal_read_tagged(flash_journal_t *j, uint32_t seq, void *rec,
+                                   uint32_t tag[FLASH_JOURNAL_TAGS])
+{
+    if (!j->part) return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(j->lock, portMAX_DELAY);
+
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    if (seq >= j->tail_seq && seq < j->head_seq) {
+        // Percorre do setor atual para trás: leituras recentes são as mais comuns
+        uint16_t s = j->head_sector;
+        for (uint16_t n = 0; n < j->n_sectors; n++) {
+            uint32_t base = j->sector_base[s];
+            if (base != 0 && seq >= base && seq - base < j->slots_per_sector) {
+                uint8_t buf[j->slot_size];
+                err = esp_partition_read(j->part, slot_offset(j, s, (uint16_t)(seq - base)), buf, j->slot_size);
+                if (err == ESP_OK) {
+                    if (buf[j->rec_size] != esp_rom_crc8_le(0, buf, j->rec_size)) {
+                        err = ESP_ERR_INVALID_CRC;
+                    } else {
+                        memcpy(rec, buf, j->rec_size);
+                        if (tag) memcpy(tag, j->sector_tag[s], sizeof(j->sector_tag[0]));
+                    }
+                }
+                break;
+            }
+            s = (uint16_t)((s + j->n_sectors - 1) % j->n_sectors);
+        }
+    }
+
+    xSemaphoreGive(j->lock);
+    return err;
+}
+
+esp_err_t flash_journal_read(flash_journal_t *j, uint32_t seq, void *rec)
+{
+    return flash_journal_read_tagged(j, seq, rec, NULL);
+}
+
+uint32_t flash_journal_first_seq(flash_journal_t *j)
+{
+    return j->tail_seq;
+}
+
+uint32_t flash_journal_next_seq(flash_journal_t *j)
+{
+    return j->head_seq;
+}
+
+esp_err_t flash_journal_clear(flash_journal_t *j)
+{
+    if (!j->part) return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(j->lock, portMAX_DELAY);
+    esp_err_t err = format(j);
+    if (err == ESP_OK) {
+        // Abre já o setor 0 para que a seq sobreviva a um reboot
+        static const uint32_t no_tag[FLASH_JOURNAL_TAGS] = {0};
+        err = open_sector_at(j, 0, no_tag);
+    }
+    xSemaphoreGive(j->lock);
+    return err;
+}
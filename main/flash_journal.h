@@ -0,0 +1,91 @@
+#ifndef FLASH_JOURNAL_H
+#define FLASH_JOURNAL_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// Journal circular append-only em uma partição de dados dedicada.
+//
+// Cada setor de flash começa com um cabeçalho (magic, seq base, tamanho do
+// registro) seguido de slots de tamanho fixo. O número de sequência de um
+// registro é implícito: seq = base do setor + índice do slot. Cada slot
+// termina com um CRC8 do payload; slots corrompidos (queda de energia no
+// meio da escrita) são pulados na leitura.
+//
+// Gravar um registro custa uma escrita de slot_size bytes. Quando o setor
+// enche, o próximo setor (o mais antigo) é apagado e reaproveitado.
+// Na montagem lê-se só o cabeçalho de cada setor e faz-se uma busca binária
+// no setor atual: tempo limitado, independente do número de registros.
+//
+// Formato 2: o cabeçalho leva duas palavras de "tag" definidas por quem
+// grava (ex.: tempo base do bloco), permitindo registros codificados em
+// delta contra o setor. Partições no formato 1 (sem tags) ainda montam se
+// rec_size bate, para que o conteúdo antigo possa ser migrado.
+
+#define FLASH_JOURNAL_TAGS  2
+
+typedef struct {
+    const esp_partition_t *part;
+    SemaphoreHandle_t lock;
+    uint16_t rec_size;          // payload
+    uint16_t slot_size;         // payload + CRC8
+    uint16_t slots_per_sector;
+    uint16_t n_sectors;
+    uint32_t *sector_base;      // seq base de cada setor (0 = setor vazio)
+    uint32_t (*sector_tag)[FLASH_JOURNAL_TAGS];
+    uint8_t version;            // formato montado (1 = legado, sem tags)
+    uint8_t hdr_size;
+    uint16_t head_sector;       // setor em escrita
+    uint16_t head_slot;         // próximo slot livre em head_sector
+    uint32_t head_seq;          // seq do próximo registro
+    uint32_t tail_seq;          // seq do registro mais antigo retido
+    int32_t spare_sector;       // próximo setor já apagado (-1 = nenhum)
+} flash_journal_t;
+
+// Monta o journal na partição "label". Se o formato gravado não corresponder
+// a rec_size, a partição é reformatada.
+esp_err_t flash_journal_open(flash_journal_t *j, const char *label, uint16_t rec_size);
+
+// Libera a RAM do journal (sector_base, lock); a partição fica intacta
+void flash_journal_close(flash_journal_t *j);
+
+// Lê o primeiro cabeçalho válido da partição sem montar nem formatar.
+// ESP_ERR_NOT_FOUND se a partição não existe ou está vazia.
+esp_err_t flash_journal_probe(const char *label, uint16_t *rec_size, uint8_t *version);
+
+// Acrescenta um registro; seq_out (opcional) recebe o número de sequência
+esp_err_t flash_journal_append(flash_journal_t *j, const void *rec, uint32_t *seq_out);
+
+// Acrescenta n registros consecutivos (rec_size cada) sob um único lock;
+// slots contíguos no mesmo setor saem numa só escrita de flash.
+esp_err_t flash_journal_append_batch(flash_journal_t *j, const void *recs, size_t n, uint32_t *first_seq);
+
+// Apaga com antecedência o próximo setor quando o atual passa de 3/4, para
+// que um append não pague o apagamento (~tens de ms). Chamar em tempo ocioso.
+esp_err_t flash_journal_prepare(flash_journal_t *j);
+
+// Slots livres no setor em escrita e as tags dele (0 se não há setor aberto)
+uint16_t flash_journal_head_room(flash_journal_t *j, uint32_t tag[FLASH_JOURNAL_TAGS]);
+
+// Fecha o setor atual e abre o próximo com as tags dadas (só formato 2).
+// Appends que abrem setor sozinhos (setor cheio) repetem as tags atuais.
+esp_err_t flash_journal_open_sector(flash_journal_t *j, const uint32_t tag[FLASH_JOURNAL_TAGS]);
+
+// Como flash_journal_read, devolvendo também as tags do setor do registro
+esp_err_t flash_journal_read_tagged(flash_journal_t *j, uint32_t seq, void *rec,
+                                   uint32_t tag[FLASH_JOURNAL_TAGS]);
+
+// Lê o registro seq. ESP_ERR_NOT_FOUND fora de [tail, head),
+// ESP_ERR_INVALID_CRC se o slot estiver corrompido.
+esp_err_t flash_journal_read(flash_journal_t *j, uint32_t seq, void *rec);
+
+uint32_t flash_journal_first_seq(flash_journal_t *j);
+uint32_t flash_journal_next_seq(flash_journal_t *j);
+
+// Apaga todos os registros (seq continua crescendo)
+esp_err_t flash_journal_clear(flash_journal_t *j);
+
+#endif // FLASH_JOURNAL_H
@@ -0,0 +1,238 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/socket.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+
+#include "live_feed.h"
+#include "mem_budget.h"
+
+static const char *TAG = "LIVE_FEED";
+
+#define FEED_TASK_PRIO      3       // abaixo do estágio de notificação
+#define FEED_RX_MAX         64      // mensagens do cliente são lidas e descartadas
+#define FEED_RETRY_MS       20      // nova tentativa de um quadro que não coube no socket
+#define FEED_FRAME_HDR      4       // cabeçalho WebSocket com tamanho de 16 bits
+
+typedef struct {
+    httpd_handle_t hd;              // NULL = livre
+    int fd;
+    bool drop;                      // buffer estourou: desconectar
+    uint16_t len;
+    char buf[LIVE_FEED_CLIENT_BUF];
+    // Quadro em envio (cabeçalho + linhas) e quanto já foi para o socket
+    uint16_t out_len;               // 0 = nada pendente
+    uint16_t out_off;
+    uint8_t out[FEED_FRAME_HDR + LIVE_FEED_CLIENT_BUF];
+} feed_client_t;
+
+// Clientes: arena alocada no primeiro live_feed_register
+static feed_client_t *clients = NULL;       // [LIVE_FEED_MAX_CLIENTS]
+static SemaphoreHandle_t lock = NULL;
+static TaskHandle_t feed_task_handle = NULL;
+static live_feed_stats_t stats;
+
+// Com lock
+static void free_client(feed_client_t *c) {
+    c->hd = NULL;
+    c->len = 0;
+    c->out_len = 0;
+    c->drop = false;
+    stats.clients--;
+}
+
+static esp_err_t add_client(httpd_handle_t hd, int fd) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    feed_client_t *slot = NULL;
+    for (int i = 0; i < LIVE_FEED_MAX_CLIENTS; i++) {
+        feed_client_t *c = &clients[i];
+        // fd reaproveitado de um cliente que sumiu sem ser notado
+        if (c->hd == hd && c->fd == fd) {
+            slot = c;
+            break;
+        }
+        // Aba fechada sem passar pelo close_fn (outro servidor, LRU): a vaga volta
+        if (c->hd && httpd_ws_get_fd_info(c->hd, c->fd) != HTTPD_WS_CLIENT_WEBSOCKET) {
+            ESP_LOGI(TAG, "Vaga do fd=%d recuperada", c->fd);
+            free_client(c);
+        }
+        if (!slot && c->hd == NULL) slot = c;
+    }
+    if (slot) {
+        if (slot->hd == NULL) stats.clients++;
+        slot->hd = hd;
+        slot->fd = fd;
+        slot->drop = false;
+        slot->len = 0;
+        slot->out_len = 0;
+    }
+    xSemaphoreGive(lock);
+
+    if (!slot) {
+        ESP_LOGW(TAG, "Sem vaga para o cliente fd=%d", fd);
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Cliente conectado fd=%d", fd);
+    return ESP_OK;
+}
+
+// Copia o buffer do cliente para um quadro de texto (sem o '\n' final);
+// servidor -> cliente vai sem máscara. Com lock.
+static void build_frame(feed_client_t *c) {
+    size_t n = c->len - 1;
+    size_t hdr = 2;
+    c->out[0] = 0x81;               // FIN + texto
+    if (n < 126) {
+        c->out[1] = (uint8_t)n;
+    } else {
+        c->out[1] = 126;
+        c->out[2] = (uint8_t)(n >> 8);
+        c->out[3] = (uint8_t)n;
+        hdr = 4;
+    }
+    memcpy(c->out + hdr, c->buf, n);
+    c->out_len = (uint16_t)(hdr + n);
+    c->out_off = 0;
+    c->len = 0;
+}
+
+// Envia o que couber no socket sem esperar. false = erro de envio.
+static bool send_pending(feed_client_t *c, int fd, bool *done) {
+    ssize_t r = send(fd, c->out + c->out_off, c->out_len - c->out_off, MSG_DONTWAIT);
+    if (r < 0) {
+        *done = false;
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    c->out_off += (uint16_t)r;
+    *done = c->out_off == c->out_len;
+    return true;
+}
+
+static void feed_task(void *arg) {
+    bool pending = false;
+    while (1) {
+        // Com quadro pela metade em algum cliente, volta para ver se o socket esvaziou
+        ulTaskNotifyTake(pdTRUE, pending ? pdMS_TO_TICKS(FEED_RETRY_MS) : portMAX_DELAY);
+        pending = false;
+
+        for (int i = 0; i < LIVE_FEED_MAX_CLIENTS; i++) {
+            xSemaphoreTake(lock, portMAX_DELAY);
+            feed_client_t *c = &clients[i];
+            httpd_handle_t hd = c->hd;
+            int fd = c->fd;
+            bool drop = c->drop;
+            if (hd && !drop && c->out_len == 0 && c->len > 0) build_frame(c);
+            bool has_out = c->out_len > 0;
+            if (hd && drop) free_client(c);
+            xSemaphoreGive(lock);
+
+            if (!hd || (!drop && !has_out)) continue;
+
+            // Sem bloquear: cliente lento fica com o quadro pendente e só os
+            // buffers dele enchem; os outros seguem. Fora do lock, o out do
+            // cliente é só desta task.
+            bool ok = false, done = false;
+            if (!drop && httpd_ws_get_fd_info(hd, fd) == HTTPD_WS_CLIENT_WEBSOCKET) {
+                ok = send_pending(c, fd, &done);
+            }
+            if (ok) {
+                if (done) {
+                    xSemaphoreTake(lock, portMAX_DELAY);
+                    if (c->hd == hd && c->fd == fd) c->out_len = 0;
+                    xSemaphoreGive(lock);
+                    stats.frames_sent++;
+                } else {
+                    pending = true;
+                }
+                continue;
+            }
+
+            // Buffer estourou, desconectado ou erro de envio
+            xSemaphoreTake(lock, portMAX_DELAY);
+            if (c->hd == hd && c->fd == fd) free_client(c);
+            xSemaphoreGive(lock);
+            stats.dropped_clients++;
+            httpd_sess_trigger_close(hd, fd);
+            ESP_LOGW(TAG, "Cliente fd=%d desconectado (%s)", fd, drop ? "buffer cheio" : "erro de envio");
+        }
+    }
+}
+
+static esp_err_t ws_handler(httpd_req_t *req) {
+    if (req->method == HTTP_GET) {
+        // Handshake concluído pelo servidor
+        return add_client(req->handle, httpd_req_to_sockfd(req));
+    }
+
+    uint8_t rx[FEED_RX_MAX];
+    httpd_ws_frame_t frame = { .payload = rx };
+    esp_err_t err = httpd_ws_recv_frame(req, &frame, 0);
+    if (err != ESP_OK) return err;
+    if (frame.len > sizeof(rx)) return ESP_ERR_INVALID_SIZE;
+    return frame.len ? httpd_ws_recv_frame(req, &frame, frame.len) : ESP_OK;
+}
+
+esp_err_t live_feed_register(httpd_handle_t server) {
+    if (!lock) {
+        clients = mem_budget_alloc(MEM_SUB_HTTP, LIVE_FEED_MAX_CLIENTS * sizeof(feed_client_t));
+        if (!clients) return ESP_ERR_NO_MEM;
+        lock = xSemaphoreCreateMutex();
+        if (!lock) return ESP_ERR_NO_MEM;
+        if (mem_budget_task_create(MEM_SUB_HTTP, feed_task, "live_feed", 3072, NULL, FEED_TASK_PRIO,
+                                   &feed_task_handle) != pdPASS) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    httpd_uri_t uri = {
+        .uri = LIVE_FEED_URI,
+        .method = HTTP_GET,
+        .handler = ws_handler,
+        .is_websocket = true,
+    };
+    return httpd_register_uri_handler(server, &uri);
+}
+
+void live_feed_publish(const char *json, size_t len) {
+    if (!lock || stats.clients == 0) return;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    for (int i = 0; i < LIVE_FEED_MAX_CLIENTS; i++) {
+        feed_client_t *c = &clients[i];
+        if (!c->hd || c->drop) continue;
+        if (c->len + len + 1 > sizeof(c->buf)) {
+            c->drop = true;         // a task fecha; memória por cliente não cresce
+            continue;
+        }
+        memcpy(c->buf + c->len, json, len);
+        c->len += len;
+        c->buf[c->len++] = '\n';
+    }
+    stats.published++;
+    xSemaphoreGive(lock);
+
+    xTaskNotifyGive(feed_task_handle);
+}
+
+void live_feed_session_closed(httpd_handle_t hd, int fd) {
+    if (!lock) return;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    for (int i = 0; i < LIVE_FEED_MAX_CLIENTS; i++) {
+        if (clients[i].hd == hd && clients[i].fd == fd) {
+            free_client(&clients[i]);
+            ESP_LOGI(TAG, "Cliente fd=%d saiu", fd);
+        }
+    }
+    xSemaphoreGive(lock);
+}
+
+uint32_t live_feed_clients(void) {
+    return stats.clients;
+}
+
+void live_feed_get_stats(live_feed_stats_t *out) {
+    *out = stats;
+}
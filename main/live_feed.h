@@ -0,0 +1,54 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Feed ao vivo dos acessos por WebSocket (GET /ws).
+//
+// Cada decisão vira uma linha JSON publicada para todos os clientes
+// conectados. A publicação só copia para o buffer do cliente e acorda a
+// task do feed, que faz os envios; quem publica (estágio de notificação)
+// nunca espera pela rede. Linhas acumuladas vão juntas num só quadro,
+// separadas por '\n'. A task também não espera: o quadro vai para o socket
+// com MSG_DONTWAIT e o que não couber fica pendente naquele cliente, sem
+// atrasar os outros. Cliente cujo buffer enche (lento ou travado) é
+// desconectado: pode reconectar e buscar o que perdeu em /api/logs.
+
+#ifdef CONFIG_RFID_LIVE_FEED_CLIENTS
+#define LIVE_FEED_MAX_CLIENTS   CONFIG_RFID_LIVE_FEED_CLIENTS   // Kconfig; arena no registro
+#else
+#define LIVE_FEED_MAX_CLIENTS   4       // limite de estações do SoftAP
+#endif
+#define LIVE_FEED_CLIENT_BUF    1024    // ~10 eventos por cliente
+#define LIVE_FEED_URI           "/ws"
+
+typedef struct {
+    uint32_t clients;
+    uint32_t published;
+    uint32_t frames_sent;
+    uint32_t dropped_clients;   // desconectados por buffer cheio ou erro de envio
+} live_feed_stats_t;
+
+// Registra /ws no servidor (pode ser chamado para mais de um servidor)
+esp_err_t live_feed_register(httpd_handle_t server);
+
+// Para o close_fn do servidor: libera a vaga do cliente (não fecha o socket)
+void live_feed_session_closed(httpd_handle_t hd, int fd);
+
+// Uma linha JSON sem '\n'; não bloqueia
+void live_feed_publish(const char *json, size_t len);
+
+// Para o publicador pular a formatação quando não há ninguém ouvindo
+uint32_t live_feed_clients(void);
+
+void live_feed_get_stats(live_feed_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
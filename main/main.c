@@ -5,56 +5,78 @@
 
 #include "rfid_storage.h"
 #include "rfid_reader.h"
-
-// Zigbee
-#include "esp_zigbee_core.h"
-#include "esp_zigbee_platform.h"
-#include "esp_zigbee_type.h"
-// #include "zcl/esp_zigbee_zcl.h" // se for usar clusters
+#include "access_pipeline.h"
+#include "app_zigbee.h"
+#include "app_web.h"
+#include "time_service.h"
+#include "access_policy.h"
+#include "mem_budget.h"
+#include "fast_boot.h"
+#include "swipe_bench.h"
 
 static const char *TAG = "APP_MAIN";
 
 void app_main(void)
 {
-    ESP_LOGI(TAG, "Inicializando armazenamento NVS...");
-    ESP_ERROR_CHECK(rfid_storage_init());
+    // Boot em estágios (fast_boot.h). app_main roda abaixo de tudo do
+    // caminho do cartão: depois do estágio 1 o resto sobe em segundo plano.
+    // Cada etapa mede o heap que o seu init consumiu (mem_budget.h).
+
+    // Estágio 1: porta funcionando. ACL de boot lida direto da partição
+    // (sem NVS), decisão e captura Wiegand.
+    if (fast_boot_load_acl() != ESP_OK) {
+        ESP_LOGW(TAG, "Sem ACL de boot: cartoes esperam as tabelas completas");
+    }
+    mem_budget_stage_begin();
+    ESP_ERROR_CHECK(access_pipeline_start());
+    mem_budget_stage_end(MEM_SUB_PIPELINE);
 
     ESP_LOGI(TAG, "Inicializando leitor RFID...");
+    mem_budget_stage_begin();
     ESP_ERROR_CHECK(rfid_reader_init());
+    mem_budget_stage_end(MEM_SUB_READER);
+    fast_boot_mark(FAST_BOOT_READER);
+
+    // Estágio 2: tabelas completas. A decisão troca de fonte e o log é liberado.
+    ESP_LOGI(TAG, "Inicializando armazenamento NVS...");
+    mem_budget_stage_begin();
+    ESP_ERROR_CHECK(rfid_storage_init());
+
+    // Número do boot e deriva do relógio; a hora de parede vem do Zigbee
+    ESP_ERROR_CHECK(time_service_init());
+    mem_budget_stage_end(MEM_SUB_STORAGE);
 
+    // Grupos, portas e horários; recompilada em segundo plano a cada alteração
+    mem_budget_stage_begin();
+    ESP_ERROR_CHECK(access_policy_init());
+    mem_budget_stage_end(MEM_SUB_POLICY);
+
+    access_pipeline_full_acl_ready();
+    // Mantém a ACL de boot igual às tabelas (e a regrava se o boot achou outra)
+    if (fast_boot_writer_start() != ESP_OK) {
+        ESP_LOGE(TAG, "Regravacao da ACL de boot indisponivel");
+    }
+
+#if CONFIG_RFID_BENCH
+    // Antes dos rádios: medição sem concorrência
+    swipe_bench_run();
+#endif
+
+    // Estágio 3: rádios. Pilha Zigbee na própria task (app_zigbee.c)
     ESP_LOGI(TAG, "Inicializando Zigbee...");
+    mem_budget_stage_begin();
+    ESP_ERROR_CHECK(app_zb_start());
+    mem_budget_stage_end(MEM_SUB_ZIGBEE);
 
-    // Configuração de rádio + host
-    esp_zb_platform_config_t platform_config = {
-        .radio_config = { ESP_ZB_DEFAULT_RADIO_CONFIG() },
-        .host_config  = { ESP_ZB_DEFAULT_HOST_CONFIG() },
-    };
-    ESP_ERROR_CHECK(esp_zb_platform_init(&platform_config));
-
-    // Configuração do dispositivo como ROUTER
-    esp_zb_cfg_t zb_config = {
-        .esp_zb_role = ESP_ZB_DEVICE_TYPE_ROUTER,
-        .nwk_cfg     = { ESP_ZB_DEFAULT_NETWORK_CONFIG() },
-    };
-    esp_zb_init(&zb_config);  // sem ESP_ERROR_CHECK
-
-    ESP_LOGI(TAG, "Entrando no loop principal Zigbee...");
-
-    while (true) {
-        // Iteração do loop Zigbee
-        esp_zb_main_loop_iteration();
-
-        // Aqui você pode verificar RFID periodicamente
-        char uid[32];
-        if (rfid_read_uid(uid, sizeof(uid)) == ESP_OK) {
-            if (rfid_is_user_authorized(uid)) {
-                ESP_LOGI(TAG, "UID autorizado: %s", uid);
-                rfid_add_log(uid, "2025-08-25 12:00");  // timestamp de exemplo
-            } else {
-                ESP_LOGW(TAG, "UID não autorizado: %s", uid);
-            }
-        }
-
-        vTaskDelay(pdMS_TO_TICKS(100));
+    // SoftAP + servidor HTTP único; sem ele a porta continua funcionando
+    ESP_LOGI(TAG, "Inicializando Web UI...");
+    mem_budget_stage_begin();
+    if (app_web_start() != ESP_OK) {
+        ESP_LOGE(TAG, "Web UI indisponivel");
     }
+    mem_budget_stage_end(MEM_SUB_HTTP);
+
+    access_pipeline_services_ready();
+    fast_boot_report();
+    mem_budget_report();
 }
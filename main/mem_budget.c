@@ -0,0 +1,145 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_heap_caps.h"
+#include "esp_system.h"
+#endif
+
+#include "mem_budget.h"
+
+static const char *TAG = "MEM";
+
+#define MEM_MAX_TASKS   16
+
+typedef struct {
+    const char *name;
+    TaskHandle_t handle;        // NULL: procurado pelo nome (task de componente)
+    uint32_t stack;
+    uint8_t sub;
+} mem_task_t;
+
+static const char *const sub_names[MEM_SUB_COUNT] = {
+    [MEM_SUB_STORAGE]  = "storage",
+    [MEM_SUB_POLICY]   = "policy",
+    [MEM_SUB_PIPELINE] = "pipeline",
+    [MEM_SUB_READER]   = "reader",
+    [MEM_SUB_ZIGBEE]   = "zigbee",
+    [MEM_SUB_HTTP]     = "http",
+};
+
+static mem_budget_sub_t subs[MEM_SUB_COUNT];
+static mem_task_t tasks[MEM_MAX_TASKS];
+static int n_tasks = 0;
+static uint32_t stage_free = 0;
+static portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t heap_free(void) {
+#ifdef ESP_PLATFORM
+    return esp_get_free_heap_size();
+#else
+    return 0;
+#endif
+}
+
+static void add_task(mem_subsys_t sub, const char *name, TaskHandle_t handle, uint32_t stack) {
+    portENTER_CRITICAL(&mux);
+    subs[sub].stack_bytes += stack;
+    subs[sub].tasks++;
+    if (n_tasks < MEM_MAX_TASKS) {
+        tasks[n_tasks++] = (mem_task_t){ .name = name, .handle = handle, .stack = stack, .sub = (uint8_t)sub };
+    }
+    portEXIT_CRITICAL(&mux);
+}
+
+void *mem_budget_alloc(mem_subsys_t sub, size_t size) {
+    void *p = calloc(1, size);
+    if (!p) {
+        ESP_LOGE(TAG, "Arena de %u bytes para %s: sem memoria", (unsigned)size, sub_names[sub]);
+        return NULL;
+    }
+    portENTER_CRITICAL(&mux);
+    subs[sub].arena_bytes += (uint32_t)size;
+    portEXIT_CRITICAL(&mux);
+    return p;
+}
+
+BaseType_t mem_budget_task_create(mem_subsys_t sub, TaskFunction_t fn, const char *name, uint32_t stack,
+                                  void *arg, UBaseType_t prio, TaskHandle_t *out) {
+    TaskHandle_t handle = NULL;
+    BaseType_t ret = xTaskCreate(fn, name, stack, arg, prio, &handle);
+    if (ret == pdPASS) {
+        add_task(sub, name, handle, stack);
+        if (out) *out = handle;
+    }
+    return ret;
+}
+
+void mem_budget_track_task(mem_subsys_t sub, const char *name, uint32_t stack) {
+    add_task(sub, name, NULL, stack);
+}
+
+void mem_budget_stage_begin(void) {
+    stage_free = heap_free();
+}
+
+void mem_budget_stage_end(mem_subsys_t sub) {
+    uint32_t now = heap_free();
+    if (stage_free > now) subs[sub].init_heap_bytes += stage_free - now;
+}
+
+const char *mem_budget_name(mem_subsys_t sub) {
+    return sub < MEM_SUB_COUNT ? sub_names[sub] : "?";
+}
+
+void mem_budget_get(mem_subsys_t sub, mem_budget_sub_t *out) {
+    portENTER_CRITICAL(&mux);
+    *out = subs[sub];
+    portEXIT_CRITICAL(&mux);
+
+    // Folga das pilhas: fora do lock (percorre a pilha de cada task)
+    out->stack_free_min = 0;
+#ifdef ESP_PLATFORM
+    bool first = true;
+    for (int i = 0; i < n_tasks; i++) {
+        if (tasks[i].sub != sub) continue;
+        if (!tasks[i].handle) tasks[i].handle = xTaskGetHandle(tasks[i].name);
+        if (!tasks[i].handle) continue;
+        uint32_t free_min = uxTaskGetStackHighWaterMark(tasks[i].handle);
+        if (first || free_min < out->stack_free_min) out->stack_free_min = free_min;
+        first = false;
+    }
+#endif
+}
+
+void mem_budget_report(void) {
+#ifdef ESP_PLATFORM
+    extern int _data_start, _data_end, _bss_start, _bss_end;
+    ESP_LOGI(TAG, "RAM estatica: .data %u B, .bss %u B",
+             (unsigned)((char *)&_data_end - (char *)&_data_start),
+             (unsigned)((char *)&_bss_end - (char *)&_bss_start));
+#endif
+    ESP_LOGI(TAG, "%-9s %8s %8s %6s %8s %10s", "subsist.", "arenas", "init", "tasks", "pilhas", "folga min");
+    uint32_t total_arena = 0, total_init = 0, total_stack = 0;
+    for (int i = 0; i < MEM_SUB_COUNT; i++) {
+        mem_budget_sub_t s;
+        mem_budget_get((mem_subsys_t)i, &s);
+        ESP_LOGI(TAG, "%-9s %8lu %8lu %6u %8lu %10lu", sub_names[i], (unsigned long)s.arena_bytes,
+                 (unsigned long)s.init_heap_bytes, s.tasks, (unsigned long)s.stack_bytes,
+                 (unsigned long)s.stack_free_min);
+        total_arena += s.arena_bytes;
+        total_init += s.init_heap_bytes;
+        total_stack += s.stack_bytes;
+    }
+    ESP_LOGI(TAG, "%-9s %8lu %8lu %6s %8lu", "total", (unsigned long)total_arena, (unsigned long)total_init, "",
+             (unsigned long)total_stack);
+#ifdef ESP_PLATFORM
+    ESP_LOGI(TAG, "heap: livre %lu B, minimo %lu B, maior bloco %u B", (unsigned long)esp_get_free_heap_size(),
+             (unsigned long)esp_get_minimum_free_heap_size(),
+             (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
+#endif
+}
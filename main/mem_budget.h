@@ -0,0 +1,62 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Orçamento de RAM por subsistema.
+//
+// As tabelas grandes (usuários, política compilada, lotes de gravação,
+// clientes do feed) não ficam em .bss: cada subsistema pede a sua arena no
+// init, com a capacidade do Kconfig (menu "Controle de acesso RFID"). O que
+// não é iniciado não ocupa nada, e o que cada um pegou fica contabilizado
+// aqui junto com as pilhas das tasks que ele criou.
+//
+// mem_budget_report() imprime a RAM estática (.data/.bss) e, por
+// subsistema: arenas, heap consumido pelo init (heap livre antes e depois,
+// entre mem_budget_stage_begin/end) e pilhas com a menor folga vista.
+// A divisão de .data/.bss por arquivo sai no build: idf.py size-files.
+
+typedef enum {
+    MEM_SUB_STORAGE = 0,
+    MEM_SUB_POLICY,
+    MEM_SUB_PIPELINE,
+    MEM_SUB_READER,
+    MEM_SUB_ZIGBEE,
+    MEM_SUB_HTTP,
+    MEM_SUB_COUNT
+} mem_subsys_t;
+
+typedef struct {
+    uint32_t arena_bytes;
+    uint32_t init_heap_bytes;   // 0 fora do alvo
+    uint32_t stack_bytes;
+    uint32_t stack_free_min;    // menor folga entre as tasks do subsistema (0 fora do alvo)
+    uint8_t tasks;
+} mem_budget_sub_t;
+
+// Arena de boot: zerada e nunca liberada. NULL sem memória.
+void *mem_budget_alloc(mem_subsys_t sub, size_t size);
+
+// xTaskCreate com a pilha (bytes) contada no subsistema
+BaseType_t mem_budget_task_create(mem_subsys_t sub, TaskFunction_t fn, const char *name, uint32_t stack,
+                                  void *arg, UBaseType_t prio, TaskHandle_t *out);
+
+// Task criada por um componente (ex.: "httpd"); achada pelo nome no relatório
+void mem_budget_track_task(mem_subsys_t sub, const char *name, uint32_t stack);
+
+// Heap consumido pelo init de um subsistema (chamadas em sequência, uma task)
+void mem_budget_stage_begin(void);
+void mem_budget_stage_end(mem_subsys_t sub);
+
+const char *mem_budget_name(mem_subsys_t sub);
+void mem_budget_get(mem_subsys_t sub, mem_budget_sub_t *out);
+void mem_budget_report(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,136 @@
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_system.h"
+#include "sdkconfig.h"
+#endif
+
+#include "metrics.h"
+
+uint32_t metrics_counters[MET_COUNTER_COUNT];
+uint32_t metrics_gauges[MET_GAUGE_COUNT];
+metrics_hist_data_t metrics_hists[MET_HIST_COUNT];
+
+// Amostras com rótulo entram no nome; entradas seguidas da mesma família
+// (nome até '{') compartilham HELP/TYPE.
+typedef struct {
+    const char *name;
+    const char *help;
+} metric_info_t;
+
+static const metric_info_t counter_info[MET_COUNTER_COUNT] = {
+    [MET_WG_FRAMES_OK]           = { "rfid_wiegand_frames_total{result=\"ok\"}", "Quadros Wiegand fechados, por resultado da decodificacao" },
+    [MET_WG_FRAMES_BAD_PARITY]   = { "rfid_wiegand_frames_total{result=\"bad_parity\"}", NULL },
+    [MET_WG_FRAMES_BAD_LENGTH]   = { "rfid_wiegand_frames_total{result=\"bad_length\"}", NULL },
+    [MET_STORAGE_COMMITS]        = { "rfid_storage_commits_total", "Commits em grupo da task de gravacao" },
+    [MET_STORAGE_COMMIT_RECORDS] = { "rfid_storage_commit_records_total", "Registros (usuarios e logs) gravados nos commits" },
+    [MET_STORAGE_COMMIT_BYTES]   = { "rfid_storage_commit_bytes_total", "Bytes de slots gravados nos journals" },
+    [MET_STORAGE_COMMIT_ERRORS]  = { "rfid_storage_commit_errors_total", "Commits que falharam" },
+    [MET_NVS_COMMITS]            = { "rfid_nvs_commits_total", "Chamadas de nvs_commit" },
+    [MET_ZB_FRAMES_TX]           = { "rfid_zigbee_frames_tx_total", "Reports de eventos enviados ao coordenador, com repeticoes" },
+};
+
+static const metric_info_t gauge_info[MET_GAUGE_COUNT] = {
+    [MET_QUEUE_DECIDE]    = { "rfid_queue_high_water{queue=\"decide\"}", "Maior ocupacao vista de cada fila desde o boot" },
+    [MET_QUEUE_LOG]       = { "rfid_queue_high_water{queue=\"log\"}", NULL },
+    [MET_QUEUE_NOTIFY]    = { "rfid_queue_high_water{queue=\"notify\"}", NULL },
+    [MET_QUEUE_STORAGE]   = { "rfid_queue_high_water{queue=\"storage\"}", NULL },
+    [MET_QUEUE_ZB_CMD]    = { "rfid_queue_high_water{queue=\"zigbee_cmd\"}", NULL },
+    [MET_QUEUE_ZB_EVENTS] = { "rfid_queue_high_water{queue=\"zigbee_events\"}", NULL },
+};
+
+static const metric_info_t hist_info[MET_HIST_COUNT] = {
+    [MET_H_SWIPE_TO_DECISION] = { "rfid_swipe_to_decision_seconds", "Ultimo pulso do quadro ate a decisao" },
+    [MET_H_DECISION_TO_RELAY] = { "rfid_decision_to_relay_seconds", "Decisao ate a sequencia de saida entregue ao agendador" },
+    [MET_H_STORAGE_COMMIT]    = { "rfid_storage_commit_seconds", "Duracao de um commit em grupo na flash" },
+    [MET_H_NVS_COMMIT]        = { "rfid_nvs_commit_seconds", "Duracao de nvs_commit" },
+    [MET_H_ZB_TO_ACK]         = { "rfid_zigbee_report_ack_seconds", "Evento na fila Zigbee ate o ACK do APS" },
+};
+
+void metrics_render_header(web_writer_t *w, const char *name, const char *type, const char *help) {
+    size_t len = strcspn(name, "{");
+    web_writer_printf(w, "# HELP %.*s %s\n# TYPE %.*s %s\n", (int)len, name, help, (int)len, name, type);
+}
+
+static void render_family(web_writer_t *w, const metric_info_t *info, const uint32_t *values, int n,
+                          const char *type) {
+    for (int i = 0; i < n; i++) {
+        if (info[i].help) metrics_render_header(w, info[i].name, type, info[i].help);
+        web_writer_printf(w, "%s %lu\n", info[i].name,
+                          (unsigned long)__atomic_load_n(&values[i], __ATOMIC_RELAXED));
+    }
+}
+
+// µs como segundos com 6 casas, sem ponto flutuante
+static void render_seconds(web_writer_t *w, uint32_t us) {
+    web_writer_printf(w, "%lu.%06lu", (unsigned long)(us / 1000000), (unsigned long)(us % 1000000));
+}
+
+static void render_hist(web_writer_t *w, const metric_info_t *info, const metrics_hist_data_t *h) {
+    metrics_render_header(w, info->name, "histogram", info->help);
+
+    // count é a soma dos baldes lidos: bucket +Inf e _count sempre batem
+    uint32_t cum = 0;
+    for (int b = 0; b < METRICS_HIST_BUCKETS; b++) {
+        cum += __atomic_load_n(&h->bucket[b], __ATOMIC_RELAXED);
+        if (b == METRICS_HIST_BUCKETS - 1) {
+            web_writer_printf(w, "%s_bucket{le=\"+Inf\"} %lu\n", info->name, (unsigned long)cum);
+            break;
+        }
+        web_writer_printf(w, "%s_bucket{le=\"", info->name);
+        render_seconds(w, 1u << (b + METRICS_HIST_MIN_SHIFT));
+        web_writer_printf(w, "\"} %lu\n", (unsigned long)cum);
+    }
+    web_writer_printf(w, "%s_sum ", info->name);
+    render_seconds(w, __atomic_load_n(&h->sum_us, __ATOMIC_RELAXED));
+    web_writer_printf(w, "\n%s_count %lu\n", info->name, (unsigned long)cum);
+}
+
+// CPU e pilha por task. uxTaskGetSystemState suspende o escalonador enquanto
+// copia a lista: custo da coleta, não do caminho da passagem.
+static void render_tasks(web_writer_t *w) {
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    UBaseType_t n = uxTaskGetNumberOfTasks() + 2;   // folga para tasks criadas no meio
+    TaskStatus_t *tasks = malloc(n * sizeof(TaskStatus_t));
+    if (!tasks) return;
+    configRUN_TIME_COUNTER_TYPE total;
+    n = uxTaskGetSystemState(tasks, n, &total);
+
+    metrics_render_header(w, "rfid_task_cpu_seconds_total", "counter",
+                  "Tempo de CPU por task (run-time stats do FreeRTOS)");
+    for (UBaseType_t i = 0; i < n; i++) {
+        uint64_t us = tasks[i].ulRunTimeCounter;
+        web_writer_printf(w, "rfid_task_cpu_seconds_total{task=\"%s\"} %llu.%06llu\n", tasks[i].pcTaskName,
+                          (unsigned long long)(us / 1000000), (unsigned long long)(us % 1000000));
+    }
+    metrics_render_header(w, "rfid_task_stack_free_min_bytes", "gauge", "Menor folga de pilha vista por task");
+    for (UBaseType_t i = 0; i < n; i++) {
+        web_writer_printf(w, "rfid_task_stack_free_min_bytes{task=\"%s\"} %lu\n", tasks[i].pcTaskName,
+                          (unsigned long)tasks[i].usStackHighWaterMark);
+    }
+    free(tasks);
+#endif
+}
+
+void metrics_render_value(web_writer_t *w, const char *name, const char *type, const char *help,
+                          uint64_t value) {
+    metrics_render_header(w, name, type, help);
+    web_writer_printf(w, "%s %llu\n", name, (unsigned long long)value);
+}
+
+void metrics_render(web_writer_t *w) {
+    render_family(w, counter_info, metrics_counters, MET_COUNTER_COUNT, "counter");
+    render_family(w, gauge_info, metrics_gauges, MET_GAUGE_COUNT, "gauge");
+    for (int i = 0; i < MET_HIST_COUNT && !web_writer_failed(w); i++) {
+        render_hist(w, &hist_info[i], &metrics_hists[i]);
+    }
+#ifdef ESP_PLATFORM
+    metrics_render_value(w, "rfid_heap_free_bytes", "gauge", "Heap livre agora", esp_get_free_heap_size());
+    metrics_render_value(w, "rfid_heap_free_min_bytes", "gauge", "Menor heap livre desde o boot",
+                         esp_get_minimum_free_heap_size());
+#endif
+    render_tasks(w);
+}
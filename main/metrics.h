@@ -0,0 +1,109 @@
+#pragma once
+#include <stdint.h>
+#include "web_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Métricas de execução, exportadas em GET /metrics (texto do Prometheus).
+//
+// Registro fixo e sem lock: cada contador, gauge e balde de histograma é
+// uma palavra de 32 bits em RAM, atualizada com atômicos relaxados (uma
+// instrução AMO no C6). Registrar no caminho da passagem custa poucas
+// instruções e nunca bloqueia; nomes, texto e formatação ficam na coleta.
+//
+// Contadores de 32 bits dão a volta; para o Prometheus isso é um reset do
+// contador e rate() continua certo. O que os módulos já contam (Zigbee,
+// pipeline, durabilidade) é lido na coleta, não contado de novo aqui.
+
+typedef enum {
+    MET_WG_FRAMES_OK = 0,
+    MET_WG_FRAMES_BAD_PARITY,
+    MET_WG_FRAMES_BAD_LENGTH,
+    MET_STORAGE_COMMITS,
+    MET_STORAGE_COMMIT_RECORDS,
+    MET_STORAGE_COMMIT_BYTES,       // slots gravados nos journals (snapshot não entra)
+    MET_STORAGE_COMMIT_ERRORS,
+    MET_NVS_COMMITS,
+    MET_ZB_FRAMES_TX,               // reports no ar, incluindo repetições
+    MET_COUNTER_COUNT
+} metrics_counter_t;
+
+// Marcas d'água: maior ocupação vista pelo consumidor de cada fila
+typedef enum {
+    MET_QUEUE_DECIDE = 0,
+    MET_QUEUE_LOG,
+    MET_QUEUE_NOTIFY,
+    MET_QUEUE_STORAGE,
+    MET_QUEUE_ZB_CMD,
+    MET_QUEUE_ZB_EVENTS,
+    MET_GAUGE_COUNT
+} metrics_gauge_t;
+
+typedef enum {
+    MET_H_SWIPE_TO_DECISION = 0,    // último pulso do quadro -> decisão
+    MET_H_DECISION_TO_RELAY,        // decisão -> sequência entregue ao agendador de saídas
+    MET_H_STORAGE_COMMIT,
+    MET_H_NVS_COMMIT,
+    MET_H_ZB_TO_ACK,                // evento enfileirado -> ACK do APS
+    MET_HIST_COUNT
+} metrics_hist_t;
+
+// Baldes em potências de 2 µs: <= 64 µs, 128 µs, ..., 2^20 µs (~1 s), +Inf
+#define METRICS_HIST_MIN_SHIFT  6
+#define METRICS_HIST_BUCKETS    16
+
+typedef struct {
+    uint32_t bucket[METRICS_HIST_BUCKETS];  // não cumulativos; a coleta acumula
+    uint32_t sum_us;
+} metrics_hist_data_t;
+
+extern uint32_t metrics_counters[MET_COUNTER_COUNT];
+extern uint32_t metrics_gauges[MET_GAUGE_COUNT];
+extern metrics_hist_data_t metrics_hists[MET_HIST_COUNT];
+
+static inline void metrics_add(metrics_counter_t id, uint32_t n)
+{
+    __atomic_fetch_add(&metrics_counters[id], n, __ATOMIC_RELAXED);
+}
+
+static inline void metrics_inc(metrics_counter_t id)
+{
+    metrics_add(id, 1);
+}
+
+// Só escreve quando passa da marca atual: no caso comum é uma leitura
+static inline void metrics_gauge_max(metrics_gauge_t id, uint32_t v)
+{
+    uint32_t cur = __atomic_load_n(&metrics_gauges[id], __ATOMIC_RELAXED);
+    while (v > cur && !__atomic_compare_exchange_n(&metrics_gauges[id], &cur, v, true,
+                                                   __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static inline void metrics_observe_us(metrics_hist_t id, int64_t us)
+{
+    uint32_t v = us <= 0 ? 0 : (us > UINT32_MAX ? UINT32_MAX : (uint32_t)us);
+    int b = 0;
+    if (v > (1u << METRICS_HIST_MIN_SHIFT)) {
+        b = 32 - __builtin_clz(v - 1) - METRICS_HIST_MIN_SHIFT;   // ceil(log2 v) - 6
+        if (b > METRICS_HIST_BUCKETS - 1) b = METRICS_HIST_BUCKETS - 1;
+    }
+    __atomic_fetch_add(&metrics_hists[id].bucket[b], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&metrics_hists[id].sum_us, v, __ATOMIC_RELAXED);
+}
+
+// Registro + heap e CPU/pilha por task (com CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS)
+void metrics_render(web_writer_t *w);
+
+// Para quem exporta na coleta os contadores que já mantém (type: "counter"
+// ou "gauge"). O cabeçalho vale para as amostras seguintes com rótulos.
+void metrics_render_header(web_writer_t *w, const char *name, const char *type, const char *help);
+// Família com uma amostra só
+void metrics_render_value(web_writer_t *w, const char *name, const char *type,
+                          const char *help, uint64_t value);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,158 +1,343 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
 #include "nvs_storage.h"
+#include "rfid_storage.h"
+#include "metrics.h"
 
 static const char *TAG = "nvs_storage";
 
+// Layout da partição do NVS, para o orçamento de blobs
+#define NVS_PAGE_SIZE          4096
+#define NVS_ENTRY_SIZE         32
+#define NVS_ENTRIES_PER_PAGE   126
+#define NVS_CHUNK_MAX          ((NVS_ENTRIES_PER_PAGE - 1) * NVS_ENTRY_SIZE)   // dados de um bloco de blob
+// Chaves pequenas deste namespace, namespaces e o que o driver de Wi-Fi
+// grava por conta própria
+#define NVS_FIXED_ENTRIES      64
+
+#define KEY_SCHEMA      "schema"
+
+// Namespaces do layout antigo (esquema 0)
+#define LEGACY_NS_CONFIG  "storage"     // Wi-Fi e Zigbee
+#define LEGACY_NS_USERS   "users"       // "count" + uid_N/nome_N (uid[16], nome[32])
+
+static nvs_handle_t handle;
+static bool opened = false;
+static nvs_storage_stats_t stats;
+static uint32_t reserved_entries = NVS_FIXED_ENTRIES;
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+typedef enum {
+    VAL_U8,
+    VAL_U16,
+    VAL_I32,
+    VAL_STR,
+    VAL_BLOB,
+} val_type_t;
+
+typedef struct {
+    const char *ns;
+    const char *key;
+    val_type_t type;
+} legacy_key_t;
+
+// Chaves soltas que só mudam de namespace (o nome continua o mesmo)
+static const legacy_key_t legacy_keys[] = {
+    { LEGACY_NS_CONFIG, "wifi_ssid", VAL_STR },
+    { LEGACY_NS_CONFIG, "wifi_pass", VAL_STR },
+    { LEGACY_NS_CONFIG, "zb_chan",   VAL_U8 },
+    { LEGACY_NS_CONFIG, "zb_panid",  VAL_U16 },
+};
+
 // =====================
-// Inicialização
+// Migração
 // =====================
-esp_err_t nvs_storage_init(void)
-{
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
+static esp_err_t copy_key(nvs_handle_t from, const char *key, val_type_t type) {
+    esp_err_t err;
+    switch (type) {
+    case VAL_U8: {
+        uint8_t v;
+        err = nvs_get_u8(from, key, &v);
+        return err == ESP_OK ? nvs_set_u8(handle, key, v) : err;
+    }
+    case VAL_U16: {
+        uint16_t v;
+        err = nvs_get_u16(from, key, &v);
+        return err == ESP_OK ? nvs_set_u16(handle, key, v) : err;
+    }
+    case VAL_I32: {
+        int32_t v;
+        err = nvs_get_i32(from, key, &v);
+        return err == ESP_OK ? nvs_set_i32(handle, key, v) : err;
+    }
+    default: {
+        size_t size = 0;
+        err = type == VAL_STR ? nvs_get_str(from, key, NULL, &size) : nvs_get_blob(from, key, NULL, &size);
+        if (err != ESP_OK) return err;
+        void *buf = malloc(size ? size : 1);
+        if (!buf) return ESP_ERR_NO_MEM;
+        if (type == VAL_STR) {
+            err = nvs_get_str(from, key, buf, &size);
+            if (err == ESP_OK) err = nvs_set_str(handle, key, buf);
+        } else {
+            err = nvs_get_blob(from, key, buf, &size);
+            if (err == ESP_OK) err = nvs_set_blob(handle, key, buf, size);
+        }
+        free(buf);
+        return err;
+    }
     }
-    ESP_LOGI(TAG, "NVS inicializado");
-    return ret;
 }
 
-// =====================
-// WiFi Config
-// =====================
-esp_err_t nvs_save_wifi(const wifi_config_t *cfg)
-{
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open("storage", NVS_READWRITE, &handle);
-    if (err != ESP_OK) return err;
-
-    nvs_set_str(handle, "wifi_ssid", cfg->ssid);
-    nvs_set_str(handle, "wifi_pass", cfg->pass);
-
-    err = nvs_commit(handle);
-    nvs_close(handle);
-    return err;
+static void erase_namespace(const char *ns) {
+    nvs_handle_t h;
+    if (nvs_open(ns, NVS_READWRITE, &h) != ESP_OK) return;
+    nvs_erase_all(h);
+    nvs_commit(h);
+    nvs_close(h);
 }
 
-esp_err_t nvs_load_wifi(wifi_config_t *cfg)
-{
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open("storage", NVS_READONLY, &handle);
-    if (err != ESP_OK) return err;
+static esp_err_t migrate_legacy_keys(void) {
+    for (size_t i = 0; i < sizeof(legacy_keys) / sizeof(legacy_keys[0]); i++) {
+        const legacy_key_t *k = &legacy_keys[i];
+        nvs_handle_t from;
+        if (nvs_open(k->ns, NVS_READONLY, &from) != ESP_OK) continue;   // namespace não existe
+        esp_err_t err = copy_key(from, k->key, k->type);
+        nvs_close(from);
+        if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
+            ESP_LOGE(TAG, "Falha ao migrar %s/%s: %s", k->ns, k->key, esp_err_to_name(err));
+            return err;
+        }
+    }
+    return ESP_OK;
+}
 
-    size_t len = sizeof(cfg->ssid);
-    err = nvs_get_str(handle, "wifi_ssid", cfg->ssid, &len);
-    if (err != ESP_OK) { nvs_close(handle); return err; }
+// Usuários do nvs_storage antigo (uid[16]/nome[32] em chaves separadas) viram
+// o blob legado "users" do rfid_storage, que load_users converte em snapshot.
+// Se já houver tabela no namespace novo, o namespace antigo fica intacto.
+static esp_err_t migrate_legacy_users(bool *keep_ns) {
+    *keep_ns = false;
+    nvs_handle_t from;
+    if (nvs_open(LEGACY_NS_USERS, NVS_READONLY, &from) != ESP_OK) return ESP_OK;
 
-    len = sizeof(cfg->pass);
-    err = nvs_get_str(handle, "wifi_pass", cfg->pass, &len);
-
-    nvs_close(handle);
-    return err;
-}
+    uint32_t count = 0;
+    nvs_get_u32(from, "count", &count);
+    if (count == 0) {
+        nvs_close(from);
+        return ESP_OK;
+    }
 
-// =====================
-// Zigbee Config
-// =====================
-esp_err_t nvs_save_zigbee(const zigbee_config_t *cfg)
-{
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open("storage", NVS_READWRITE, &handle);
-    if (err != ESP_OK) return err;
+    size_t size = 0;
+    if (nvs_get_blob(handle, "user_snap", NULL, &size) == ESP_OK ||
+        nvs_get_blob(handle, "users", NULL, &size) == ESP_OK) {
+        ESP_LOGW(TAG, "Namespace \"%s\" com %lu usuarios ignorado: tabela atual ja existe",
+                 LEGACY_NS_USERS, (unsigned long)count);
+        nvs_close(from);
+        *keep_ns = true;
+        return ESP_OK;
+    }
 
-    nvs_set_u8(handle, "zb_chan", cfg->channel);
-    nvs_set_u16(handle, "zb_panid", cfg->pan_id);
+    if (count > MAX_USERS) count = MAX_USERS;
+    rfid_user_t *users = calloc(count, sizeof(rfid_user_t));
+    if (!users) {
+        nvs_close(from);
+        return ESP_ERR_NO_MEM;
+    }
+    int32_t n = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        char key[16];
+        size_t len = sizeof(users[n].uid);
+        snprintf(key, sizeof(key), "uid_%lu", (unsigned long)i);
+        if (nvs_get_str(from, key, users[n].uid, &len) != ESP_OK || users[n].uid[0] == '\0') continue;
+        len = sizeof(users[n].name);
+        snprintf(key, sizeof(key), "nome_%lu", (unsigned long)i);
+        nvs_get_str(from, key, users[n].name, &len);
+        n++;
+    }
+    nvs_close(from);
 
-    err = nvs_commit(handle);
-    nvs_close(handle);
+    esp_err_t err = nvs_set_blob(handle, "users", users, (size_t)n * sizeof(rfid_user_t));
+    if (err == ESP_OK) err = nvs_set_i32(handle, "user_count", n);
+    free(users);
+    if (err == ESP_OK) ESP_LOGI(TAG, "%ld usuarios do namespace \"%s\" migrados", (long)n, LEGACY_NS_USERS);
     return err;
 }
 
-esp_err_t nvs_load_zigbee(zigbee_config_t *cfg)
-{
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open("storage", NVS_READONLY, &handle);
+static esp_err_t migrate_schema(uint16_t from) {
+    if (from == NVS_SCHEMA_VERSION) return ESP_OK;
+    if (from > NVS_SCHEMA_VERSION) {
+        // Firmware mais antigo que os dados: não mexe em nada
+        ESP_LOGW(TAG, "Esquema %u mais novo que o firmware (%u)", from, NVS_SCHEMA_VERSION);
+        return ESP_OK;
+    }
+
+    bool keep_users_ns = false;
+    esp_err_t err = migrate_legacy_keys();
+    if (err == ESP_OK) err = migrate_legacy_users(&keep_users_ns);
+    // A versão nova só vale junto com os dados copiados: um commit só
+    if (err == ESP_OK) err = nvs_set_u16(handle, KEY_SCHEMA, NVS_SCHEMA_VERSION);
+    if (err == ESP_OK) err = nvs_commit(handle);
     if (err != ESP_OK) return err;
 
-    err = nvs_get_u8(handle, "zb_chan", &cfg->channel);
-    if (err != ESP_OK) { nvs_close(handle); return err; }
+    // Origem só é apagada depois do commit; uma queda no meio repete a cópia
+    erase_namespace(LEGACY_NS_CONFIG);
+    if (!keep_users_ns) erase_namespace(LEGACY_NS_USERS);
+    ESP_LOGI(TAG, "Esquema NVS %u -> %u", from, NVS_SCHEMA_VERSION);
+    return ESP_OK;
+}
 
-    err = nvs_get_u16(handle, "zb_panid", &cfg->pan_id);
+// Custo de uma leitura como era feita antes (abrir/ler/fechar) e com o cache
+static void measure_handle_cost(void) {
+    uint16_t v;
+    int64_t t0 = esp_timer_get_time();
+    nvs_handle_t h;
+    if (nvs_open(NVS_STORAGE_NAMESPACE, NVS_READONLY, &h) == ESP_OK) {
+        nvs_get_u16(h, KEY_SCHEMA, &v);
+        nvs_close(h);
+    }
+    int64_t t1 = esp_timer_get_time();
+    nvs_get_u16(handle, KEY_SCHEMA, &v);
+    int64_t t2 = esp_timer_get_time();
 
-    nvs_close(handle);
-    return err;
+    stats.open_get_close_us = (uint32_t)(t1 - t0);
+    stats.cached_get_us = (uint32_t)(t2 - t1);
+    ESP_LOGI(TAG, "Leitura NVS: %lu us com open/close, %lu us com handle em cache",
+             (unsigned long)stats.open_get_close_us, (unsigned long)stats.cached_get_us);
 }
 
 // =====================
-// RFID Users
+// Inicialização
 // =====================
-esp_err_t nvs_add_user(const rfid_user_t *user)
+esp_err_t nvs_storage_init(void)
 {
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open("users", NVS_READWRITE, &handle);
-    if (err != ESP_OK) return err;
+    if (opened) return ESP_OK;
 
-    // Recupera contador atual
-    uint32_t count = 0;
-    nvs_get_u32(handle, "count", &count);
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    if (ret != ESP_OK) return ret;
 
-    if (count >= MAX_USERS) {
-        nvs_close(handle);
-        return ESP_ERR_NO_MEM;
+    ret = nvs_open(NVS_STORAGE_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) return ret;
+    opened = true;
+
+    uint16_t schema = 0;
+    nvs_get_u16(handle, KEY_SCHEMA, &schema);
+    stats.migrated_from = schema;
+    ret = migrate_schema(schema);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Migracao do esquema %u falhou: %s", schema, esp_err_to_name(ret));
+        return ret;
     }
+    stats.schema = schema > NVS_SCHEMA_VERSION ? schema : NVS_SCHEMA_VERSION;
 
-    char key_uid[16], key_nome[16];
-    sprintf(key_uid, "uid_%lu", count);
-    sprintf(key_nome, "nome_%lu", count);
+    measure_handle_cost();
+    ESP_LOGI(TAG, "NVS inicializado, esquema %u", stats.schema);
+    return ESP_OK;
+}
 
-    nvs_set_str(handle, key_uid, user->uid);
-    nvs_set_str(handle, key_nome, user->nome);
+// Índice + cabeçalho de cada bloco + dados; um bloco a mais porque o
+// blob pode ser partido na borda de uma página
+static uint32_t blob_entries(size_t size)
+{
+    uint32_t chunks = (uint32_t)((size + NVS_CHUNK_MAX - 1) / NVS_CHUNK_MAX) + 1;
+    return 1 + chunks + (uint32_t)((size + NVS_ENTRY_SIZE - 1) / NVS_ENTRY_SIZE);
+}
 
-    nvs_set_u32(handle, "count", count + 1);
+esp_err_t nvs_storage_reserve_blob(const char *key, size_t max_size)
+{
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                           ESP_PARTITION_SUBTYPE_DATA_NVS, NULL);
+    if (!part) return ESP_ERR_NOT_FOUND;
 
-    err = nvs_commit(handle);
-    nvs_close(handle);
-    return err;
+    // Uma página fica sempre livre para a reciclagem
+    uint32_t pages = part->size / NVS_PAGE_SIZE;
+    uint32_t capacity = pages > 1 ? (pages - 1) * NVS_ENTRIES_PER_PAGE : 0;
+    uint32_t need = 2 * blob_entries(max_size);
+    if (reserved_entries + need > capacity) {
+        ESP_LOGE(TAG, "NVS pequeno demais: \"%s\" (ate %u bytes) precisa de %lu entradas, "
+                      "ja reservadas %lu de %lu. Reduza a capacidade no menuconfig ou aumente a particao nvs",
+                 key, (unsigned)max_size, (unsigned long)need, (unsigned long)reserved_entries,
+                 (unsigned long)capacity);
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    reserved_entries += need;
+    return ESP_OK;
 }
 
-esp_err_t nvs_list_users(rfid_user_t *users, size_t *count)
+nvs_handle_t nvs_storage_handle(void)
 {
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open("users", NVS_READONLY, &handle);
-    if (err != ESP_OK) return err;
+    return handle;
+}
 
-    uint32_t saved_count = 0;
-    nvs_get_u32(handle, "count", &saved_count);
-    if (saved_count > *count) saved_count = *count;
+esp_err_t nvs_storage_commit(void)
+{
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = nvs_commit(handle);
+    uint32_t dt = (uint32_t)(esp_timer_get_time() - t0);
 
-    for (uint32_t i = 0; i < saved_count; i++) {
-        char key_uid[16], key_nome[16];
-        sprintf(key_uid, "uid_%u", i);
-        sprintf(key_nome, "nome_%u", i);
+    portENTER_CRITICAL(&stats_mux);
+    stats.commit.count++;
+    stats.commit.last_us = dt;
+    stats.commit.total_us += dt;
+    if (dt > stats.commit.max_us) stats.commit.max_us = dt;
+    portEXIT_CRITICAL(&stats_mux);
+    metrics_inc(MET_NVS_COMMITS);
+    metrics_observe_us(MET_H_NVS_COMMIT, dt);
+    return err;
+}
 
-        size_t len_uid = MAX_UID_LEN;
-        size_t len_nome = MAX_NAME_LEN;
-        nvs_get_str(handle, key_uid, users[i].uid, &len_uid);
-        nvs_get_str(handle, key_nome, users[i].nome, &len_nome);
-    }
+void nvs_storage_get_stats(nvs_storage_stats_t *out)
+{
+    portENTER_CRITICAL(&stats_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_mux);
+}
 
-    *count = saved_count;
-    nvs_close(handle);
-    return ESP_OK;
+// =====================
+// WiFi Config
+// =====================
+esp_err_t nvs_save_wifi(const storage_wifi_config_t *cfg)
+{
+    esp_err_t err = nvs_set_str(handle, "wifi_ssid", cfg->ssid);
+    if (err == ESP_OK) err = nvs_set_str(handle, "wifi_pass", cfg->pass);
+    if (err == ESP_OK) err = nvs_storage_commit();
+    return err;
 }
 
-esp_err_t nvs_clear_users(void)
+esp_err_t nvs_load_wifi(storage_wifi_config_t *cfg)
 {
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open("users", NVS_READWRITE, &handle);
+    size_t len = sizeof(cfg->ssid);
+    esp_err_t err = nvs_get_str(handle, "wifi_ssid", cfg->ssid, &len);
     if (err != ESP_OK) return err;
 
-    err = nvs_erase_all(handle);
-    if (err == ESP_OK) {
-        err = nvs_commit(handle);
-    }
-    nvs_close(handle);
+    len = sizeof(cfg->pass);
+    return nvs_get_str(handle, "wifi_pass", cfg->pass, &len);
+}
+
+// =====================
+// Zigbee Config
+// =====================
+esp_err_t nvs_save_zigbee(const zigbee_config_t *cfg)
+{
+    esp_err_t err = nvs_set_u8(handle, "zb_chan", cfg->channel);
+    if (err == ESP_OK) err = nvs_set_u16(handle, "zb_panid", cfg->pan_id);
+    if (err == ESP_OK) err = nvs_storage_commit();
     return err;
 }
+
+esp_err_t nvs_load_zigbee(zigbee_config_t *cfg)
+{
+    esp_err_t err = nvs_get_u8(handle, "zb_chan", &cfg->channel);
+    if (err != ESP_OK) return err;
+    return nvs_get_u16(handle, "zb_panid", &cfg->pan_id);
+}
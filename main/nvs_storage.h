@@ -1,16 +1,34 @@
 #pragma once
 #include "esp_err.h"
+#include "nvs.h"
 #include <stdint.h>
 
-#define MAX_UID_LEN    16
-#define MAX_NAME_LEN   32
-#define MAX_USERS      50
+// Camada única de NVS. Todo o firmware usa um namespace e um handle,
+// aberto no boot e mantido aberto (nvs_open custa uma busca pela página
+// do namespace a cada chamada). As funções do NVS já são thread-safe.
+//
+// Esquema 1, namespace NVS_STORAGE_NAMESPACE:
+//   schema              u16   versão do esquema gravado
+//   user_snap           blob  tabela de usuários (rfid_storage.c)
+//   users, user_count   blob  legado, migrado para user_snap no boot
+//   logs, log_count     blob  legado, migrado para o journal de logs
+//   wifi_ssid/pass      str
+//   zb_chan, zb_panid   u8/u16
+//   boot, drift         u16/i32  (time_service.c)
+//   offsets             blob     (time_service.c)
+//   policy              blob     política de acesso (access_policy.c)
+// Sem "schema" o layout é o antigo: nvs_storage_init traz para cá os
+// namespaces "storage" (Wi-Fi/Zigbee) e "users" (usuários em chaves
+// uid_N/nome_N) e os apaga.
+
+#define NVS_STORAGE_NAMESPACE  "rfid_storage"
+#define NVS_SCHEMA_VERSION     1
 
 // Estrutura de configuração de rede
 typedef struct {
     char ssid[32];
     char pass[64];
-} wifi_config_t;
+} storage_wifi_config_t;
 
 // Estrutura de configuração Zigbee
 typedef struct {
@@ -18,24 +36,43 @@ typedef struct {
     uint16_t pan_id;
 } zigbee_config_t;
 
-// Estrutura de usuário RFID
 typedef struct {
-    char uid[MAX_UID_LEN];
-    char nome[MAX_NAME_LEN];
-} rfid_user_t;
+    uint32_t count;
+    uint32_t last_us;
+    uint32_t max_us;
+    uint64_t total_us;
+} nvs_storage_op_stats_t;
+
+typedef struct {
+    uint16_t schema;                // versão em uso
+    uint16_t migrated_from;         // versão encontrada no boot
+    uint32_t open_get_close_us;     // uma leitura com nvs_open/nvs_close (como antes)
+    uint32_t cached_get_us;         // a mesma leitura com o handle em cache
+    nvs_storage_op_stats_t commit;
+} nvs_storage_stats_t;
 
-// API
+// nvs_flash_init, handle e migração do esquema
 esp_err_t nvs_storage_init(void);
 
+// Handle de leitura/escrita do namespace único; válido após nvs_storage_init
+nvs_handle_t nvs_storage_handle(void);
+// nvs_commit com medição de latência
+esp_err_t nvs_storage_commit(void);
+
+void nvs_storage_get_stats(nvs_storage_stats_t *out);
+
+// Orçamento do NVS: o blob "key" pode chegar a max_size bytes. Conta duas
+// cópias (o NVS grava a nova antes de apagar a antiga) e soma às reservas
+// anteriores; ESP_ERR_NVS_NOT_ENOUGH_SPACE (e log) se não couber na
+// partição. Chamado no init de quem grava blobs que crescem com uma
+// capacidade do Kconfig (a política, CONFIG_RFID_POLICY_MAX_MEMBERS), para a
+// falta de espaço aparecer no boot e não no primeiro commit.
+esp_err_t nvs_storage_reserve_blob(const char *key, size_t max_size);
+
 // WiFi
-esp_err_t nvs_save_wifi(const wifi_config_t *cfg);
-esp_err_t nvs_load_wifi(wifi_config_t *cfg);
+esp_err_t nvs_save_wifi(const storage_wifi_config_t *cfg);
+esp_err_t nvs_load_wifi(storage_wifi_config_t *cfg);
 
 // Zigbee
 esp_err_t nvs_save_zigbee(const zigbee_config_t *cfg);
 esp_err_t nvs_load_zigbee(zigbee_config_t *cfg);
-
-// RFID Users
-esp_err_t nvs_add_user(const rfid_user_t *user);
-esp_err_t nvs_list_users(rfid_user_t *users, size_t *count);
-esp_err_t nvs_clear_users(void);
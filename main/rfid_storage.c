@@ -1,172 +1,1086 @@
 #include "rfid_storage.h"
-#include "nvs_flash.h"
-#include "nvs.h"
+#include "uid_index.h"
+#include "flash_journal.h"
+#include "wiegand_format.h"
+#include "time_service.h"
+#include "nvs_storage.h"
+#include "metrics.h"
+#include "mem_budget.h"
+#include "fast_boot.h"
 #include "esp_log.h"
 #include "esp_err.h"
+#include "esp_partition.h"
+#include "esp_random.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 
-#define STORAGE_NAMESPACE "rfid_storage"
-#define KEY_USERS   "users"
-#define KEY_LOGS    "logs"
+#define KEY_USERS   "users"         // legado: user_db inteiro + "user_count"
+#define KEY_USER_SNAP "user_snap"   // legado: snapshot v1 no NVS (cabeçalho + usuários)
+#define USER_WAL_PARTITION "userwal"
+#define USER_SNAP_PARTITION "usersnap"
+#define KEY_LOGS    "logs"          // legado: blob com os 50 últimos logs
+#define LOG_PARTITION "acclog"
+#define LEGACY_LOG_MIGRATE_MAX 256  // registros em texto trazidos do journal antigo
 
-// Banco em RAM
-static rfid_user_t user_db[MAX_USERS];
+static const char *TAG = "rfid_storage";
+
+// Registros de WAL acumulados antes de compactar num novo snapshot.
+// Deve ser bem menor que a capacidade do journal "userwal" (~570 registros),
+// senão o journal recicla setores com mudanças ainda não compactadas.
+#define USER_WAL_COMPACT_THRESHOLD 128
+
+#define USER_SNAP_MAGIC   0x50534E55u  // "UNSP"
+#define USER_SNAP_VERSION 2             // 1: blob no NVS, sem hdr_crc
+#define USER_SNAP_SECTOR  4096
+#define USER_SNAP_DATA_OFFSET 32        // usuários depois do cabeçalho, no mesmo slot
+
+// Slots do índice: potência de 2, fator de carga <= 0.5
+#define USER_INDEX_SLOTS UID_INDEX_SLOTS_FOR(MAX_USERS)
+_Static_assert(USER_INDEX_SLOTS >= 2 * MAX_USERS, "USER_INDEX_SLOTS pequeno demais para MAX_USERS");
+
+// Banco em RAM (arena alocada em rfid_storage_init, mem_budget.h)
+static rfid_user_t *user_db = NULL;
 static int user_count = 0;
 
-static rfid_log_t log_db[MAX_LOGS];
-static int log_count = 0;
+// Índice UID -> posição em user_db
+static uid_index_slot_t *user_index_slots = NULL;
+static uid_index_t user_index;
+
+// Protege user_db/índice: a decisão de acesso roda em outra task que o HTTP
+static SemaphoreHandle_t user_lock = NULL;
+
+// Persistência de usuários: snapshot na partição "usersnap" + journal de
+// deltas (WAL). Um registro do WAL só vale para o snapshot da mesma época,
+// sorteada a cada snapshot: com a partição apagada ou trocada, registros
+// antigos que sobraram no WAL não batem com nada e não são reaplicados.
+// O snapshot tem dois slots: grava o inativo (usuários antes do cabeçalho) e
+// o cabeçalho por último; reset no meio deixa o anterior valendo.
+typedef enum {
+    USER_OP_ADD = 1,
+    USER_OP_REMOVE = 2,
+} user_op_t;
+
+typedef struct {
+    uint32_t epoch;             // época do snapshot (no snapshot v1 do NVS, a geração)
+    uint8_t  op;
+    uint8_t  reserved[3];
+    rfid_user_t user;           // em USER_OP_REMOVE só o uid é usado
+} user_wal_rec_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t gen;               // maior geração válida vence
+    uint32_t count;
+    uint32_t crc;               // CRC32 dos usuários que seguem o cabeçalho
+    uint32_t epoch;             // aleatória; os registros do WAL carregam a mesma
+    uint32_t hdr_crc;           // CRC32 dos campos acima (a v1 termina antes)
+} user_snap_hdr_t;
+
+#define USER_SNAP_V1_HDR_SIZE offsetof(user_snap_hdr_t, epoch)
+_Static_assert(sizeof(user_snap_hdr_t) <= USER_SNAP_DATA_OFFSET, "cabecalho maior que o espaco reservado");
+
+static flash_journal_t user_wal;
+static const esp_partition_t *snap_part = NULL;
+static uint32_t snap_slot_size = 0;
+static int snap_slot = -1;              // slot da geração atual (-1 = nenhum)
+static uint32_t user_gen = 0;
+static uint32_t user_epoch = 0;         // época do snapshot carregado/gravado
+static uint32_t user_wal_pending = 0; // registros do WAL desde o último snapshot
+static volatile uint32_t user_version = 0; // para caches de negação (deny_cache.c)
+
+// Log de acessos: journal append-only na partição "acclog".
+// Registro de 15 bytes + CRC8 do journal = 16 bytes por slot (antes 69).
+// O tempo é um delta de 24 bits contra o tempo base do setor (tag 0 do
+// journal); um registro que não cabe no delta abre um setor novo.
+// Antes da hora ser conhecida o tempo é "segundos desde o boot", gravado
+// direto no delta (a base não entra), e o boot vai no próprio registro como
+// diferença para o boot do setor (tag 1); a leitura converte com o offset
+// do boot. Assim o boot novo e a primeira hora sincronizada não abrem setor.
+typedef struct __attribute__((packed)) {
+    uint64_t cred;
+    uint8_t  dt[3];             // segundos desde LOG_TAG_BASE_TIME do setor; LOG_SLOT_UPTIME: desde o boot
+    uint8_t  flags;             // bits 0-1: decisão, bit 2: LOG_SLOT_UPTIME, bits 3-5: leitor,
+                                // bits 6-7: boot - LOG_TAG_BOOT (só LOG_SLOT_UPTIME)
+    uint8_t  span_s;
+    uint16_t count;
+} log_slot_t;
+
+_Static_assert(sizeof(log_slot_t) + 1 <= 16, "registro de log deve caber em 16 bytes com o CRC");
+
+#define LOG_TAG_BASE_TIME  0
+#define LOG_TAG_BOOT       1
+#define LOG_SLOT_UPTIME    0x04
+#define LOG_SLOT_READER    0x07         // << 3; porta da política (POLICY_MAX_DOORS <= 8)
+#define LOG_SLOT_BOOT_MAX  3            // << 6; boots sem hora por setor além do da tag
+#define LOG_DT_MAX         0xFFFFFFu    // ~194 dias por setor
+// Base abaixo disso não é hora (a do Zigbee começa em 2000). Setores antigos
+// abertos por registro sem hora têm o uptime como base e o delta contra ele.
+#define LOG_BASE_IS_UNIX(b) ((b) >= TIME_ZCL_EPOCH_OFFSET)
+
+// Formatos antigos, só para migração
+typedef struct {
+    char uid[MAX_UID_LEN];
+    char timestamp[MAX_TIMESTAMP_LEN];
+} legacy_nvs_log_t;                     // blob "logs" do NVS
+
+typedef struct {
+    char uid[MAX_UID_LEN];
+    char timestamp[MAX_TIMESTAMP_LEN];
+    uint8_t granted;
+    uint8_t reserved;
+    uint16_t count;
+} legacy_text_log_t;                    // journal "acclog" em texto
+
+static flash_journal_t log_journal;
+
+// Task de gravação: única que escreve na flash. Quem altera algo só
+// enfileira e recebe um ticket; a task junta o que chegar dentro da janela
+// (ou até commit_max_records) e grava tudo de uma vez.
+#define STORAGE_QUEUE_LEN       48
+#define STORAGE_BATCH_MAX       32      // limite de commit_max_records
+#define STORAGE_TASK_PRIO       5       // abaixo da decisão (13) e das saídas (14)
+#define STORAGE_LOG_WAIT_MS     1000    // log: espera limitada com a fila cheia
+#define STORAGE_WAIT_SLICE_MS   20
+#define COMMIT_DONE_BIT         (1 << 0)
+
+_Static_assert(RFID_COMMIT_MAX_RECORDS <= STORAGE_BATCH_MAX, "RFID_COMMIT_MAX_RECORDS acima de STORAGE_BATCH_MAX");
+
+typedef enum {
+    STORAGE_OP_LOG = 1,
+    STORAGE_OP_USER,
+    STORAGE_OP_FLUSH,
+    STORAGE_OP_SNAPSHOT,        // importação em lote: tabela inteira num snapshot
+} storage_op_type_t;
+
+typedef struct {
+    uint8_t type;               // storage_op_type_t
+    rfid_ticket_t ticket;
+    union {
+        rfid_log_t log;
+        user_wal_rec_t user;    // gen é preenchida pela task na gravação
+    };
+} storage_op_t;
+
+static QueueHandle_t storage_queue = NULL;
+static EventGroupHandle_t commit_events = NULL;
+// Ordena tickets e fila; também serializa as alterações de usuários para
+// que a ordem do WAL seja a mesma da tabela em RAM
+static SemaphoreHandle_t order_lock = NULL;
+
+static volatile uint32_t commit_window_ms = RFID_COMMIT_WINDOW_MS;
+static volatile uint32_t commit_max_records = RFID_COMMIT_MAX_RECORDS;
+static rfid_ticket_t next_ticket = 1;
+static volatile rfid_ticket_t durable_ticket = 0;
+static rfid_ticket_t failed_first = 0, failed_last = 0;   // último lote com erro
+static rfid_durability_t dstats;
+
+// Lote em montagem (só a task de gravação mexe)
+static rfid_log_t *log_batch = NULL;         // STORAGE_BATCH_MAX, na arena
+static user_wal_rec_t *user_batch = NULL;
+static int n_log_batch = 0, n_user_batch = 0;
+static bool snapshot_pending = false;
 
 // ====================== Funções internas ======================
 
-static esp_err_t save_users_to_nvs() {
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &handle);
-    if (err != ESP_OK) return err;
+static void rebuild_user_index(void) {
+    uid_index_init(&user_index, user_index_slots, USER_INDEX_SLOTS, user_db, sizeof(rfid_user_t));
+    for (int i = 0; i < user_count; i++) {
+        user_db[i].uid[MAX_UID_LEN - 1] = '\0';
+        uid_index_insert(&user_index, user_db[i].uid, (uint16_t)i);
+    }
+}
 
-    err = nvs_set_blob(handle, KEY_USERS, user_db, sizeof(user_db));
-    if (err == ESP_OK) {
-        err = nvs_set_i32(handle, "user_count", user_count);
+// Alterações só em RAM (tabela + índice); usadas pela API e pelo replay
+static esp_err_t user_db_add(const char *uid, const char *name) {
+    if (strlen(uid) >= MAX_UID_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (uid_index_find(&user_index, uid) >= 0) {
+        return ESP_ERR_INVALID_STATE; // já cadastrado
     }
+    if (user_count >= MAX_USERS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(&user_db[user_count], 0, sizeof(user_db[user_count]));
+    strncpy(user_db[user_count].uid, uid, sizeof(user_db[user_count].uid) - 1);
+    strncpy(user_db[user_count].name, name, sizeof(user_db[user_count].name) - 1);
+    uid_index_insert(&user_index, user_db[user_count].uid, (uint16_t)user_count);
+    user_count++;
+    return ESP_OK;
+}
 
-    nvs_commit(handle);
-    nvs_close(handle);
+static esp_err_t user_db_remove(const char *uid) {
+    int i = uid_index_remove(&user_index, uid);
+    if (i < 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Preenche o buraco com o último registro e corrige a posição no índice
+    int last = user_count - 1;
+    if (i != last) {
+        user_db[i] = user_db[last];
+        uid_index_move(&user_index, user_db[i].uid, (uint16_t)last, (uint16_t)i);
+    }
+    user_count--;
+    return ESP_OK;
+}
+
+static uint32_t snap_hdr_crc(const user_snap_hdr_t *hdr) {
+    return esp_rom_crc32_le(0, (const uint8_t *)hdr, offsetof(user_snap_hdr_t, hdr_crc));
+}
+
+static uint32_t snap_capacity(void) {
+    return (snap_slot_size - USER_SNAP_DATA_OFFSET) / sizeof(rfid_user_t);
+}
+
+// Partição do snapshot com espaço para MAX_USERS em cada slot
+static esp_err_t open_user_snapshot(void) {
+    snap_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, USER_SNAP_PARTITION);
+    if (!snap_part) {
+        ESP_LOGE(TAG, "Particao %s ausente: atualize a tabela de particoes", USER_SNAP_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+    snap_slot_size = (snap_part->size / 2) & ~(uint32_t)(USER_SNAP_SECTOR - 1);
+    if (snap_slot_size < USER_SNAP_SECTOR || snap_capacity() < MAX_USERS) {
+        ESP_LOGE(TAG, "Particao %s comporta %lu usuarios por slot, MAX_USERS = %d", USER_SNAP_PARTITION,
+                 snap_slot_size < USER_SNAP_SECTOR ? 0ul : (unsigned long)snap_capacity(), MAX_USERS);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+// Grava a tabela inteira como snapshot da geração "gen"/época "epoch" no
+// slot inativo. Apaga só os setores usados; o cabeçalho vai por último.
+static esp_err_t save_user_snapshot(uint32_t gen, uint32_t epoch) {
+    size_t users_size = (size_t)user_count * sizeof(rfid_user_t);
+    uint8_t *users = malloc(users_size ? users_size : 1);
+    if (!users) return ESP_ERR_NO_MEM;
+
+    // A tabela pode mudar pela API enquanto a task de gravação compacta
+    if (user_lock) xSemaphoreTake(user_lock, portMAX_DELAY);
+    if ((size_t)user_count * sizeof(rfid_user_t) != users_size) {
+        // Cresceu entre o malloc e o lock: tenta de novo na próxima compactação
+        if (user_lock) xSemaphoreGive(user_lock);
+        free(users);
+        return ESP_ERR_INVALID_STATE;
+    }
+    user_snap_hdr_t hdr = {
+        .magic = USER_SNAP_MAGIC,
+        .version = USER_SNAP_VERSION,
+        .record_size = sizeof(rfid_user_t),
+        .gen = gen,
+        .count = (uint32_t)user_count,
+        .crc = esp_rom_crc32_le(0, (const uint8_t *)user_db, users_size),
+        .epoch = epoch,
+    };
+    memcpy(users, user_db, users_size);
+    if (user_lock) xSemaphoreGive(user_lock);
+    hdr.hdr_crc = snap_hdr_crc(&hdr);
+
+    int slot = snap_slot >= 0 ? !snap_slot : 0;
+    size_t off = (size_t)slot * snap_slot_size;
+    size_t used = (USER_SNAP_DATA_OFFSET + users_size + USER_SNAP_SECTOR - 1) & ~(size_t)(USER_SNAP_SECTOR - 1);
+    esp_err_t err = esp_partition_erase_range(snap_part, off, used);
+    if (err == ESP_OK && users_size) {
+        err = esp_partition_write(snap_part, off + USER_SNAP_DATA_OFFSET, users, users_size);
+    }
+    if (err == ESP_OK) err = esp_partition_write(snap_part, off, &hdr, sizeof(hdr));
+    if (err == ESP_OK) snap_slot = slot;
+    free(users);
     return err;
 }
 
-static esp_err_t load_users_from_nvs() {
-    nvs_handle_t handle;
-    size_t required_size = sizeof(user_db);
-    esp_err_t err = nvs_open(STORAGE_NAMESPACE, NVS_READONLY, &handle);
-    if (err != ESP_OK) return err;
+// Compacta: novo snapshot com geração+1 e época nova. Registros antigos do
+// WAL passam a ser ignorados e são reciclados pelo journal naturalmente.
+static esp_err_t compact_users(void) {
+    uint32_t epoch;
+    do {
+        epoch = esp_random();
+    } while (epoch == user_epoch);
+    esp_err_t err = save_user_snapshot(user_gen + 1, epoch);
+    if (err == ESP_OK) {
+        user_gen++;
+        user_epoch = epoch;
+        user_wal_pending = 0;
+        ESP_LOGI(TAG, "Usuarios compactados: %d registros, geracao %lu", user_count, (unsigned long)user_gen);
+    }
+    return err;
+}
 
-    err = nvs_get_blob(handle, KEY_USERS, user_db, &required_size);
-    if (err == ESP_ERR_NVS_NOT_FOUND) {
-        nvs_close(handle);
-        return ESP_OK; // vazio
+// Persiste as alterações do lote: registros no WAL em vez de regravar a tabela.
+// O snapshot pode já conter alterações ainda na fila; reaplicá-las depois é
+// inofensivo (add de quem existe e remove de quem não existe são ignorados).
+static esp_err_t write_user_batch(void) {
+    for (int i = 0; i < n_user_batch; i++) {
+        user_batch[i].epoch = user_epoch;
     }
 
-    int32_t count = 0;
-    if (nvs_get_i32(handle, "user_count", &count) == ESP_OK) {
-        user_count = count;
+    esp_err_t err = flash_journal_append_batch(&user_wal, user_batch, n_user_batch, NULL);
+    if (err != ESP_OK) {
+        // Sem WAL: garante a durabilidade com um snapshot completo
+        return compact_users();
+    }
+    user_wal_pending += n_user_batch;
+    if (user_wal_pending >= USER_WAL_COMPACT_THRESHOLD) {
+        compact_users();
     }
+    return ESP_OK;
+}
+
+static void encode_log(const rfid_log_t *log, const uint32_t tag[FLASH_JOURNAL_TAGS], log_slot_t *slot) {
+    uint32_t dt = log->time_valid ? log->time - tag[LOG_TAG_BASE_TIME] : log->time;
+    uint8_t boot = log->time_valid ? 0 : (uint8_t)(log->boot - (uint16_t)tag[LOG_TAG_BOOT]);
+    if (dt > LOG_DT_MAX) dt = LOG_DT_MAX;       // só uptime: mais de 194 dias sem hora
+    slot->cred = log->cred;
+    slot->dt[0] = (uint8_t)dt;
+    slot->dt[1] = (uint8_t)(dt >> 8);
+    slot->dt[2] = (uint8_t)(dt >> 16);
+    slot->flags = (uint8_t)((log->decision & 0x03) | (log->time_valid ? 0 : LOG_SLOT_UPTIME) |
+                            ((log->reader & LOG_SLOT_READER) << 3) | (boot << 6));
+    slot->span_s = log->span_s;
+    slot->count = log->count;
+}
+
+static void decode_log(const log_slot_t *slot, const uint32_t tag[FLASH_JOURNAL_TAGS], rfid_log_t *log) {
+    uint32_t dt = (uint32_t)slot->dt[0] | ((uint32_t)slot->dt[1] << 8) | ((uint32_t)slot->dt[2] << 16);
+    log->cred = slot->cred;
+    log->decision = slot->flags & 0x03;
+    log->reader = (slot->flags >> 3) & LOG_SLOT_READER;
+    log->time_valid = !(slot->flags & LOG_SLOT_UPTIME);
+    uint32_t base = tag[LOG_TAG_BASE_TIME];
+    log->time = (log->time_valid || !LOG_BASE_IS_UNIX(base)) ? base + dt : dt;
+    log->boot = log->time_valid ? 0 : (uint16_t)(tag[LOG_TAG_BOOT] + (slot->flags >> 6));
+    log->span_s = slot->span_s;
+    log->count = slot->count;
+}
+
+// O registro cabe no setor com estas tags?
+static bool log_fits(const rfid_log_t *log, const uint32_t tag[FLASH_JOURNAL_TAGS]) {
+    uint32_t base = tag[LOG_TAG_BASE_TIME];
+    if (!log->time_valid) {
+        return (base == 0 || LOG_BASE_IS_UNIX(base)) &&
+               (uint16_t)(log->boot - (uint16_t)tag[LOG_TAG_BOOT]) <= LOG_SLOT_BOOT_MAX;
+    }
+    return LOG_BASE_IS_UNIX(base) && log->time >= base && log->time - base <= LOG_DT_MAX;
+}
 
-    nvs_close(handle);
+// Codifica e grava em ordem; abre setor novo só quando o registro não cabe
+// nos campos do setor atual (delta de tempo ou de boot estourado)
+static esp_err_t append_logs(const rfid_log_t *logs, int n) {
+    log_slot_t slots[STORAGE_BATCH_MAX];
+    uint32_t tag[FLASH_JOURNAL_TAGS];
+    flash_journal_head_room(&log_journal, tag);
+
+    esp_err_t err = ESP_OK;
+    int run = 0;
+    for (int i = 0; i < n && err == ESP_OK; i++) {
+        if (!log_fits(&logs[i], tag)) {
+            err = flash_journal_append_batch(&log_journal, slots, run, NULL);
+            run = 0;
+            if (err != ESP_OK) break;
+            // A base de hora segue valendo para os registros com hora que vierem
+            // depois; o boot do setor é o atual, com folga para os próximos
+            if (logs[i].time_valid) {
+                tag[LOG_TAG_BASE_TIME] = logs[i].time;
+                tag[LOG_TAG_BOOT] = time_service_boot_id();
+            } else {
+                tag[LOG_TAG_BOOT] = logs[i].boot;
+                if (!LOG_BASE_IS_UNIX(tag[LOG_TAG_BASE_TIME])) tag[LOG_TAG_BASE_TIME] = 0;
+            }
+            err = flash_journal_open_sector(&log_journal, tag);
+            if (err != ESP_OK) break;
+        }
+        encode_log(&logs[i], tag, &slots[run++]);
+        if (run == STORAGE_BATCH_MAX) {
+            err = flash_journal_append_batch(&log_journal, slots, run, NULL);
+            run = 0;
+        }
+    }
+    if (err == ESP_OK && run > 0) {
+        err = flash_journal_append_batch(&log_journal, slots, run, NULL);
+    }
     return err;
 }
 
-static esp_err_t save_logs_to_nvs() {
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &handle);
-    if (err != ESP_OK) return err;
+static void commit_batch(rfid_ticket_t first, rfid_ticket_t last) {
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = ESP_OK;
+    // Bytes de slot do lote; um snapshot regrava a tabela e não entra na conta
+    uint32_t bytes = (uint32_t)n_log_batch * log_journal.slot_size;
+    if (!snapshot_pending) bytes += (uint32_t)n_user_batch * user_wal.slot_size;
 
-    err = nvs_set_blob(handle, KEY_LOGS, log_db, sizeof(log_db));
+    if (snapshot_pending) {
+        // O snapshot já contém as alterações do lote: a RAM muda antes de enfileirar
+        err = compact_users();
+        if (err == ESP_ERR_INVALID_STATE) err = compact_users();
+        snapshot_pending = false;
+    } else if (n_user_batch > 0) {
+        err = write_user_batch();
+    }
+    if (n_log_batch > 0) {
+        esp_err_t lerr = append_logs(log_batch, n_log_batch);
+        if (err == ESP_OK) err = lerr;
+    }
+
+    int64_t dt = esp_timer_get_time() - t0;
+    uint32_t n = (uint32_t)(n_user_batch + n_log_batch);
+    dstats.commits++;
+    dstats.records += n;
+    if (n > dstats.max_batch) dstats.max_batch = n;
+    dstats.last_commit_us = dt;
+    if (dt > dstats.max_commit_us) dstats.max_commit_us = dt;
+    metrics_inc(MET_STORAGE_COMMITS);
+    metrics_add(MET_STORAGE_COMMIT_RECORDS, n);
+    metrics_add(MET_STORAGE_COMMIT_BYTES, bytes);
+    metrics_observe_us(MET_H_STORAGE_COMMIT, dt);
+    if (err != ESP_OK) {
+        dstats.errors++;
+        metrics_inc(MET_STORAGE_COMMIT_ERRORS);
+        failed_first = first;
+        failed_last = last;
+        ESP_LOGE(TAG, "Falha no commit de %lu registros: %s", (unsigned long)n, esp_err_to_name(err));
+    }
+
+    n_user_batch = 0;
+    n_log_batch = 0;
+    if (last != 0) durable_ticket = last;
+
+    // Acorda todos que esperam agora; quem chegar depois confere o ticket antes
+    xEventGroupSetBits(commit_events, COMMIT_DONE_BIT);
+    xEventGroupClearBits(commit_events, COMMIT_DONE_BIT);
+}
+
+static void batch_add(const storage_op_t *op) {
+    metrics_gauge_max(MET_QUEUE_STORAGE, uxQueueMessagesWaiting(storage_queue) + 1);
+    if (op->type == STORAGE_OP_LOG) {
+        log_batch[n_log_batch++] = op->log;
+    } else if (op->type == STORAGE_OP_USER) {
+        user_batch[n_user_batch++] = op->user;
+    } else if (op->type == STORAGE_OP_SNAPSHOT) {
+        snapshot_pending = true;
+    }
+}
+
+static void storage_task(void *arg) {
+    storage_op_t op;
+    while (1) {
+        if (xQueueReceive(storage_queue, &op, portMAX_DELAY) != pdTRUE) continue;
+
+        // Janela conta a partir da primeira alteração do lote
+        int64_t deadline = esp_timer_get_time() + (int64_t)commit_window_ms * 1000;
+        rfid_ticket_t first = op.ticket, last = op.ticket;
+        bool flush = (op.type == STORAGE_OP_FLUSH || op.type == STORAGE_OP_SNAPSHOT);
+        batch_add(&op);
+
+        while (!flush && n_log_batch < (int)commit_max_records && n_user_batch < (int)commit_max_records) {
+            int64_t left_us = deadline - esp_timer_get_time();
+            if (left_us <= 0) break;
+            if (xQueueReceive(storage_queue, &op, pdMS_TO_TICKS((left_us + 999) / 1000) + 1) != pdTRUE) break;
+            last = op.ticket;
+            flush = (op.type == STORAGE_OP_FLUSH || op.type == STORAGE_OP_SNAPSHOT);
+            batch_add(&op);
+        }
+        commit_batch(first, last);
+
+        // Ocioso: apaga setores com antecedência para o próximo commit não esperar por isso
+        if (uxQueueMessagesWaiting(storage_queue) == 0) {
+            flash_journal_prepare(&log_journal);
+            flash_journal_prepare(&user_wal);
+        }
+    }
+}
+
+// Chamar com order_lock: ticket e posição na fila seguem a mesma ordem
+static esp_err_t storage_enqueue_locked(storage_op_t *op, TickType_t wait, rfid_ticket_t *ticket) {
+    op->ticket = next_ticket;
+    esp_err_t err = (xQueueSend(storage_queue, op, wait) == pdTRUE) ? ESP_OK : ESP_ERR_TIMEOUT;
     if (err == ESP_OK) {
-        err = nvs_set_i32(handle, "log_count", log_count);
+        next_ticket++;
+        if (next_ticket == 0) next_ticket = 1;
     }
+    if (ticket) *ticket = (err == ESP_OK) ? op->ticket : 0;
+    return err;
+}
+
+static esp_err_t queue_user_op(user_op_t op, const char *uid, const char *name, rfid_ticket_t *ticket) {
+    storage_op_t sop = { .type = STORAGE_OP_USER };
+    sop.user.op = (uint8_t)op;
+    strncpy(sop.user.user.uid, uid, sizeof(sop.user.user.uid) - 1);
+    if (name) {
+        strncpy(sop.user.user.name, name, sizeof(sop.user.user.name) - 1);
+    }
+    return storage_enqueue_locked(&sop, portMAX_DELAY, ticket);
+}
 
-    nvs_commit(handle);
-    nvs_close(handle);
+static bool read_snap_hdr(int slot, user_snap_hdr_t *hdr) {
+    if (esp_partition_read(snap_part, (size_t)slot * snap_slot_size, hdr, sizeof(*hdr)) != ESP_OK) return false;
+    return hdr->magic == USER_SNAP_MAGIC && hdr->version == USER_SNAP_VERSION &&
+           hdr->record_size == sizeof(rfid_user_t) && hdr->hdr_crc == snap_hdr_crc(hdr);
+}
+
+// Slot válido mais novo; se os usuários não baterem com o CRC, o outro.
+// ESP_ERR_NOT_FOUND sem nenhum cabeçalho válido.
+static esp_err_t load_user_snapshot(void) {
+    user_snap_hdr_t hdr[2];
+    bool valid[2] = { read_snap_hdr(0, &hdr[0]), read_snap_hdr(1, &hdr[1]) };
+    if (!valid[0] && !valid[1]) return ESP_ERR_NOT_FOUND;
+
+    int order[2] = { 0, 1 };
+    if (valid[0] && valid[1] && (int32_t)(hdr[1].gen - hdr[0].gen) > 0) {
+        order[0] = 1;
+        order[1] = 0;
+    }
+    esp_err_t err = ESP_ERR_INVALID_CRC;
+    for (int i = 0; i < 2; i++) {
+        int slot = order[i];
+        if (!valid[slot]) continue;
+        // A próxima gravação vai no outro slot, mesmo se este não carregar
+        if (snap_slot < 0) snap_slot = slot;
+        if (hdr[slot].count > MAX_USERS) {
+            ESP_LOGE(TAG, "Snapshot com %lu usuarios, capacidade %d", (unsigned long)hdr[slot].count, MAX_USERS);
+            err = ESP_ERR_INVALID_SIZE;
+            continue;
+        }
+        size_t users_size = (size_t)hdr[slot].count * sizeof(rfid_user_t);
+        if ((users_size && esp_partition_read(snap_part, (size_t)slot * snap_slot_size + USER_SNAP_DATA_OFFSET,
+                                              user_db, users_size) != ESP_OK) ||
+            esp_rom_crc32_le(0, (const uint8_t *)user_db, users_size) != hdr[slot].crc) {
+            ESP_LOGW(TAG, "Snapshot de usuarios no slot %d com CRC invalido", slot);
+            err = ESP_ERR_INVALID_CRC;
+            continue;
+        }
+        user_count = (int)hdr[slot].count;
+        user_gen = hdr[slot].gen;
+        user_epoch = hdr[slot].epoch;
+        snap_slot = slot;
+        return ESP_OK;
+    }
     return err;
 }
 
-static esp_err_t load_logs_from_nvs() {
-    nvs_handle_t handle;
-    size_t required_size = sizeof(log_db);
-    esp_err_t err = nvs_open(STORAGE_NAMESPACE, NVS_READONLY, &handle);
+// Snapshot v1: blob no NVS, cabeçalho sem hdr_crc
+static esp_err_t load_nvs_snapshot(nvs_handle_t handle) {
+    size_t size = 0;
+    esp_err_t err = nvs_get_blob(handle, KEY_USER_SNAP, NULL, &size);
     if (err != ESP_OK) return err;
+    if (size < USER_SNAP_V1_HDR_SIZE) return ESP_ERR_INVALID_SIZE;
 
-    err = nvs_get_blob(handle, KEY_LOGS, log_db, &required_size);
-    if (err == ESP_ERR_NVS_NOT_FOUND) {
-        nvs_close(handle);
-        return ESP_OK; // vazio
+    uint8_t *blob = malloc(size);
+    if (!blob) return ESP_ERR_NO_MEM;
+
+    err = nvs_get_blob(handle, KEY_USER_SNAP, blob, &size);
+    if (err == ESP_OK) {
+        user_snap_hdr_t hdr = {0};
+        memcpy(&hdr, blob, USER_SNAP_V1_HDR_SIZE);
+        size_t users_size = (size_t)hdr.count * sizeof(rfid_user_t);
+        const uint8_t *users = blob + USER_SNAP_V1_HDR_SIZE;
+
+        if (hdr.magic != USER_SNAP_MAGIC || hdr.version != 1 ||
+            hdr.record_size != sizeof(rfid_user_t) || hdr.count > MAX_USERS ||
+            size != USER_SNAP_V1_HDR_SIZE + users_size) {
+            err = ESP_ERR_INVALID_SIZE;
+        } else if (hdr.crc != esp_rom_crc32_le(0, users, users_size)) {
+            err = ESP_ERR_INVALID_CRC;
+        } else {
+            memcpy(user_db, users, users_size);
+            user_count = (int)hdr.count;
+            user_gen = hdr.gen;
+            user_epoch = hdr.gen; // o WAL da v1 era ligado à geração
+        }
     }
+    free(blob);
+    return err;
+}
+
+// Formato antigo: user_db inteiro num blob + "user_count"
+static esp_err_t load_legacy_users(nvs_handle_t handle) {
+    size_t required_size = MAX_USERS * sizeof(rfid_user_t);
+    esp_err_t err = nvs_get_blob(handle, KEY_USERS, user_db, &required_size);
+    if (err != ESP_OK) return err;
 
     int32_t count = 0;
-    if (nvs_get_i32(handle, "log_count", &count) == ESP_OK) {
-        log_count = count;
+    if (nvs_get_i32(handle, "user_count", &count) == ESP_OK) {
+        user_count = (count < 0 || count > MAX_USERS) ? 0 : count;
     }
+    return ESP_OK;
+}
 
-    nvs_close(handle);
-    return err;
+// Reaplica os registros do WAL da época atual, em ordem
+static void replay_user_wal(void) {
+    uint32_t end = flash_journal_next_seq(&user_wal);
+    int applied = 0, skipped = 0;
+
+    for (uint32_t seq = flash_journal_first_seq(&user_wal); seq < end; seq++) {
+        user_wal_rec_t rec;
+        if (flash_journal_read(&user_wal, seq, &rec) != ESP_OK) {
+            skipped++; // CRC inválido: escrita interrompida
+            continue;
+        }
+        if (rec.epoch != user_epoch) continue;
+
+        rec.user.uid[MAX_UID_LEN - 1] = '\0';
+        rec.user.name[MAX_NAME_LEN - 1] = '\0';
+        if (rec.op == USER_OP_ADD) {
+            user_db_add(rec.user.uid, rec.user.name);
+        } else if (rec.op == USER_OP_REMOVE) {
+            user_db_remove(rec.user.uid);
+        }
+        applied++;
+    }
+    user_wal_pending = (uint32_t)applied;
+    ESP_LOGI(TAG, "WAL de usuarios: %d registros aplicados, %d ignorados", applied, skipped);
 }
 
-// ====================== API pública ======================
+static esp_err_t load_users(void) {
+    nvs_handle_t handle = nvs_storage_handle();
+    const char *migrate_key = NULL;
+    bool have_snapshot = true;
+    esp_err_t err = load_user_snapshot();
+    if (err != ESP_OK && err != ESP_ERR_NOT_FOUND) {
+        ESP_LOGE(TAG, "Snapshot de usuarios invalido: %s", esp_err_to_name(err));
+    }
+    if (err == ESP_ERR_NOT_FOUND) {
+        // Versões anteriores: snapshot no NVS ou a tabela inteira num blob
+        if (load_nvs_snapshot(handle) == ESP_OK) {
+            migrate_key = KEY_USER_SNAP;
+        } else {
+            have_snapshot = false;
+            if (load_legacy_users(handle) == ESP_OK) migrate_key = KEY_USERS;
+        }
+    } else if (err != ESP_OK) {
+        have_snapshot = false;
+    }
+    rebuild_user_index();
 
-esp_err_t rfid_storage_init() {
-    esp_err_t err = nvs_flash_init();
-    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        err = nvs_flash_init();
+    err = flash_journal_open(&user_wal, USER_WAL_PARTITION, sizeof(user_wal_rec_t));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "WAL de usuarios indisponivel: %s", esp_err_to_name(err));
+        return err;
+    }
+    if (have_snapshot) {
+        replay_user_wal();
+    } else {
+        // Sem snapshot o WAL não tem a que se ligar: grava um agora, com época
+        // nova, antes da primeira alteração. O que sobrou no WAL fica órfão.
+        uint32_t left = flash_journal_next_seq(&user_wal) - flash_journal_first_seq(&user_wal);
+        if (left) ESP_LOGW(TAG, "WAL de usuarios sem snapshot: %lu registros descartados", (unsigned long)left);
+        if (!migrate_key && compact_users() != ESP_OK) {
+            ESP_LOGE(TAG, "Falha ao gravar o snapshot de usuarios inicial");
+        }
     }
 
-    // Carrega dados
-    load_users_from_nvs();
-    load_logs_from_nvs();
+    if (migrate_key) {
+        // Primeiro boot após a atualização: o WAL do snapshot antigo já foi
+        // aplicado; a tabela vira o snapshot da geração seguinte na partição
+        if (compact_users() == ESP_OK) {
+            nvs_erase_key(handle, migrate_key);
+            if (strcmp(migrate_key, KEY_USERS) == 0) nvs_erase_key(handle, "user_count");
+            nvs_storage_commit();
+            ESP_LOGI(TAG, "Usuarios migrados do NVS para a particao %s", USER_SNAP_PARTITION);
+        }
+    }
     return ESP_OK;
 }
 
-int rfid_get_logs(rfid_log_t **logs) {
-    *logs = log_db;
-    return log_count;
+// UID e data em texto das versões antigas -> registro binário.
+// "FC:numero" vira credencial sem formato conhecido; hex vira RAW.
+static bool text_to_log(const char *uid, const char *timestamp, rfid_log_t *out) {
+    memset(out, 0, sizeof(*out));
+    out->count = 1;
+    out->time_valid = 1;
+
+    unsigned long fc, card;
+    char tail;
+    if (sscanf(uid, "%lu:%lu%c", &fc, &card, &tail) == 2) {
+        out->cred = ((uint64_t)(fc & 0xFFFFFF) << 32) | (uint32_t)card;
+    } else {
+        char *end;
+        unsigned long long raw = strtoull(uid, &end, 16);
+        if (end == uid || *end != '\0') return false;
+        out->cred = ((uint64_t)WG_FMT_RAW << 56) | (raw & ((1ULL << 56) - 1));
+    }
+
+    struct tm tm = {0};
+    int h2, m2, s2;
+    int n = sscanf(timestamp, "%d-%d-%d %d:%d:%d-%d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                   &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &h2, &m2, &s2);
+    if (n < 5) return false;
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    time_t t = mktime(&tm);
+    if (t < 0) return false;
+    out->time = (uint32_t)t;
+    if (n == 9) {
+        // Agregado "t0-t1" (só hora no t1)
+        int span = ((h2 * 3600 + m2 * 60 + s2) - (tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec) + 86400) % 86400;
+        out->span_s = span > 255 ? 255 : (uint8_t)span;
+    }
+    return true;
 }
 
-int rfid_list_users(rfid_user_t **users) {
-    *users = user_db;
-    return user_count;
+// Journal de logs em texto (registros de 68 bytes): traz os mais recentes
+// para a RAM antes de a partição ser reformatada para o registro binário
+static int read_text_log_journal(rfid_log_t **out) {
+    uint16_t rec_size;
+    uint8_t version;
+    *out = NULL;
+    if (flash_journal_probe(LOG_PARTITION, &rec_size, &version) != ESP_OK ||
+        rec_size != sizeof(legacy_text_log_t)) {
+        return 0;
+    }
+
+    flash_journal_t old;
+    if (flash_journal_open(&old, LOG_PARTITION, sizeof(legacy_text_log_t)) != ESP_OK) {
+        flash_journal_close(&old);
+        return 0;
+    }
+
+    uint32_t end = flash_journal_next_seq(&old);
+    uint32_t seq = flash_journal_first_seq(&old);
+    if (end - seq > LEGACY_LOG_MIGRATE_MAX) seq = end - LEGACY_LOG_MIGRATE_MAX;
+
+    int n = 0;
+    *out = calloc(end - seq, sizeof(rfid_log_t));
+    for (; *out && seq < end; seq++) {
+        legacy_text_log_t rec;
+        if (flash_journal_read(&old, seq, &rec) != ESP_OK) continue;
+        rec.uid[MAX_UID_LEN - 1] = '\0';
+        rec.timestamp[MAX_TIMESTAMP_LEN - 1] = '\0';
+        if (text_to_log(rec.uid, rec.timestamp, &(*out)[n])) {
+            (*out)[n].decision = rec.granted ? RFID_LOG_GRANTED : RFID_LOG_DENIED;
+            (*out)[n].count = rec.count > 1 ? rec.count : 1;
+            n++;
+        }
+    }
+    ESP_LOGW(TAG, "Journal de logs em texto: %d registros recentes serao convertidos", n);
+    flash_journal_close(&old);
+    return n;
 }
 
-esp_err_t rfid_add_user(const char *uid, const char *name) {
-    if (user_count >= MAX_USERS) {
+static void append_migrated_logs(const rfid_log_t *logs, int n) {
+    for (int i = 0; i < n; i += STORAGE_BATCH_MAX) {
+        append_logs(&logs[i], (n - i) < STORAGE_BATCH_MAX ? (n - i) : STORAGE_BATCH_MAX);
+    }
+}
+
+// Importa o blob de logs da versão anterior para o journal (uma única vez)
+static void migrate_legacy_logs(void) {
+    nvs_handle_t handle = nvs_storage_handle();
+    int32_t count = 0;
+    size_t required_size = 0;
+    if (nvs_get_i32(handle, "log_count", &count) == ESP_OK &&
+        nvs_get_blob(handle, KEY_LOGS, NULL, &required_size) == ESP_OK) {
+        legacy_nvs_log_t *legacy = calloc(MAX_LOGS, sizeof(legacy_nvs_log_t));
+        rfid_log_t *logs = calloc(MAX_LOGS, sizeof(rfid_log_t));
+        required_size = MAX_LOGS * sizeof(legacy_nvs_log_t);
+        if (legacy && logs && nvs_get_blob(handle, KEY_LOGS, legacy, &required_size) == ESP_OK) {
+            if (count > MAX_LOGS) count = MAX_LOGS;
+            int n = 0;
+            for (int i = 0; i < count; i++) {
+                legacy[i].uid[MAX_UID_LEN - 1] = '\0';
+                legacy[i].timestamp[MAX_TIMESTAMP_LEN - 1] = '\0';
+                if (text_to_log(legacy[i].uid, legacy[i].timestamp, &logs[n])) {
+                    logs[n++].decision = RFID_LOG_UNKNOWN;
+                }
+            }
+            append_migrated_logs(logs, n);
+            ESP_LOGI(TAG, "%d logs migrados para o journal", n);
+        }
+        free(legacy);
+        free(logs);
+        nvs_erase_key(handle, KEY_LOGS);
+        nvs_erase_key(handle, "log_count");
+        nvs_storage_commit();
+    }
+}
+
+// ====================== API pública ======================
+
+esp_err_t rfid_storage_init() {
+    // NVS, handle único e migração do esquema (nvs_storage.c)
+    esp_err_t err = nvs_storage_init();
+    if (err != ESP_OK) return err;
+    err = open_user_snapshot();
+    if (err != ESP_OK) return err;
+
+    user_db = mem_budget_alloc(MEM_SUB_STORAGE, MAX_USERS * sizeof(rfid_user_t));
+    user_index_slots = mem_budget_alloc(MEM_SUB_STORAGE, USER_INDEX_SLOTS * sizeof(uid_index_slot_t));
+    log_batch = mem_budget_alloc(MEM_SUB_STORAGE, STORAGE_BATCH_MAX * sizeof(rfid_log_t));
+    user_batch = mem_budget_alloc(MEM_SUB_STORAGE, STORAGE_BATCH_MAX * sizeof(user_wal_rec_t));
+    if (!user_db || !user_index_slots || !log_batch || !user_batch) return ESP_ERR_NO_MEM;
+
+    user_lock = xSemaphoreCreateMutex();
+    order_lock = xSemaphoreCreateMutex();
+    storage_queue = xQueueCreate(STORAGE_QUEUE_LEN, sizeof(storage_op_t));
+    commit_events = xEventGroupCreate();
+    if (!user_lock || !order_lock || !storage_queue || !commit_events) return ESP_ERR_NO_MEM;
+
+    // Carrega dados
+    load_users();
+
+    rfid_log_t *text_logs;
+    int n_text_logs = read_text_log_journal(&text_logs);
+
+    err = flash_journal_open(&log_journal, LOG_PARTITION, sizeof(log_slot_t));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Journal de logs indisponivel: %s", esp_err_to_name(err));
+    } else {
+        append_migrated_logs(text_logs, n_text_logs);
+        migrate_legacy_logs();
+    }
+    free(text_logs);
+
+    // Daqui em diante só a task de gravação escreve na flash
+    if (mem_budget_task_create(MEM_SUB_STORAGE, storage_task, "storage", 4096, NULL, STORAGE_TASK_PRIO, NULL) != pdPASS) {
         return ESP_ERR_NO_MEM;
     }
+    return ESP_OK;
+}
 
-    for (int i = 0; i < user_count; i++) {
-        if (strcmp(user_db[i].uid, uid) == 0) {
-            return ESP_ERR_INVALID_STATE; // já cadastrado
+uint32_t rfid_log_first_seq(void) {
+    return flash_journal_first_seq(&log_journal);
+}
+
+uint32_t rfid_log_next_seq(void) {
+    return flash_journal_next_seq(&log_journal);
+}
+
+esp_err_t rfid_log_read(uint32_t seq, rfid_log_t *log) {
+    log_slot_t slot;
+    uint32_t tag[FLASH_JOURNAL_TAGS];
+    esp_err_t err = flash_journal_read_tagged(&log_journal, seq, &slot, tag);
+    if (err == ESP_OK) {
+        decode_log(&slot, tag, log);
+        // Correção retroativa: o offset do boot ficou conhecido depois
+        uint32_t offset_s;
+        if (!log->time_valid && time_service_boot_offset(log->boot, &offset_s)) {
+            log->time += offset_s;
+            log->time_valid = 1;
         }
     }
+    return err;
+}
 
-    strncpy(user_db[user_count].uid, uid, sizeof(user_db[user_count].uid) - 1);
-    strncpy(user_db[user_count].name, name, sizeof(user_db[user_count].name) - 1);
-    user_count++;
+size_t rfid_log_format_uid(const rfid_log_t *log, char *buf, size_t len) {
+    wg_credential_t cred;
+    wg_credential_from_id(log->cred, &cred);
+    return wg_credential_to_str(&cred, buf, len);
+}
 
-    return save_users_to_nvs();
+size_t rfid_log_format_time(const rfid_log_t *log, char *buf, size_t len) {
+    if (!log->time_valid) {
+        int n = snprintf(buf, len, "boot %u +%lus", log->boot, (unsigned long)log->time);
+        return n < 0 ? 0 : (size_t)n;
+    }
+
+    time_t t = (time_t)log->time;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    size_t n = strftime(buf, len, "%Y-%m-%d %H:%M:%S", &tm);
+    if (log->count > 1 && n > 0) {
+        // Agregado: primeira e última tentativa
+        t += log->span_s;
+        localtime_r(&t, &tm);
+        n += strftime(buf + n, len - n, "-%H:%M:%S", &tm);
+    }
+    return n;
 }
 
-esp_err_t rfid_remove_user(const char *uid) {
-    for (int i = 0; i < user_count; i++) {
-        if (strcmp(user_db[i].uid, uid) == 0) {
-            user_db[i] = user_db[user_count - 1];
-            user_count--;
-            return save_users_to_nvs();
+int rfid_copy_users(int start, rfid_user_t *out, int max, uint32_t *version) {
+    xSemaphoreTake(user_lock, portMAX_DELAY);
+    int n = (start >= 0 && start < user_count) ? user_count - start : 0;
+    if (n > max) n = max;
+    memcpy(out, &user_db[start > 0 ? start : 0], (size_t)n * sizeof(rfid_user_t));
+    if (version) *version = user_version;
+    xSemaphoreGive(user_lock);
+    return n;
+}
+
+esp_err_t rfid_add_user(const char *uid, const char *name, rfid_ticket_t *ticket) {
+    if (ticket) *ticket = 0;
+    xSemaphoreTake(order_lock, portMAX_DELAY);
+
+    // user_lock só durante a alteração em RAM: a decisão de acesso nunca espera a flash
+    xSemaphoreTake(user_lock, portMAX_DELAY);
+    esp_err_t err = user_db_add(uid, name);
+    if (err == ESP_OK) user_version++;
+    xSemaphoreGive(user_lock);
+    if (err == ESP_OK) fast_boot_acl_changed();
+
+    if (err == ESP_OK) {
+        err = queue_user_op(USER_OP_ADD, uid, name, ticket);
+    }
+    xSemaphoreGive(order_lock);
+    return err;
+}
+
+esp_err_t rfid_remove_user(const char *uid, rfid_ticket_t *ticket) {
+    if (ticket) *ticket = 0;
+    xSemaphoreTake(order_lock, portMAX_DELAY);
+
+    xSemaphoreTake(user_lock, portMAX_DELAY);
+    esp_err_t err = user_db_remove(uid);
+    if (err == ESP_OK) user_version++;
+    xSemaphoreGive(user_lock);
+    if (err == ESP_OK) fast_boot_acl_changed();
+
+    if (err == ESP_OK) {
+        err = queue_user_op(USER_OP_REMOVE, uid, NULL, ticket);
+    }
+    xSemaphoreGive(order_lock);
+    return err;
+}
+
+esp_err_t rfid_import_users(const rfid_user_t *users, int count, rfid_import_mode_t mode, bool dry_run,
+                            rfid_import_result_t *result, rfid_ticket_t *ticket) {
+    if (ticket) *ticket = 0;
+    memset(result, 0, sizeof(*result));
+    if (count < 0 || count > MAX_USERS) return ESP_ERR_NO_MEM;
+
+    xSemaphoreTake(order_lock, portMAX_DELAY);
+    xSemaphoreTake(user_lock, portMAX_DELAY);
+
+    // Primeiro só conta: se não couber, nada muda
+    for (int i = 0; i < count; i++) {
+        int pos = uid_index_find(&user_index, users[i].uid);
+        if (pos < 0) {
+            result->added++;
+        } else if (strncmp(user_db[pos].name, users[i].name, MAX_NAME_LEN) != 0) {
+            result->updated++;
+        } else {
+            result->unchanged++;
         }
     }
-    return ESP_ERR_NOT_FOUND;
+    if (mode == RFID_IMPORT_REPLACE) {
+        result->removed = user_count - result->updated - result->unchanged;
+        result->total = count;
+    } else {
+        result->total = user_count + result->added;
+    }
+
+    esp_err_t err = ESP_OK;
+    bool changed = result->added || result->updated || result->removed;
+    if (result->total > MAX_USERS) {
+        err = ESP_ERR_NO_MEM;
+    } else if (!dry_run && changed) {
+        if (mode == RFID_IMPORT_REPLACE) {
+            memcpy(user_db, users, count * sizeof(rfid_user_t));
+            user_count = count;
+            rebuild_user_index();
+        } else {
+            for (int i = 0; i < count; i++) {
+                int pos = uid_index_find(&user_index, users[i].uid);
+                if (pos < 0) {
+                    user_db_add(users[i].uid, users[i].name);
+                } else {
+                    memset(user_db[pos].name, 0, sizeof(user_db[pos].name));
+                    strncpy(user_db[pos].name, users[i].name, sizeof(user_db[pos].name) - 1);
+                }
+            }
+        }
+        user_version++;
+        fast_boot_acl_changed();
+    }
+    xSemaphoreGive(user_lock);
+
+    // Um único commit para o lote inteiro
+    if (err == ESP_OK && !dry_run && changed) {
+        storage_op_t op = { .type = STORAGE_OP_SNAPSHOT };
+        err = storage_enqueue_locked(&op, portMAX_DELAY, ticket);
+    }
+    xSemaphoreGive(order_lock);
+
+    if (err == ESP_OK && !dry_run && changed) {
+        ESP_LOGI(TAG, "Importacao: +%lu ~%lu -%lu, %lu usuarios", (unsigned long)result->added,
+                 (unsigned long)result->updated, (unsigned long)result->removed, (unsigned long)result->total);
+    }
+    return err;
 }
 
 bool rfid_is_user_authorized(const char *uid) {
+    xSemaphoreTake(user_lock, portMAX_DELAY);
+    bool found = uid_index_find(&user_index, uid) >= 0;
+    xSemaphoreGive(user_lock);
+    return found;
+}
+
+void rfid_for_each_user(void (*fn)(const rfid_user_t *user, void *arg), void *arg) {
+    xSemaphoreTake(user_lock, portMAX_DELAY);
     for (int i = 0; i < user_count; i++) {
-        if (strcmp(user_db[i].uid, uid) == 0) {
-            return true;
-        }
+        fn(&user_db[i], arg);
     }
-    return false;
+    xSemaphoreGive(user_lock);
 }
 
-esp_err_t rfid_add_log(const char *uid, const char *timestamp) {
-    if (log_count >= MAX_LOGS) {
-        // FIFO - remove o mais antigo
-        for (int i = 1; i < MAX_LOGS; i++) {
-            log_db[i - 1] = log_db[i];
-        }
-        log_count = MAX_LOGS - 1;
+uint32_t rfid_users_version(void) {
+    return user_version;
+}
+
+esp_err_t rfid_add_log(const rfid_log_t *log, rfid_ticket_t *ticket) {
+    storage_op_t op = { .type = STORAGE_OP_LOG, .log = *log };
+
+    // Vai para o fim do journal no próximo commit em grupo
+    xSemaphoreTake(order_lock, portMAX_DELAY);
+    esp_err_t err = storage_enqueue_locked(&op, pdMS_TO_TICKS(STORAGE_LOG_WAIT_MS), ticket);
+    xSemaphoreGive(order_lock);
+    return err;
+}
+
+bool rfid_storage_is_durable(rfid_ticket_t ticket) {
+    return ticket == 0 || (int32_t)(durable_ticket - ticket) >= 0;
+}
+
+esp_err_t rfid_storage_wait(rfid_ticket_t ticket, uint32_t timeout_ms) {
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    while (!rfid_storage_is_durable(ticket)) {
+        int64_t left_ms = (deadline - esp_timer_get_time()) / 1000;
+        if (left_ms <= 0) return ESP_ERR_TIMEOUT;
+        // Fatias curtas: um commit entre a checagem e o wait não se perde
+        if (left_ms > STORAGE_WAIT_SLICE_MS) left_ms = STORAGE_WAIT_SLICE_MS;
+        xEventGroupWaitBits(commit_events, COMMIT_DONE_BIT, pdFALSE, pdFALSE,
+                            pdMS_TO_TICKS(left_ms) + 1);
+    }
+    if (failed_last != 0 && (int32_t)(ticket - failed_first) >= 0 && (int32_t)(failed_last - ticket) >= 0) {
+        return ESP_FAIL;
     }
+    return ESP_OK;
+}
 
-    strncpy(log_db[log_count].uid, uid, sizeof(log_db[log_count].uid) - 1);
-    strncpy(log_db[log_count].timestamp, timestamp, sizeof(log_db[log_count].timestamp) - 1);
-    log_count++;
+esp_err_t rfid_storage_flush(rfid_ticket_t *ticket) {
+    storage_op_t op = { .type = STORAGE_OP_FLUSH };
+    xSemaphoreTake(order_lock, portMAX_DELAY);
+    esp_err_t err = storage_enqueue_locked(&op, portMAX_DELAY, ticket);
+    xSemaphoreGive(order_lock);
+    return err;
+}
 
-    return save_logs_to_nvs();
+esp_err_t rfid_storage_set_commit_window(uint32_t window_ms, uint32_t max_records) {
+    if (max_records == 0 || max_records > STORAGE_BATCH_MAX || window_ms > 10000) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    commit_window_ms = window_ms;
+    commit_max_records = max_records;
+    return ESP_OK;
 }
 
+void rfid_storage_get_durability(rfid_durability_t *out) {
+    *out = dstats;
+    out->window_ms = commit_window_ms;
+    out->max_records = commit_max_records;
+    out->last_ticket = next_ticket - 1;
+    out->durable_ticket = durable_ticket;
+    out->pending = out->last_ticket - durable_ticket;
+}
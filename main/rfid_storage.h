@@ -1,13 +1,28 @@
 #ifndef RFID_STORAGE_H
 #define RFID_STORAGE_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "esp_err.h"
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
 
 #define MAX_UID_LEN      32
 #define MAX_NAME_LEN     64
-#define MAX_TIMESTAMP_LEN 32
-#define MAX_USERS         50
-#define MAX_LOGS          50
+#define MAX_TIMESTAMP_LEN 32   // texto de data/hora na renderização
+#ifdef CONFIG_RFID_MAX_USERS
+#define MAX_USERS         CONFIG_RFID_MAX_USERS   // Kconfig; tabelas alocadas no init
+#else
+#define MAX_USERS         1000
+#endif
+#define MAX_LOGS          50   // registros exibidos por página de logs
+
+// Gravação em grupo: alterações aceitas ficam em RAM no máximo por esta
+// janela (ou até juntar este número de registros) antes de irem à flash.
+#define RFID_COMMIT_WINDOW_MS     200
+#define RFID_COMMIT_MAX_RECORDS   32
 
 // Estrutura de usuário
 typedef struct {
@@ -15,22 +30,94 @@ typedef struct {
     char name[MAX_NAME_LEN];
 } rfid_user_t;
 
-// Estrutura de log
+// Decisão registrada no log
+#define RFID_LOG_DENIED    0
+#define RFID_LOG_GRANTED   1
+#define RFID_LOG_UNKNOWN   2    // migrado de versões que não guardavam a decisão
+
+// Registro de acesso, forma decodificada. Na flash ocupa 16 bytes, com o
+// tempo em delta contra o bloco (ver log_slot_t em rfid_storage.c).
+// Texto (UID, data) só na renderização: rfid_log_format_uid/_time.
 typedef struct {
-    char uid[MAX_UID_LEN];
-    char timestamp[MAX_TIMESTAMP_LEN];
+    uint64_t cred;              // wg_credential_t.id
+    uint32_t time;              // época Unix (s), primeira tentativa; sem time_valid: s desde o boot
+    uint16_t count;             // tentativas agregadas (1 = uma só)
+    uint8_t  decision;          // RFID_LOG_*
+    uint8_t  reader;            // 0..7 (porta da política)
+    uint8_t  span_s;            // agregados: última - primeira tentativa (s, saturado)
+    uint8_t  time_valid;        // 0 = gravado antes de a hora ser conhecida (time_service.h)
+    uint16_t boot;              // boot do registro (só preenchido sem time_valid)
 } rfid_log_t;
 
-// Inicialização
+// Importação em lote (rfid_import_users)
+typedef enum {
+    RFID_IMPORT_MERGE = 0,      // inclui/atualiza os da lista, mantém os demais
+    RFID_IMPORT_REPLACE,        // a tabela passa a ser exatamente a lista
+} rfid_import_mode_t;
+
+typedef struct {
+    uint32_t added;
+    uint32_t updated;           // UID existente com outro nome
+    uint32_t removed;           // só em RFID_IMPORT_REPLACE
+    uint32_t unchanged;
+    uint32_t total;             // usuários na tabela depois da importação
+} rfid_import_result_t;
+
+// Ticket de durabilidade: cada alteração enfileirada recebe um número
+// crescente; quando a flash alcança o ticket, a alteração está persistida.
+typedef uint32_t rfid_ticket_t;     // 0 = nenhum
+
+typedef struct {
+    uint32_t window_ms;             // tempo máximo de uma alteração só em RAM
+    uint32_t max_records;
+    rfid_ticket_t last_ticket;      // último ticket emitido
+    rfid_ticket_t durable_ticket;   // tudo até aqui está na flash
+    uint32_t pending;               // aceitas e ainda não gravadas
+    uint32_t commits;
+    uint32_t records;
+    uint32_t errors;
+    uint32_t max_batch;
+    int64_t  last_commit_us;
+    int64_t  max_commit_us;
+} rfid_durability_t;
+
+// Inicialização (inicia a task de gravação, única dona da flash)
 esp_err_t rfid_storage_init(void);
 
-// Usuários
-esp_err_t rfid_add_user(const char *uid, const char *name);
-esp_err_t rfid_remove_user(const char *uid);
-int rfid_list_users(rfid_user_t **users);
+// Usuários: a tabela em RAM muda na hora; a gravação é assíncrona.
+// ticket (opcional) permite esperar a durabilidade com rfid_storage_wait.
+esp_err_t rfid_add_user(const char *uid, const char *name, rfid_ticket_t *ticket);
+esp_err_t rfid_remove_user(const char *uid, rfid_ticket_t *ticket);
+// Copia com o lock até max usuários a partir da posição start; devolve
+// quantos. *version (opcional) é rfid_users_version() no momento da cópia:
+// uma remoção move o último usuário para o buraco, então páginas de versões
+// diferentes não formam uma lista consistente.
+int rfid_copy_users(int start, rfid_user_t *out, int max, uint32_t *version);
+// Aplica a lista inteira de uma vez (tudo ou nada) e persiste com um único
+// snapshot. ESP_ERR_NO_MEM se o resultado passar de MAX_USERS; dry_run só
+// calcula o resultado. Sem mudança nenhuma, *ticket fica 0.
+esp_err_t rfid_import_users(const rfid_user_t *users, int count, rfid_import_mode_t mode, bool dry_run,
+                            rfid_import_result_t *result, rfid_ticket_t *ticket);
+bool rfid_is_user_authorized(const char *uid);   // O(1) via índice hash
+// Percorre a tabela com o lock dos usuários: fn curta, sem flash nem espera
+void rfid_for_each_user(void (*fn)(const rfid_user_t *user, void *arg), void *arg);
+uint32_t rfid_users_version(void);               // muda a cada inclusão/remoção
+
+// Logs (journal circular em flash; cada registro tem um número de sequência)
+esp_err_t rfid_add_log(const rfid_log_t *log, rfid_ticket_t *ticket);
+uint32_t rfid_log_first_seq(void);   // mais antigo ainda retido
+uint32_t rfid_log_next_seq(void);    // seq que o próximo registro receberá
+esp_err_t rfid_log_read(uint32_t seq, rfid_log_t *log);
+size_t rfid_log_format_uid(const rfid_log_t *log, char *buf, size_t len);   // mesma forma da tabela de usuários
+// "AAAA-MM-DD HH:MM:SS", agregados "...-HH:MM:SS"; hora desconhecida "boot N +Ns".
+// Registros anteriores à sincronização já chegam corrigidos de rfid_log_read.
+size_t rfid_log_format_time(const rfid_log_t *log, char *buf, size_t len);
 
-// Logs
-esp_err_t rfid_add_log(const char *uid, const char *timestamp);
-int rfid_get_logs(rfid_log_t **logs);
+// Durabilidade
+esp_err_t rfid_storage_wait(rfid_ticket_t ticket, uint32_t timeout_ms);  // ESP_ERR_TIMEOUT, ESP_FAIL
+bool rfid_storage_is_durable(rfid_ticket_t ticket);
+esp_err_t rfid_storage_flush(rfid_ticket_t *ticket);                     // grava já, sem esperar a janela
+esp_err_t rfid_storage_set_commit_window(uint32_t window_ms, uint32_t max_records);
+void rfid_storage_get_durability(rfid_durability_t *out);
 
 #endif // RFID_STORAGE_H
@@ -0,0 +1,319 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "rfid_storage.h"
+#include "swipe_bench.h"
+#include "time_service.h"
+#include "uid_index.h"
+#include "web_render.h"
+#include "web_writer.h"
+#include "wiegand_capture.h"
+#include "wiegand_format.h"
+
+// Relógio das amostras: ciclos da CPU na placa, ns no PC. Diferenças em
+// 32 bits: uma amostra tem de caber em 2^32 unidades (26 s a 160 MHz).
+#ifdef ESP_PLATFORM
+#include "esp_cpu.h"
+#include "sdkconfig.h"
+#define BENCH_UNIT          "ciclos"
+#define BENCH_SAMPLES       200
+#define BENCH_TO_NS(t)      ((t) * 1000.0 / CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ)
+
+static inline uint32_t bench_now(void) {
+    return (uint32_t)esp_cpu_get_cycle_count();
+}
+#else
+#include <time.h>
+#define BENCH_UNIT          "ns"
+#define BENCH_SAMPLES       1000
+#define BENCH_TO_NS(t)      (t)
+
+static inline uint32_t bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+}
+#endif
+
+#define BENCH_FRAMES        64      // quadros pré-codificados por formato
+#define BENCH_QUERIES       1024    // UIDs consultados em rodízio
+#define BENCH_LOG_BATCH     32
+#define BENCH_RENDER_LOGS   100
+#define BENCH_RENDER_USERS  50
+#define BENCH_WAIT_MS       5000
+
+typedef struct {
+    const char *name;
+    esp_err_t (*setup)(void *ctx);
+    void (*run)(void *ctx, uint32_t ops);
+    void (*teardown)(void *ctx);
+    void *ctx;
+    uint32_t ops;               // operações por amostra
+    uint16_t samples;           // 0 = BENCH_SAMPLES
+} bench_kernel_t;
+
+// O compilador não pode descartar o resultado dos kernels
+static volatile uint64_t bench_sink;
+
+static uint64_t frames26[BENCH_FRAMES];
+static uint64_t frames37[BENCH_FRAMES];
+
+// =====================
+// Wiegand
+// =====================
+static wg_capture_t capture;
+static int64_t capture_t;
+
+static esp_err_t wiegand_setup(void *ctx) {
+    const wg_format_t *f26 = wg_format_for_length(26);
+    const wg_format_t *f37 = wg_format_for_length(37);
+    for (uint32_t i = 0; i < BENCH_FRAMES; i++) {
+        frames26[i] = wg_encode(f26, 100 + (i & 7), 1000 + i * 37);
+        frames37[i] = wg_encode(f37, 2000 + (i & 7), 100000 + i * 911);
+    }
+    wg_capture_init(&capture, WG_FRAME_GAP_US);
+    capture_t = 0;
+    return ESP_OK;
+}
+
+// Fronts com as mesmas funções da ISR; o quadro anterior fecha pela pausa
+static void run_assemble(void *ctx, uint32_t ops) {
+    for (uint32_t i = 0; i < ops; i++) {
+        uint64_t bits = frames26[i & (BENCH_FRAMES - 1)];
+        for (int b = 25; b >= 0; b--) {
+            wg_capture_edge(&capture, (unsigned)(bits >> b) & 1u, capture_t);
+            capture_t += 2000;
+        }
+        capture_t += 50000;
+        wg_frame_t f;
+        while (wg_capture_pop(&capture, &f)) bench_sink += f.bits;
+    }
+}
+
+static void run_decode(void *ctx, uint32_t ops) {
+    uint8_t nbits = (uint8_t)(uintptr_t)ctx;
+    const uint64_t *frames = nbits == 26 ? frames26 : frames37;
+    for (uint32_t i = 0; i < ops; i++) {
+        wg_credential_t cred;
+        wg_decode(frames[i & (BENCH_FRAMES - 1)], nbits, &cred);
+        bench_sink += cred.card;
+    }
+}
+
+// =====================
+// Índice de UID
+// =====================
+typedef struct {
+    char uid[16];
+} bench_uid_t;
+
+typedef struct {
+    uint32_t n;
+    bench_uid_t *records;
+    uid_index_slot_t *slots;
+    bench_uid_t *queries;
+    uid_index_t index;
+} uid_bench_t;
+
+static esp_err_t uid_setup(void *ctx) {
+    uid_bench_t *u = ctx;
+    size_t n_slots = 1;
+    while (n_slots < 2 * (size_t)u->n) n_slots <<= 1;
+    u->records = calloc(u->n, sizeof(bench_uid_t));
+    u->slots = malloc(n_slots * sizeof(uid_index_slot_t));
+    u->queries = malloc(BENCH_QUERIES * sizeof(bench_uid_t));
+    if (!u->records || !u->slots || !u->queries) return ESP_ERR_NO_MEM;
+
+    uid_index_init(&u->index, u->slots, n_slots, u->records, sizeof(bench_uid_t));
+    for (uint32_t i = 0; i < u->n; i++) {
+        snprintf(u->records[i].uid, sizeof(u->records[i].uid), "100:%lu", (unsigned long)(1000 + i * 7));
+        uid_index_insert(&u->index, u->records[i].uid, (uint16_t)i);
+    }
+    // 7 de 8 consultas acertam, como numa porta com poucos cartões estranhos
+    uint32_t x = 12345;
+    for (uint32_t i = 0; i < BENCH_QUERIES; i++) {
+        x = x * 1103515245u + 12345u;
+        if (i % 8 == 7) {
+            snprintf(u->queries[i].uid, sizeof(u->queries[i].uid), "200:%lu", (unsigned long)(x >> 8));
+        } else {
+            memcpy(&u->queries[i], &u->records[(x >> 8) % u->n], sizeof(bench_uid_t));
+        }
+    }
+    return ESP_OK;
+}
+
+static void uid_teardown(void *ctx) {
+    uid_bench_t *u = ctx;
+    free(u->records);
+    free(u->slots);
+    free(u->queries);
+    u->records = NULL;
+    u->slots = NULL;
+    u->queries = NULL;
+}
+
+static void run_uid(void *ctx, uint32_t ops) {
+    uid_bench_t *u = ctx;
+    for (uint32_t i = 0; i < ops; i++) {
+        bench_sink += (uint64_t)uid_index_find(&u->index, u->queries[i & (BENCH_QUERIES - 1)].uid);
+    }
+}
+
+static uid_bench_t uid50 = { .n = 50 };
+static uid_bench_t uid1k = { .n = 1000 };
+static uid_bench_t uid10k = { .n = 10000 };
+
+// =====================
+// Log
+// =====================
+static rfid_log_t bench_log(uint32_t i) {
+    rfid_log_t log = {
+        .cred = frames26[i & (BENCH_FRAMES - 1)],
+        .time = (uint32_t)(esp_timer_get_time() / 1000000),
+        .count = 1,
+        .decision = RFID_LOG_DENIED,
+        .reader = 0,
+        .time_valid = 0,
+        .boot = time_service_boot_id(),
+    };
+    return log;
+}
+
+static esp_err_t log_drain(void) {
+    rfid_ticket_t t = 0;
+    esp_err_t err = rfid_storage_flush(&t);
+    return err == ESP_OK ? rfid_storage_wait(t, BENCH_WAIT_MS) : err;
+}
+
+static esp_err_t log_setup(void *ctx) {
+    return log_drain();
+}
+
+static void log_teardown(void *ctx) {
+    log_drain();
+}
+
+static void run_log_enqueue(void *ctx, uint32_t ops) {
+    for (uint32_t i = 0; i < ops; i++) {
+        rfid_log_t log = bench_log(i);
+        rfid_add_log(&log, NULL);
+    }
+}
+
+static void run_log_commit(void *ctx, uint32_t ops) {
+    for (uint32_t i = 0; i < ops; i++) {
+        for (uint32_t j = 0; j < BENCH_LOG_BATCH; j++) {
+            rfid_log_t log = bench_log(j);
+            rfid_add_log(&log, NULL);
+        }
+        log_drain();
+    }
+}
+
+// =====================
+// Renderização JSON
+// =====================
+static rfid_user_t *render_users;
+
+static esp_err_t null_sink(void *ctx, const char *data, size_t len) {
+    bench_sink += len;
+    return ESP_OK;
+}
+
+static esp_err_t users_setup(void *ctx) {
+    render_users = calloc(BENCH_RENDER_USERS, sizeof(rfid_user_t));
+    if (!render_users) return ESP_ERR_NO_MEM;
+    for (int i = 0; i < BENCH_RENDER_USERS; i++) {
+        snprintf(render_users[i].uid, MAX_UID_LEN, "100:%d", 1000 + i);
+        // Aspas e acentos: passa pelo escape de web_writer_json_str
+        snprintf(render_users[i].name, MAX_NAME_LEN, i % 5 ? "Usuário %d" : "\"Visitante\" %d", i);
+    }
+    return ESP_OK;
+}
+
+static void users_teardown(void *ctx) {
+    free(render_users);
+    render_users = NULL;
+}
+
+static void run_render_users(void *ctx, uint32_t ops) {
+    for (uint32_t i = 0; i < ops; i++) {
+        web_writer_t w;
+        if (web_writer_begin_sink(&w, null_sink, NULL) != ESP_OK) return;
+        web_render_users(&w, render_users, BENCH_RENDER_USERS);
+        web_writer_end(&w);
+    }
+}
+
+static void run_render_logs(void *ctx, uint32_t ops) {
+    for (uint32_t i = 0; i < ops; i++) {
+        uint32_t first = rfid_log_first_seq();
+        uint32_t end = rfid_log_next_seq();
+        uint32_t seq = end - first > BENCH_RENDER_LOGS ? end - BENCH_RENDER_LOGS : first;
+        web_writer_t w;
+        if (web_writer_begin_sink(&w, null_sink, NULL) != ESP_OK) return;
+        web_render_logs(&w, first, seq, end, end);
+        web_writer_end(&w);
+    }
+}
+
+// =====================
+// Execução
+// =====================
+static const bench_kernel_t kernels[] = {
+    { "wg_montagem_26", wiegand_setup, run_assemble, NULL, NULL, 16, 0 },
+    { "wg_decode_26", NULL, run_decode, NULL, (void *)26, 64, 0 },
+    { "wg_decode_37", NULL, run_decode, NULL, (void *)37, 64, 0 },
+    { "uid_busca_50", uid_setup, run_uid, uid_teardown, &uid50, 64, 0 },
+    { "uid_busca_1k", uid_setup, run_uid, uid_teardown, &uid1k, 64, 0 },
+    { "uid_busca_10k", uid_setup, run_uid, uid_teardown, &uid10k, 64, 0 },
+    { "log_enfileirar", log_setup, run_log_enqueue, log_teardown, NULL, 8, 0 },
+    { "log_commit_32", log_setup, run_log_commit, log_teardown, NULL, 1, 50 },
+    { "json_logs_100", NULL, run_render_logs, NULL, NULL, 1, 0 },
+    { "json_users_50", users_setup, run_render_users, users_teardown, NULL, 1, 0 },
+};
+
+static int cmp_float(const void *a, const void *b) {
+    float x = *(const float *)a, y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+esp_err_t swipe_bench_run(void) {
+    float *samples = malloc(BENCH_SAMPLES * sizeof(float));
+    if (!samples) return ESP_ERR_NO_MEM;
+
+    printf("\n== swipe_bench: tempo por operacao em %s ==\n", BENCH_UNIT);
+    printf("%-16s %8s %6s %10s %10s %10s %12s\n", "kernel", "amostras", "ops", "mediana", "p99", "min",
+           "mediana ns");
+
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        const bench_kernel_t *kn = &kernels[k];
+        esp_err_t err = kn->setup ? kn->setup(kn->ctx) : ESP_OK;
+        if (err != ESP_OK) {
+            printf("%-16s %s\n", kn->name, esp_err_to_name(err));
+            if (kn->teardown) kn->teardown(kn->ctx);
+            continue;
+        }
+
+        int n = kn->samples ? kn->samples : BENCH_SAMPLES;
+        kn->run(kn->ctx, kn->ops);      // aquecimento (cache, primeiro acesso à flash)
+        for (int s = 0; s < n; s++) {
+            uint32_t t0 = bench_now();
+            kn->run(kn->ctx, kn->ops);
+            samples[s] = (float)(uint32_t)(bench_now() - t0) / (float)kn->ops;
+        }
+        if (kn->teardown) kn->teardown(kn->ctx);
+
+        qsort(samples, n, sizeof(float), cmp_float);
+        float median = samples[n / 2];
+        printf("%-16s %8d %6lu %10.1f %10.1f %10.1f %12.1f\n", kn->name, n, (unsigned long)kn->ops, median,
+               samples[(n * 99) / 100], samples[0], BENCH_TO_NS(median));
+    }
+    free(samples);
+    return ESP_OK;
+}
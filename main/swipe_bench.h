@@ -0,0 +1,30 @@
+#pragma once
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Microbenchmarks do caminho de uma passagem de cartão.
+//
+// Os mesmos kernels rodam no PC (host/bench_swipe.c, tempo em ns) e na
+// placa (CONFIG_RFID_BENCH, ciclos de esp_cpu_get_cycle_count()), com a
+// mesma tabela: mediana, p99 e mínimo por operação.
+//
+//   wg_montagem_26   26 fronts na captura Wiegand + retirada do quadro
+//   wg_decode_26/37  decodificação e paridade
+//   uid_busca_N      índice de UID com 50, 1k e 10k usuários (7/8 acertos)
+//   log_enfileirar   rfid_add_log (o que a passagem paga)
+//   log_commit_32    32 registros + flush + espera da gravação na flash
+//   json_logs_100    /api/logs com 100 registros do journal
+//   json_users_50    /api/users com 50 usuários
+//
+// Os kernels de log gravam registros de teste no journal de acessos:
+// o modo de bancada é para placa de desenvolvimento, não instalada.
+// Depois de rfid_storage_init.
+
+esp_err_t swipe_bench_run(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,171 @@
+#include <string.h>
+#include <sys/time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "nvs_storage.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "time_service.h"
+
+static const char *TAG = "TIME";
+
+#define KEY_BOOT        "boot"
+#define KEY_DRIFT       "drift"
+#define KEY_OFFSETS     "offsets"
+
+#define DRIFT_SAVE_STEP_PPB  1000   // só regrava o NVS quando a estimativa muda 1 ppm
+
+typedef struct {
+    uint16_t boot_id;               // 0 = livre
+    uint16_t reserved;
+    uint32_t offset_s;
+} boot_offset_t;
+
+static SemaphoreHandle_t lock = NULL;
+static uint16_t boot_id = 0;
+static int32_t drift_ppb = 0;
+static int32_t drift_saved_ppb = 0;
+static boot_offset_t offsets[TIME_BOOT_OFFSETS];
+
+// Última sincronização (referência da conversão) e primeira (âncora da deriva)
+static bool synced = false;
+static int64_t sync_mono_us, sync_wall_us;
+static int64_t anchor_mono_us, anchor_wall_us;
+static uint32_t boot_offset_saved = 0;
+
+// Monotônico -> µs Unix a partir da última sincronização (com lock)
+static int64_t mono_to_wall_us(int64_t t_us) {
+    int64_t dt = t_us - sync_mono_us;
+    return sync_wall_us + dt + dt * drift_ppb / 1000000000LL;
+}
+
+static void save_state(bool save_offsets) {
+    nvs_handle_t handle = nvs_storage_handle();
+    nvs_set_i32(handle, KEY_DRIFT, drift_ppb);
+    if (save_offsets) {
+        nvs_set_blob(handle, KEY_OFFSETS, offsets, sizeof(offsets));
+    }
+    nvs_storage_commit();
+}
+
+// Deriva = quanto o cristal adianta/atrasa contra o coordenador desde a âncora
+static void update_drift(int64_t t_us, int64_t wall_us) {
+    int64_t mono_span = t_us - anchor_mono_us;
+    if (mono_span < (int64_t)TIME_DRIFT_MIN_SPAN_S * 1000000LL) return;
+
+    int64_t error_us = (wall_us - anchor_wall_us) - mono_span;
+    int64_t ppb = error_us * 1000000000LL / mono_span;
+    if (ppb > TIME_DRIFT_MAX_PPB || ppb < -TIME_DRIFT_MAX_PPB) {
+        // Coordenador mudou de hora: recomeça a estimativa daqui
+        ESP_LOGW(TAG, "Salto de %lld ms na hora do coordenador", (long long)(error_us / 1000));
+        anchor_mono_us = t_us;
+        anchor_wall_us = wall_us;
+        return;
+    }
+    drift_ppb = (int32_t)ppb;
+}
+
+esp_err_t time_service_init(void) {
+    if (lock) return ESP_OK;
+    lock = xSemaphoreCreateMutex();
+    if (!lock) return ESP_ERR_NO_MEM;
+
+    // Chaves no namespace único (nvs_storage.h), já aberto por rfid_storage_init
+    nvs_handle_t handle = nvs_storage_handle();
+    uint16_t last_boot = 0;
+    nvs_get_u16(handle, KEY_BOOT, &last_boot);
+    boot_id = last_boot + 1;
+    if (boot_id == 0) boot_id = 1;
+
+    nvs_get_i32(handle, KEY_DRIFT, &drift_ppb);
+    drift_saved_ppb = drift_ppb;
+
+    size_t size = sizeof(offsets);
+    if (nvs_get_blob(handle, KEY_OFFSETS, offsets, &size) != ESP_OK || size != sizeof(offsets)) {
+        memset(offsets, 0, sizeof(offsets));
+    }
+
+    esp_err_t err = nvs_set_u16(handle, KEY_BOOT, boot_id);
+    if (err == ESP_OK) err = nvs_storage_commit();
+
+    ESP_LOGI(TAG, "Boot #%u, deriva %ld ppb", boot_id, (long)drift_ppb);
+    return err;
+}
+
+uint16_t time_service_boot_id(void) {
+    return boot_id;
+}
+
+bool time_service_synced(void) {
+    return synced;
+}
+
+void time_service_sync(uint32_t unix_s, int64_t t_us) {
+    if (!lock) return;
+
+    // Centro do segundo: o ZCL trunca
+    int64_t wall_us = (int64_t)unix_s * 1000000LL + 500000;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    int64_t step_us = synced ? wall_us - mono_to_wall_us(t_us) : 0;
+    if (!synced) {
+        anchor_mono_us = t_us;
+        anchor_wall_us = wall_us;
+    } else {
+        update_drift(t_us, wall_us);
+    }
+    synced = true;
+    sync_mono_us = t_us;
+    sync_wall_us = wall_us;
+
+    uint32_t offset_s = (uint32_t)(mono_to_wall_us(0) / 1000000LL);
+    bool save_offsets = false;
+    int32_t offset_change = (int32_t)(offset_s - boot_offset_saved);
+    if (boot_offset_saved == 0 || offset_change > 1 || offset_change < -1) {
+        boot_offset_t *slot = &offsets[boot_id % TIME_BOOT_OFFSETS];
+        slot->boot_id = boot_id;
+        slot->offset_s = offset_s;
+        boot_offset_saved = offset_s;
+        save_offsets = true;
+    }
+    bool save_drift = drift_ppb - drift_saved_ppb > DRIFT_SAVE_STEP_PPB ||
+                      drift_saved_ppb - drift_ppb > DRIFT_SAVE_STEP_PPB;
+    if (save_drift) drift_saved_ppb = drift_ppb;
+    xSemaphoreGive(lock);
+
+    // Relógio do sistema para quem usa time(): só aqui, nunca no caminho do cartão
+    struct timeval tv = { .tv_sec = unix_s, .tv_usec = 0 };
+    settimeofday(&tv, NULL);
+
+    if (save_offsets || save_drift) {
+        save_state(save_offsets);
+    }
+    ESP_LOGI(TAG, "Hora sincronizada: %lu (passo %lld ms, deriva %ld ppb)", (unsigned long)unix_s,
+             (long long)(step_us / 1000), (long)drift_ppb);
+}
+
+bool time_service_to_unix(int64_t t_us, uint32_t *unix_s) {
+    if (!synced) return false;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    int64_t wall_us = mono_to_wall_us(t_us);
+    xSemaphoreGive(lock);
+    *unix_s = (uint32_t)(wall_us / 1000000LL);
+    return true;
+}
+
+bool time_service_boot_offset(uint16_t id, uint32_t *offset_s) {
+    if (!lock || id == 0) return false;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    const boot_offset_t *slot = &offsets[id % TIME_BOOT_OFFSETS];
+    bool ok = slot->boot_id == id;
+    if (ok) *offset_s = slot->offset_s;
+    xSemaphoreGive(lock);
+    return ok;
+}
+
+int32_t time_service_drift_ppb(void) {
+    return drift_ppb;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Relógio de parede do dispositivo.
+//
+// O caminho do cartão só guarda inteiros: o esp_timer_get_time() capturado
+// no fim do quadro. A hora de parede é esse monotônico mais um offset,
+// obtido do cluster Time (0x000A) do coordenador Zigbee, com correção pela
+// deriva do cristal estimada entre sincronizações (guardada no NVS).
+//
+// Antes da primeira sincronização os eventos ficam em "segundos desde o
+// boot" com o número do boot; o offset de cada boot é guardado quando o
+// relógio fica conhecido, e a conversão para hora de parede acontece na
+// leitura (time_service_boot_offset), também para boots anteriores.
+
+#define TIME_SYNC_PERIOD_MS      (60 * 60 * 1000)   // releitura do cluster Time
+#define TIME_SYNC_RETRY_MS       (30 * 1000)        // sem resposta ou coordenador sem hora
+#define TIME_DRIFT_MIN_SPAN_S    (6 * 3600)         // ZCL tem resolução de 1 s: só estima em janelas longas
+#define TIME_DRIFT_MAX_PPB       200000             // ±200 ppm; acima disso é salto de relógio, não deriva
+#define TIME_BOOT_OFFSETS        8                  // boots anteriores com offset conhecido
+
+#define TIME_ZCL_EPOCH_OFFSET    946684800u         // 2000-01-01 00:00 UTC em época Unix
+
+esp_err_t time_service_init(void);
+
+// Número desta inicialização (incrementa a cada boot, nunca 0)
+uint16_t time_service_boot_id(void);
+
+bool time_service_synced(void);
+
+// Hora recebida: unix_s lido do coordenador, t_us o monotônico na recepção
+void time_service_sync(uint32_t unix_s, int64_t t_us);
+
+// Monotônico deste boot -> época Unix. false antes da primeira sincronização.
+bool time_service_to_unix(int64_t t_us, uint32_t *unix_s);
+
+// Offset de um boot: unix = offset + segundos desde aquele boot
+bool time_service_boot_offset(uint16_t boot_id, uint32_t *offset_s);
+
+int32_t time_service_drift_ppb(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,110 @@
+#include "uid_index.h"
+#include <string.h>
+
+#define KEY_AT(ix, pos) ((ix)->keys + (size_t)(pos) * (ix)->stride)
+
+uint32_t uid_hash(const char *uid)
+{
+    // FNV-1a 32 bits
+    uint32_t h = 2166136261u;
+    while (*uid) {
+        h ^= (uint8_t)*uid++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void uid_index_init(uid_index_t *ix, uid_index_slot_t *slots, size_t n_slots,
+                    const void *records, size_t stride)
+{
+    ix->slots = slots;
+    ix->mask = n_slots - 1;
+    ix->keys = (const char *)records;
+    ix->stride = stride;
+    uid_index_clear(ix);
+}
+
+void uid_index_clear(uid_index_t *ix)
+{
+    for (size_t i = 0; i <= ix->mask; i++) {
+        ix->slots[i].pos = UID_INDEX_EMPTY;
+        ix->slots[i].tag = 0;
+    }
+}
+
+// Procura o slot que contém o UID; -1 se não existe
+static long find_slot(const uid_index_t *ix, const char *uid, uint32_t h)
+{
+    uint16_t tag = (uint16_t)(h >> 16);
+    size_t i = h & ix->mask;
+
+    while (ix->slots[i].pos != UID_INDEX_EMPTY) {
+        if (ix->slots[i].tag == tag && strcmp(KEY_AT(ix, ix->slots[i].pos), uid) == 0) {
+            return (long)i;
+        }
+        i = (i + 1) & ix->mask;
+    }
+    return -1;
+}
+
+int uid_index_find(const uid_index_t *ix, const char *uid)
+{
+    long s = find_slot(ix, uid, uid_hash(uid));
+    return s < 0 ? -1 : ix->slots[s].pos;
+}
+
+bool uid_index_insert(uid_index_t *ix, const char *uid, uint16_t pos)
+{
+    uint32_t h = uid_hash(uid);
+    size_t i = h & ix->mask;
+
+    for (size_t n = 0; n <= ix->mask; n++) {
+        if (ix->slots[i].pos == UID_INDEX_EMPTY) {
+            ix->slots[i].pos = pos;
+            ix->slots[i].tag = (uint16_t)(h >> 16);
+            return true;
+        }
+        i = (i + 1) & ix->mask;
+    }
+    return false; // tabela cheia
+}
+
+int uid_index_remove(uid_index_t *ix, const char *uid)
+{
+    long s = find_slot(ix, uid, uid_hash(uid));
+    if (s < 0) return -1;
+
+    int removed = ix->slots[s].pos;
+    size_t hole = (size_t)s;
+    size_t i = hole;
+
+    // Backward shift: puxa para o buraco as entradas cujo slot "natural"
+    // não fica entre o buraco e a posição atual
+    for (;;) {
+        i = (i + 1) & ix->mask;
+        if (ix->slots[i].pos == UID_INDEX_EMPTY) break;
+
+        size_t home = uid_hash(KEY_AT(ix, ix->slots[i].pos)) & ix->mask;
+        if (((i - home) & ix->mask) >= ((i - hole) & ix->mask)) {
+            ix->slots[hole] = ix->slots[i];
+            hole = i;
+        }
+    }
+    ix->slots[hole].pos = UID_INDEX_EMPTY;
+    ix->slots[hole].tag = 0;
+    return removed;
+}
+
+void uid_index_move(uid_index_t *ix, const char *uid, uint16_t from, uint16_t to)
+{
+    uint32_t h = uid_hash(uid);
+    size_t i = h & ix->mask;
+
+    while (ix->slots[i].pos != UID_INDEX_EMPTY) {
+        if (ix->slots[i].pos == from) {
+            ix->slots[i].pos = to;
+            return;
+        }
+        i = (i + 1) & ix->mask;
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef UID_INDEX_H
+#define UID_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Índice hash (endereçamento aberto, sondagem linear) sobre um array de
+// registros cujo primeiro campo é o UID em texto. O índice não copia as
+// chaves: guarda apenas a posição no array e 16 bits do hash para evitar
+// strcmp em colisões. Remoção por "backward shift", sem lápides, então o
+// custo de busca não degrada com o uso.
+
+#define UID_INDEX_EMPTY  0xFFFFu
+
+typedef struct {
+    uint16_t pos;   // posição no array de registros (UID_INDEX_EMPTY = livre)
+    uint16_t tag;   // 16 bits altos do hash
+} uid_index_slot_t;
+
+typedef struct {
+    uid_index_slot_t *slots;
+    size_t mask;          // n_slots - 1 (n_slots é potência de 2)
+    const char *keys;     // base do array de registros
+    size_t stride;        // sizeof(registro)
+} uid_index_t;
+
+// Menor potência de 2 com fator de carga <= 0.5 para n registros (n <= 1024),
+// constante de compilação para dimensionar arenas
+#define UID_INDEX_SLOTS_FOR(n) \
+    ((2 * (n)) <= 64 ? 64 : (2 * (n)) <= 128 ? 128 : (2 * (n)) <= 256 ? 256 : \
+     (2 * (n)) <= 512 ? 512 : (2 * (n)) <= 1024 ? 1024 : 2048)
+
+// n_slots deve ser potência de 2 e ao menos 2x o número máximo de registros
+void uid_index_init(uid_index_t *ix, uid_index_slot_t *slots, size_t n_slots,
+                    const void *records, size_t stride);
+void uid_index_clear(uid_index_t *ix);
+
+uint32_t uid_hash(const char *uid);
+
+// Retorna a posição do registro ou -1
+int  uid_index_find(const uid_index_t *ix, const char *uid);
+// Não verifica duplicados: chame uid_index_find antes
+bool uid_index_insert(uid_index_t *ix, const char *uid, uint16_t pos);
+// Retorna a posição removida ou -1
+int  uid_index_remove(uid_index_t *ix, const char *uid);
+// Atualiza a posição de um registro movido no array (ex.: swap com o último)
+void uid_index_move(uid_index_t *ix, const char *uid, uint16_t from, uint16_t to);
+
+#endif // UID_INDEX_H
@@ -0,0 +1,218 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "user_import.h"
+
+enum {
+    BIN_MAGIC = 0,
+    BIN_UID_LEN,
+    BIN_UID,
+    BIN_NAME_LEN,
+    BIN_NAME,
+};
+
+static bool fail(user_import_t *imp, user_import_error_t err) {
+    imp->err = err;
+    return false;
+}
+
+// UID na forma da tabela: "FC:numero" ou hex
+static bool valid_uid(const char *uid) {
+    size_t n = strlen(uid);
+    if (n == 0 || n >= MAX_UID_LEN) return false;
+    for (; *uid; uid++) {
+        if (!isalnum((unsigned char)*uid) && *uid != ':') return false;
+    }
+    return true;
+}
+
+static bool valid_name(const char *name) {
+    size_t n = strlen(name);
+    if (n == 0 || n >= MAX_NAME_LEN) return false;
+    for (; *name; name++) {
+        if ((unsigned char)*name < 0x20 || *name == 0x7F) return false;
+    }
+    return true;
+}
+
+static bool add_user(user_import_t *imp, const char *uid, const char *name) {
+    if (!valid_uid(uid)) return fail(imp, USER_IMPORT_ERR_BAD_UID);
+    if (!valid_name(name)) return fail(imp, USER_IMPORT_ERR_BAD_NAME);
+    if (uid_index_find(&imp->index, uid) >= 0) return fail(imp, USER_IMPORT_ERR_DUPLICATE);
+    if (imp->count >= imp->cap) return fail(imp, USER_IMPORT_ERR_TOO_MANY);
+
+    rfid_user_t *u = &imp->users[imp->count];
+    memset(u, 0, sizeof(*u));
+    strncpy(u->uid, uid, sizeof(u->uid) - 1);
+    strncpy(u->name, name, sizeof(u->name) - 1);
+    uid_index_insert(&imp->index, u->uid, (uint16_t)imp->count);
+    imp->count++;
+    return true;
+}
+
+static char *trim(char *s) {
+    while (*s == ' ' || *s == '\t') s++;
+    char *end = s + strlen(s);
+    while (end > s && (end[-1] == ' ' || end[-1] == '\t')) end--;
+    *end = '\0';
+    return s;
+}
+
+// Campo entre aspas, no lugar: "a ""b""" -> a "b"
+static bool unquote(char *s) {
+    size_t n = strlen(s);
+    if (n < 2 || s[n - 1] != '"') return false;
+    char *out = s;
+    for (char *in = s + 1; in < s + n - 1; in++) {
+        if (*in == '"') {
+            if (in[1] != '"' || in + 1 >= s + n - 1) return false;
+            in++;
+        }
+        *out++ = *in;
+    }
+    *out = '\0';
+    return true;
+}
+
+static bool csv_line(user_import_t *imp) {
+    char *line = imp->line;
+    if (imp->line_len > 0 && line[imp->line_len - 1] == '\r') imp->line_len--;
+    line[imp->line_len] = '\0';
+    imp->line_len = 0;
+
+    if (imp->line_overflow) {
+        imp->line_overflow = false;
+        return fail(imp, USER_IMPORT_ERR_LINE_TOO_LONG);
+    }
+
+    line = trim(line);
+    if (*line == '\0' || *line == '#') return true;
+
+    char *comma = strchr(line, ',');
+    if (!comma) return fail(imp, USER_IMPORT_ERR_SYNTAX);
+    *comma = '\0';
+    char *uid = trim(line);
+    char *name = trim(comma + 1);
+
+    if (imp->record == 1 && strcasecmp(uid, "uid") == 0 && strcasecmp(name, "name") == 0) {
+        return true;    // cabeçalho
+    }
+    if (*name == '"') {
+        if (!unquote(name)) return fail(imp, USER_IMPORT_ERR_SYNTAX);
+    } else if (strchr(name, ',') || strchr(name, '"')) {
+        return fail(imp, USER_IMPORT_ERR_SYNTAX);
+    }
+    return add_user(imp, uid, name);
+}
+
+static bool csv_feed(user_import_t *imp, const char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+        if (c == '\n') {
+            if (!csv_line(imp)) return false;
+            imp->record++;
+        } else if (imp->line_len < USER_IMPORT_LINE_MAX) {
+            imp->line[imp->line_len++] = c;
+        } else {
+            imp->line_overflow = true;
+        }
+    }
+    return true;
+}
+
+static bool bin_feed(user_import_t *imp, const char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = (uint8_t)data[i];
+        switch (imp->bin_state) {
+        case BIN_MAGIC:
+            if (c != (uint8_t)USER_IMPORT_BIN_MAGIC[imp->bin_got]) return fail(imp, USER_IMPORT_ERR_BAD_MAGIC);
+            if (++imp->bin_got == 4) imp->bin_state = BIN_UID_LEN;
+            break;
+        case BIN_UID_LEN:
+            if (c == 0 || c >= MAX_UID_LEN) return fail(imp, USER_IMPORT_ERR_BAD_UID);
+            memset(&imp->cur, 0, sizeof(imp->cur));
+            imp->bin_need = c;
+            imp->bin_got = 0;
+            imp->bin_state = BIN_UID;
+            break;
+        case BIN_UID:
+            imp->cur.uid[imp->bin_got++] = (char)c;
+            if (imp->bin_got == imp->bin_need) imp->bin_state = BIN_NAME_LEN;
+            break;
+        case BIN_NAME_LEN:
+            if (c == 0 || c >= MAX_NAME_LEN) return fail(imp, USER_IMPORT_ERR_BAD_NAME);
+            imp->bin_need = c;
+            imp->bin_got = 0;
+            imp->bin_state = BIN_NAME;
+            break;
+        case BIN_NAME:
+            imp->cur.name[imp->bin_got++] = (char)c;
+            if (imp->bin_got == imp->bin_need) {
+                if (!add_user(imp, imp->cur.uid, imp->cur.name)) return false;
+                imp->record++;
+                imp->bin_state = BIN_UID_LEN;
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+bool user_import_begin(user_import_t *imp, user_import_format_t fmt, int cap) {
+    memset(imp, 0, sizeof(*imp));
+    imp->fmt = fmt;
+    imp->cap = cap;
+    imp->record = 1;
+
+    size_t n_slots = 1;
+    while (n_slots < 2 * (size_t)cap) n_slots <<= 1;
+    imp->users = calloc(cap, sizeof(rfid_user_t));
+    imp->slots = calloc(n_slots, sizeof(uid_index_slot_t));
+    if (!imp->users || !imp->slots) {
+        user_import_end(imp);
+        imp->err = USER_IMPORT_ERR_NO_MEM;
+        return false;
+    }
+    uid_index_init(&imp->index, imp->slots, n_slots, imp->users, sizeof(rfid_user_t));
+    return true;
+}
+
+bool user_import_feed(user_import_t *imp, const char *data, size_t len) {
+    if (imp->err != USER_IMPORT_OK) return false;
+    return imp->fmt == USER_IMPORT_CSV ? csv_feed(imp, data, len) : bin_feed(imp, data, len);
+}
+
+bool user_import_finish(user_import_t *imp) {
+    if (imp->err != USER_IMPORT_OK) return false;
+    if (imp->fmt == USER_IMPORT_CSV) {
+        // Última linha sem '\n'
+        return (imp->line_len == 0 && !imp->line_overflow) || csv_line(imp);
+    }
+    if (imp->bin_state == BIN_MAGIC && imp->bin_got == 0) return true;    // corpo vazio
+    return imp->bin_state == BIN_UID_LEN || fail(imp, USER_IMPORT_ERR_TRUNCATED);
+}
+
+void user_import_end(user_import_t *imp) {
+    free(imp->users);
+    free(imp->slots);
+    imp->users = NULL;
+    imp->slots = NULL;
+}
+
+const char *user_import_strerror(user_import_error_t err) {
+    switch (err) {
+    case USER_IMPORT_OK:                return "ok";
+    case USER_IMPORT_ERR_NO_MEM:        return "sem memoria";
+    case USER_IMPORT_ERR_LINE_TOO_LONG: return "linha longa demais";
+    case USER_IMPORT_ERR_SYNTAX:        return "esperado uid,name";
+    case USER_IMPORT_ERR_BAD_UID:       return "UID invalido";
+    case USER_IMPORT_ERR_BAD_NAME:      return "nome invalido";
+    case USER_IMPORT_ERR_DUPLICATE:     return "UID repetido na lista";
+    case USER_IMPORT_ERR_TOO_MANY:      return "usuarios demais";
+    case USER_IMPORT_ERR_BAD_MAGIC:     return "formato binario desconhecido";
+    case USER_IMPORT_ERR_TRUNCATED:     return "registro incompleto no fim";
+    default:                            return "?";
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef USER_IMPORT_H
+#define USER_IMPORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "rfid_storage.h"
+#include "uid_index.h"
+
+// Leitura incremental de uma lista de usuários (importação em lote).
+//
+// O corpo da requisição chega em pedaços de qualquer tamanho; o parser
+// guarda só a linha (ou registro) em andamento, valida cada usuário e o
+// acumula numa lista de no máximo "cap" entradas. Nada é aplicado aqui:
+// a lista completa vai para rfid_import_users de uma vez.
+//
+// CSV: "uid,name" por linha; cabeçalho "uid,name", linhas vazias e "#..."
+//      são ignorados; name pode vir entre aspas ("" = aspas literais).
+// Binário: "RFU1" seguido de registros [u8 len][uid][u8 len][name].
+// Não depende do ESP-IDF.
+
+#define USER_IMPORT_BIN_MAGIC  "RFU1"
+#define USER_IMPORT_LINE_MAX   (MAX_UID_LEN + 2 * MAX_NAME_LEN + 8)   // name com aspas escapadas
+
+typedef enum {
+    USER_IMPORT_CSV = 0,
+    USER_IMPORT_BIN,
+} user_import_format_t;
+
+typedef enum {
+    USER_IMPORT_OK = 0,
+    USER_IMPORT_ERR_NO_MEM,
+    USER_IMPORT_ERR_LINE_TOO_LONG,
+    USER_IMPORT_ERR_SYNTAX,         // campos faltando/sobrando, aspas
+    USER_IMPORT_ERR_BAD_UID,
+    USER_IMPORT_ERR_BAD_NAME,
+    USER_IMPORT_ERR_DUPLICATE,      // mesmo UID duas vezes na lista
+    USER_IMPORT_ERR_TOO_MANY,       // mais que cap
+    USER_IMPORT_ERR_BAD_MAGIC,
+    USER_IMPORT_ERR_TRUNCATED,      // terminou no meio de um registro binário
+} user_import_error_t;
+
+typedef struct {
+    user_import_format_t fmt;
+    rfid_user_t *users;
+    int count;
+    int cap;
+    uid_index_t index;              // duplicados dentro da lista
+    uid_index_slot_t *slots;
+
+    user_import_error_t err;
+    uint32_t record;                // linha (CSV) ou registro (binário) atual, a partir de 1
+
+    // CSV: linha em andamento
+    char line[USER_IMPORT_LINE_MAX + 1];
+    size_t line_len;
+    bool line_overflow;
+
+    // Binário: campo em andamento
+    uint8_t bin_state;
+    uint8_t bin_need;
+    uint8_t bin_got;
+    rfid_user_t cur;
+} user_import_t;
+
+// Aloca a lista (cap usuários) e o índice; false sem memória
+bool user_import_begin(user_import_t *imp, user_import_format_t fmt, int cap);
+// false no primeiro erro (imp->err / imp->record dizem qual e onde)
+bool user_import_feed(user_import_t *imp, const char *data, size_t len);
+// Fecha a última linha/registro
+bool user_import_finish(user_import_t *imp);
+void user_import_end(user_import_t *imp);
+
+const char *user_import_strerror(user_import_error_t err);
+
+#endif // USER_IMPORT_H
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+
+#include "web_assets.h"
+
+static const char *TAG = "WEB_ASSETS";
+
+// Gerados pelo target_add_binary_data em main/CMakeLists.txt
+extern const uint8_t index_html_gz_start[] asm("_binary_index_html_gz_start");
+extern const uint8_t index_html_gz_end[]   asm("_binary_index_html_gz_end");
+extern const uint8_t config_html_gz_start[] asm("_binary_config_html_gz_start");
+extern const uint8_t config_html_gz_end[]   asm("_binary_config_html_gz_end");
+extern const uint8_t logs_html_gz_start[]  asm("_binary_logs_html_gz_start");
+extern const uint8_t logs_html_gz_end[]    asm("_binary_logs_html_gz_end");
+extern const uint8_t users_html_gz_start[] asm("_binary_users_html_gz_start");
+extern const uint8_t users_html_gz_end[]   asm("_binary_users_html_gz_end");
+extern const uint8_t live_html_gz_start[]  asm("_binary_live_html_gz_start");
+extern const uint8_t live_html_gz_end[]    asm("_binary_live_html_gz_end");
+
+#define GZIP_MTIME_OFS  4       // bytes 4-7 do cabeçalho gzip: hora da compressão
+#define GZIP_MTIME_LEN  4
+#define ETAG_LEN        20      // "\"xxxxxxxx-xxxxx\"" + NUL
+
+typedef struct {
+    const uint8_t *start;
+    const uint8_t *end;
+    const char *type;
+    char etag[ETAG_LEN];        // vazio até o primeiro registro
+} web_asset_t;
+
+static web_asset_t assets[WEB_ASSET_COUNT] = {
+    [WEB_ASSET_INDEX]  = { index_html_gz_start,  index_html_gz_end,  "text/html" },
+    [WEB_ASSET_CONFIG] = { config_html_gz_start, config_html_gz_end, "text/html" },
+    [WEB_ASSET_LOGS]   = { logs_html_gz_start,   logs_html_gz_end,   "text/html" },
+    [WEB_ASSET_USERS]  = { users_html_gz_start,  users_html_gz_end,  "text/html" },
+    [WEB_ASSET_LIVE]   = { live_html_gz_start,   live_html_gz_end,   "text/html" },
+};
+
+// CRC do gzip sem o MTIME: o mesmo HTML recompilado mantém o ETag
+static void compute_etag(web_asset_t *a) {
+    size_t len = a->end - a->start;
+    uint32_t crc = esp_rom_crc32_le(0, a->start, GZIP_MTIME_OFS);
+    crc = esp_rom_crc32_le(crc, a->start + GZIP_MTIME_OFS + GZIP_MTIME_LEN,
+                           len - GZIP_MTIME_OFS - GZIP_MTIME_LEN);
+    snprintf(a->etag, sizeof(a->etag), "\"%08lx-%x\"", (unsigned long)crc, (unsigned)(len & 0xFFFFF));
+}
+
+static esp_err_t asset_handler(httpd_req_t *req) {
+    const web_asset_t *a = req->user_ctx;
+
+    httpd_resp_set_hdr(req, "ETag", a->etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    // If-None-Match pode trazer uma lista de ETags
+    char inm[64];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", inm, sizeof(inm)) == ESP_OK &&
+        strstr(inm, a->etag) != NULL) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    httpd_resp_set_type(req, a->type);
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, (const char *)a->start, a->end - a->start);
+}
+
+esp_err_t web_assets_register(httpd_handle_t server, const char *uri, web_asset_id_t asset) {
+    if (asset >= WEB_ASSET_COUNT) return ESP_ERR_INVALID_ARG;
+
+    web_asset_t *a = &assets[asset];
+    if (a->etag[0] == '\0') {
+        compute_etag(a);
+        ESP_LOGD(TAG, "%s: %u bytes, ETag %s", uri, (unsigned)(a->end - a->start), a->etag);
+    }
+
+    httpd_uri_t u = {
+        .uri = uri,
+        .method = HTTP_GET,
+        .handler = asset_handler,
+        .user_ctx = a,
+    };
+    return httpd_register_uri_handler(server, &u);
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// UI estática (main/www), comprimida com gzip no build e embutida em rodata.
+//
+// O corpo sai direto da flash mapeada, sem cópia para a RAM, com
+// Content-Encoding: gzip. O ETag é forte (CRC32 do conteúdo comprimido,
+// calculado uma vez no registro) e o Cache-Control manda revalidar: o
+// navegador guarda a página e, a cada visita, recebe só um 304 enquanto o
+// firmware não mudar. Dados dinâmicos vêm dos endpoints JSON.
+
+typedef enum {
+    WEB_ASSET_INDEX,
+    WEB_ASSET_CONFIG,
+    WEB_ASSET_LOGS,
+    WEB_ASSET_USERS,
+    WEB_ASSET_LIVE,
+    WEB_ASSET_COUNT,
+} web_asset_id_t;
+
+// Registra GET uri servindo o asset
+esp_err_t web_assets_register(httpd_handle_t server, const char *uri, web_asset_id_t asset);
+
+#ifdef __cplusplus
+}
+#endif
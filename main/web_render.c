@@ -0,0 +1,46 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "web_render.h"
+
+void web_render_logs(web_writer_t *w, uint32_t first, uint32_t seq, uint32_t stop, uint32_t end) {
+    web_writer_printf(w, "{\"first\":%lu,\"next\":%lu,\"more\":%d,\"logs\":[", (unsigned long)first,
+                      (unsigned long)stop, stop != end);
+    bool comma = false;
+    for (; seq < stop && !web_writer_failed(w); seq++) {
+        rfid_log_t log;
+        if (rfid_log_read(seq, &log) != ESP_OK) continue;
+
+        char uid[MAX_UID_LEN];
+        rfid_log_format_uid(&log, uid, sizeof(uid));
+        web_writer_printf(w, "%s{\"seq\":%lu,\"uid\":\"%s\",\"d\":%u,\"r\":%u", comma ? "," : "",
+                          (unsigned long)seq, uid, log.decision, log.reader);
+        if (log.time_valid) {
+            web_writer_printf(w, ",\"t\":%lu", (unsigned long)log.time);
+        } else {
+            web_writer_printf(w, ",\"boot\":%u,\"up\":%lu", log.boot, (unsigned long)log.time);
+        }
+        if (log.count > 1) {
+            web_writer_printf(w, ",\"n\":%u,\"span\":%u", log.count, log.span_s);
+        }
+        web_writer_str(w, "}");
+        comma = true;
+    }
+    web_writer_str(w, "]}");
+}
+
+void web_render_user(web_writer_t *w, const rfid_user_t *user, int index) {
+    web_writer_str(w, index ? ",{\"uid\":" : "{\"uid\":");
+    web_writer_json_str(w, user->uid);
+    web_writer_str(w, ",\"name\":");
+    web_writer_json_str(w, user->name);
+    web_writer_str(w, "}");
+}
+
+void web_render_users(web_writer_t *w, const rfid_user_t *users, int count) {
+    web_writer_str(w, "{\"users\":[");
+    for (int i = 0; i < count && !web_writer_failed(w); i++) {
+        web_render_user(w, &users[i], i);
+    }
+    web_writer_str(w, "]}");
+}
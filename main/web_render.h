@@ -0,0 +1,25 @@
+#pragma once
+#include <stdint.h>
+#include "rfid_storage.h"
+#include "web_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Corpo JSON das listagens da API, separado dos handlers HTTP para que o
+// custo de renderização possa ser medido sem servidor (swipe_bench.c).
+
+// {"first":F,"next":stop,"more":M,"logs":[...]} com os registros [seq, stop)
+// do journal; first/end são os limites do journal na hora da consulta.
+// Formato de cada registro: ver /api/logs em app_web.c.
+void web_render_logs(web_writer_t *w, uint32_t first, uint32_t seq, uint32_t stop, uint32_t end);
+
+// {"users":[{"uid":"..","name":".."},...]}
+void web_render_users(web_writer_t *w, const rfid_user_t *users, int count);
+// Um item da lista acima (vírgula antes se index > 0), para listar em páginas
+void web_render_user(web_writer_t *w, const rfid_user_t *user, int index);
+
+#ifdef __cplusplus
+}
+#endif
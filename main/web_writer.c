@@ -0,0 +1,113 @@
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "web_writer.h"
+
+static void flush(web_writer_t *w) {
+    if (w->len == 0 || w->err != ESP_OK) return;
+    w->err = w->sink(w->ctx, w->buf, w->len);
+    w->len = 0;
+}
+
+static esp_err_t send_chunk(void *ctx, const char *data, size_t len) {
+    return httpd_resp_send_chunk(ctx, data, len);
+}
+
+esp_err_t web_writer_begin_sink(web_writer_t *w, web_writer_sink_t sink, void *ctx) {
+    w->sink = sink;
+    w->ctx = ctx;
+    w->len = 0;
+    w->buf = malloc(WEB_CHUNK_SIZE);
+    w->err = w->buf ? ESP_OK : ESP_ERR_NO_MEM;
+    return w->err;
+}
+
+esp_err_t web_writer_begin(web_writer_t *w, httpd_req_t *req) {
+    return web_writer_begin_sink(w, send_chunk, req);
+}
+
+void web_writer_write(web_writer_t *w, const char *data, size_t len) {
+    while (len > 0 && w->err == ESP_OK) {
+        size_t room = WEB_CHUNK_SIZE - w->len;
+        size_t n = len < room ? len : room;
+        memcpy(w->buf + w->len, data, n);
+        w->len += n;
+        data += n;
+        len -= n;
+        if (w->len == WEB_CHUNK_SIZE) flush(w);
+    }
+}
+
+void web_writer_str(web_writer_t *w, const char *str) {
+    web_writer_write(w, str, strlen(str));
+}
+
+void web_writer_printf(web_writer_t *w, const char *fmt, ...) {
+    if (w->err != ESP_OK) return;
+
+    // Formata direto no buffer; se não couber, esvazia e tenta de novo
+    for (int attempt = 0; attempt < 2; attempt++) {
+        size_t room = WEB_CHUNK_SIZE - w->len;
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(w->buf + w->len, room, fmt, ap);
+        va_end(ap);
+        if (n < 0) return;
+        if ((size_t)n < room) {
+            w->len += n;
+            return;
+        }
+        if (w->len == 0) break;         // maior que um chunk inteiro
+        flush(w);
+        if (w->err != ESP_OK) return;
+    }
+
+    // Raro: texto maior que o chunk
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    char *tmp = n > 0 ? malloc(n + 1) : NULL;
+    if (!tmp) {
+        w->err = ESP_ERR_NO_MEM;
+        return;
+    }
+    va_start(ap, fmt);
+    vsnprintf(tmp, n + 1, fmt, ap);
+    va_end(ap);
+    web_writer_write(w, tmp, n);
+    free(tmp);
+}
+
+void web_writer_json_str(web_writer_t *w, const char *str) {
+    web_writer_write(w, "\"", 1);
+    const char *run = str;
+    for (; *str; str++) {
+        unsigned char c = (unsigned char)*str;
+        if (c != '"' && c != '\\' && c >= 0x20) continue;
+
+        web_writer_write(w, run, str - run);
+        run = str + 1;
+        if (c == '"' || c == '\\') {
+            char esc[2] = { '\\', (char)c };
+            web_writer_write(w, esc, 2);
+        } else {
+            web_writer_printf(w, "\\u%04x", c);
+        }
+    }
+    web_writer_write(w, run, str - run);
+    web_writer_write(w, "\"", 1);
+}
+
+esp_err_t web_writer_end(web_writer_t *w) {
+    flush(w);
+    if (w->err == ESP_OK) {
+        w->err = w->sink(w->ctx, NULL, 0);
+    }
+    free(w->buf);
+    w->buf = NULL;
+    return w->err;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Resposta HTTP em chunks do tamanho de um segmento TCP.
+//
+// httpd_resp_send_chunk por linha gera uma escrita no socket (e um segmento
+// quase vazio) por registro. O writer acumula a saída e só envia quando o
+// buffer enche, então uma listagem longa sai em segmentos cheios.
+// O primeiro erro de envio fica guardado; as escritas seguintes viram no-op
+// e o handler pode parar cedo olhando web_writer_failed().
+// O destino é uma função (web_writer_begin_sink): a mesma renderização roda
+// sem servidor HTTP, por exemplo no benchmark (swipe_bench.c).
+
+#ifdef CONFIG_LWIP_TCP_MSS
+#define WEB_CHUNK_SIZE  (CONFIG_LWIP_TCP_MSS - 8)   // desconta "5a0\r\n" + "\r\n" do chunk
+#else
+#define WEB_CHUNK_SIZE  1432
+#endif
+
+// data NULL e len 0 = fim da resposta
+typedef esp_err_t (*web_writer_sink_t)(void *ctx, const char *data, size_t len);
+
+typedef struct {
+    web_writer_sink_t sink;
+    void *ctx;
+    char *buf;
+    size_t len;
+    esp_err_t err;
+} web_writer_t;
+
+esp_err_t web_writer_begin(web_writer_t *w, httpd_req_t *req);
+esp_err_t web_writer_begin_sink(web_writer_t *w, web_writer_sink_t sink, void *ctx);
+void web_writer_write(web_writer_t *w, const char *data, size_t len);
+void web_writer_str(web_writer_t *w, const char *str);
+void web_writer_printf(web_writer_t *w, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// String JSON entre aspas, com escape de aspas, barra e controles
+void web_writer_json_str(web_writer_t *w, const char *str);
+
+static inline bool web_writer_failed(const web_writer_t *w) { return w->err != ESP_OK; }
+
+// Envia o resto, fecha a resposta e libera o buffer
+esp_err_t web_writer_end(web_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
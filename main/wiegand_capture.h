@@ -0,0 +1,197 @@
+#pragma once
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------------------------
+// Захват кадров Wiegand без блокировок.
+//
+// ISR (производитель) сдвигает биты в 64-битный регистр и по паузе между
+// битами закрывает кадр, публикуя его в кольцо SPSC. Задача-декодер
+// (потребитель) читает кольцо и сама закрывает последний кадр по таймауту,
+// когда новых фронтов нет.
+//
+// Кто закрыл кадр — решает один CAS по closed_seq: кадр N публикуется
+// ровно один раз, даже если ISR и задача пытаются закрыть его одновременно.
+// Код не зависит от ESP-IDF: те же функции используются хостовым симулятором.
+// ---------------------------
+
+// Функции на стороне ISR не могут жить во flash: ISR зарегистрирован с
+// ESP_INTR_FLAG_IRAM и продолжает работать во время записи/стирания flash
+#define WG_ISR_INLINE    static inline __attribute__((always_inline))
+
+#define WG_MAX_BITS      64
+#define WG_RING_SIZE     8              // степень двойки
+#define WG_FRAME_GAP_US  40000          // пауза "конец кадра" (верхняя граница)
+
+// Адаптивный конец кадра: пауза больше WG_GAP_FACTOR средних межбитовых
+// интервалов текущего кадра (но не меньше WG_GAP_MIN_US) тоже закрывает кадр.
+// Считыватель с интервалом 2 мс закрывается через ~6 мс, а не через 40.
+#define WG_GAP_FACTOR    3
+#define WG_GAP_MIN_US    3000
+
+typedef struct {
+    uint64_t bits;          // первый принятый бит — старший (nbits младших разрядов)
+    uint8_t  nbits;         // > WG_MAX_BITS = переполнение (кадр слишком длинный)
+    int64_t  t_first_us;    // время первого фронта
+    int64_t  t_last_us;     // время последнего фронта
+} wg_frame_t;
+
+typedef struct {
+    // Аккумулятор текущего кадра: пишет только ISR
+    volatile uint64_t bits;
+    volatile uint8_t  nbits;
+    volatile int64_t  t_first_us;
+    volatile int64_t  t_last_us;
+    volatile uint32_t frame_seq;    // номер открытого (или последнего) кадра
+    _Atomic uint32_t  closed_seq;   // номер последнего закрытого кадра
+
+    int64_t gap_us;
+
+    // Кольцо SPSC: head пишет ISR, tail — задача
+    wg_frame_t ring[WG_RING_SIZE];
+    _Atomic uint32_t head;
+    _Atomic uint32_t tail;
+    _Atomic uint32_t dropped;       // кадры, потерянные из-за полного кольца
+} wg_capture_t;
+
+static inline void wg_capture_init(wg_capture_t *c, int64_t gap_us)
+{
+    c->bits = 0;
+    c->nbits = 0;
+    c->t_first_us = 0;
+    c->t_last_us = 0;
+    c->frame_seq = 0;
+    c->gap_us = gap_us;
+    atomic_store(&c->closed_seq, 0);
+    atomic_store(&c->head, 0);
+    atomic_store(&c->tail, 0);
+    atomic_store(&c->dropped, 0);
+}
+
+// Пауза, после которой текущий кадр считается законченным
+WG_ISR_INLINE int64_t wg_capture_gap(const wg_capture_t *c, uint8_t nbits,
+                                     int64_t t_first_us, int64_t t_last_us)
+{
+    if (nbits < 2) return c->gap_us;
+
+    // 32-битное деление: в ISR без вызова __divdi3
+    uint32_t span = (uint32_t)(t_last_us - t_first_us);
+    int64_t gap = (int64_t)(span / (uint32_t)(nbits - 1)) * WG_GAP_FACTOR;
+    if (gap < WG_GAP_MIN_US) gap = WG_GAP_MIN_US;
+    if (gap > c->gap_us) gap = c->gap_us;
+    return gap;
+}
+
+// --- Сторона ISR ---
+
+// Закрывает кадр frame_seq и кладёт его в кольцо, если задача не успела раньше
+WG_ISR_INLINE bool wg_capture_close_isr(wg_capture_t *c)
+{
+    uint32_t n = c->frame_seq;
+    uint32_t expected = n - 1;
+    if (!atomic_compare_exchange_strong(&c->closed_seq, &expected, n)) {
+        return false; // уже закрыт задачей по таймауту
+    }
+
+    uint32_t h = atomic_load_explicit(&c->head, memory_order_relaxed);
+    uint32_t t = atomic_load_explicit(&c->tail, memory_order_acquire);
+    if (h - t >= WG_RING_SIZE) {
+        atomic_fetch_add_explicit(&c->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    wg_frame_t *f = &c->ring[h & (WG_RING_SIZE - 1)];
+    f->bits = c->bits;
+    f->nbits = c->nbits;
+    f->t_first_us = c->t_first_us;
+    f->t_last_us = c->t_last_us;
+    atomic_store_explicit(&c->head, h + 1, memory_order_release);
+    return true;
+}
+
+// Один фронт на D0 (bit=0) или D1 (bit=1).
+// Возвращает true, если задачу нужно разбудить (новый кадр или кадр в кольце).
+WG_ISR_INLINE bool wg_capture_edge(wg_capture_t *c, unsigned bit, int64_t now_us)
+{
+    bool wake = false;
+
+    if (c->nbits != 0 &&
+        now_us - c->t_last_us >= wg_capture_gap(c, c->nbits, c->t_first_us, c->t_last_us)) {
+        // пауза: предыдущий кадр закончен
+        wake = wg_capture_close_isr(c);
+        c->nbits = 0;
+    }
+    if (c->nbits == 0) {
+        c->bits = 0;
+        c->t_first_us = now_us;
+        c->frame_seq++;
+        wake = true;
+    }
+
+    c->bits = (c->bits << 1) | (bit & 1u);
+    c->nbits++;
+    c->t_last_us = now_us;
+
+    // Переполнение закрывает кадр сразу: иначе средний интервал перестаёт
+    // расти вместе с кадром, пауза растёт до gap_us и склеивает все
+    // следующие кадры, идущие подряд (найдено симулятором, host/wiegand_sim.c)
+    if (c->nbits > WG_MAX_BITS) {
+        wake = wg_capture_close_isr(c) || wake;
+        c->nbits = 0;
+    }
+    return wake;
+}
+
+// --- Сторона задачи ---
+
+static inline bool wg_capture_pop(wg_capture_t *c, wg_frame_t *out)
+{
+    uint32_t t = atomic_load_explicit(&c->tail, memory_order_relaxed);
+    uint32_t h = atomic_load_explicit(&c->head, memory_order_acquire);
+    if (t == h) return false;
+
+    *out = c->ring[t & (WG_RING_SIZE - 1)];
+    atomic_store_explicit(&c->tail, t + 1, memory_order_release);
+    return true;
+}
+
+// Есть ли открытый кадр; deadline_us — когда его можно закрыть по таймауту
+static inline bool wg_capture_pending(const wg_capture_t *c, int64_t *deadline_us)
+{
+    if (atomic_load(&c->closed_seq) == c->frame_seq) return false;
+    *deadline_us = c->t_last_us + wg_capture_gap(c, c->nbits, c->t_first_us, c->t_last_us);
+    return true;
+}
+
+// Закрывает открытый кадр по таймауту. now_us нужно взять ДО вызова:
+// любой фронт, пришедший после, имеет метку > now_us и не пройдёт проверку паузы.
+static inline bool wg_capture_poll(wg_capture_t *c, int64_t now_us, wg_frame_t *out)
+{
+    uint32_t n = c->frame_seq;
+    if (atomic_load(&c->closed_seq) == n) return false;
+
+    wg_frame_t f = {
+        .bits = c->bits,
+        .nbits = c->nbits,
+        .t_first_us = c->t_first_us,
+        .t_last_us = c->t_last_us,
+    };
+    if (f.nbits == 0 ||
+        now_us - f.t_last_us < wg_capture_gap(c, f.nbits, f.t_first_us, f.t_last_us)) return false;
+
+    // Если ISR успел закрыть кадр между чтениями, CAS не пройдёт
+    uint32_t expected = n - 1;
+    if (!atomic_compare_exchange_strong(&c->closed_seq, &expected, n)) return false;
+
+    *out = f;
+    return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include "wiegand_format.h"
+
+// Маски чётности заданы в позициях значения: бит, принятый первым,
+// стоит в разряде nbits-1, последний — в разряде 0.
+
+static const wg_format_t fmt_h10301 = {
+    .id = WG_FMT_H10301_26, .name = "H10301", .nbits = 26,
+    .n_parity = 2,
+    .parity = {
+        { 0x3ffe000ULL, 0, 25 },        // бит 0: чётность по битам 0..12
+        { 0x0001fffULL, 1, 0 },         // бит 25: нечётность по битам 13..25
+    },
+    .fc_shift = 17, .fc_bits = 8,
+    .card_shift = 1, .card_bits = 16,
+};
+
+static const wg_format_t fmt_h10306 = {
+    .id = WG_FMT_H10306_34, .name = "H10306", .nbits = 34,
+    .n_parity = 2,
+    .parity = {
+        { 0x3fffe0000ULL, 0, 33 },      // бит 0: чётность по битам 0..16
+        { 0x00001ffffULL, 1, 0 },       // бит 33: нечётность по битам 17..33
+    },
+    .fc_shift = 17, .fc_bits = 16,
+    .card_shift = 1, .card_bits = 16,
+};
+
+static const wg_format_t fmt_c1000_35 = {
+    .id = WG_FMT_C1000_35, .name = "C1000-35", .nbits = 35,
+    .n_parity = 3,
+    .parity = {
+        { 0x3b6db6db6ULL, 0, 33 },      // бит 1: чётность по парам 2-3, 5-6, ... 32-33
+        { 0x36db6db6dULL, 1, 0 },       // бит 34: нечётность по парам 1-2, 4-5, ... 31-32
+        { 0x7ffffffffULL, 1, 34 },      // бит 0: нечётность по всему кадру
+    },
+    .fc_shift = 21, .fc_bits = 12,
+    .card_shift = 1, .card_bits = 20,
+};
+
+static const wg_format_t fmt_h10304 = {
+    .id = WG_FMT_H10304_37, .name = "H10304", .nbits = 37,
+    .n_parity = 2,
+    .parity = {
+        { 0x1ffffc0000ULL, 0, 36 },     // бит 0: чётность по битам 0..18
+        { 0x000007ffffULL, 1, 0 },      // бит 36: нечётность по битам 18..36
+    },
+    .fc_shift = 20, .fc_bits = 16,
+    .card_shift = 1, .card_bits = 19,
+};
+
+static const wg_format_t fmt_c1000_48 = {
+    .id = WG_FMT_C1000_48, .name = "C1000-48", .nbits = 48,
+    .n_parity = 3,
+    .parity = {
+        { 0x76db6db6db6cULL, 0, 46 },   // бит 1: чётность по парам 2-3, ... 44-45
+        { 0x6db6db6db6dbULL, 1, 0 },    // бит 47: нечётность по парам 1-2, ... 43-44, 46
+        { 0xffffffffffffULL, 1, 47 },   // бит 0: нечётность по всему кадру
+    },
+    .fc_shift = 24, .fc_bits = 22,
+    .card_shift = 1, .card_bits = 23,
+};
+
+static const wg_format_t fmt_raw = {
+    .id = WG_FMT_RAW, .name = "RAW", .nbits = 0,
+    .n_parity = 0,
+};
+
+// Выбор формата по длине — один доступ к таблице
+static const wg_format_t *const formats_by_len[WG_RAW_MAX_BITS + 1] = {
+    [26] = &fmt_h10301,
+    [34] = &fmt_h10306,
+    [35] = &fmt_c1000_35,
+    [37] = &fmt_h10304,
+    [48] = &fmt_c1000_48,
+};
+
+const wg_format_t *wg_format_for_length(uint8_t nbits)
+{
+    if (nbits > WG_RAW_MAX_BITS) return NULL;
+    if (formats_by_len[nbits]) return formats_by_len[nbits];
+    // RAW только для целых байтов (UID 4/5/7 байт): кадр с лишним или
+    // потерянным битом иначе принимался бы без всякой проверки
+    if (nbits >= WG_RAW_MIN_BITS && nbits % 8 == 0) return &fmt_raw;
+    return NULL;
+}
+
+wg_decode_result_t wg_decode(uint64_t bits, uint8_t nbits, wg_credential_t *out)
+{
+    const wg_format_t *fmt = wg_format_for_length(nbits);
+    if (!fmt) return WG_DECODE_BAD_LENGTH;
+
+    bits &= (nbits >= 64) ? ~0ULL : ((1ULL << nbits) - 1);
+
+    for (int i = 0; i < fmt->n_parity; i++) {
+        if ((unsigned)__builtin_parityll(bits & fmt->parity[i].mask) != fmt->parity[i].odd) {
+            return WG_DECODE_BAD_PARITY;
+        }
+    }
+
+    out->format = (uint8_t)fmt->id;
+    out->nbits = nbits;
+    if (fmt->id == WG_FMT_RAW) {
+        out->facility = 0;
+        out->card = (uint32_t)bits;
+        out->id = ((uint64_t)fmt->id << 56) | bits;
+    } else {
+        out->facility = (uint32_t)((bits >> fmt->fc_shift) & ((1ULL << fmt->fc_bits) - 1));
+        out->card = (uint32_t)((bits >> fmt->card_shift) & ((1ULL << fmt->card_bits) - 1));
+        out->id = ((uint64_t)fmt->id << 56) | ((uint64_t)out->facility << 32) | out->card;
+    }
+    return WG_DECODE_OK;
+}
+
+uint64_t wg_encode(const wg_format_t *fmt, uint32_t facility, uint32_t card)
+{
+    if (fmt->id == WG_FMT_RAW) return card;
+
+    uint64_t v = ((uint64_t)(facility & ((1ULL << fmt->fc_bits) - 1)) << fmt->fc_shift) |
+                 ((uint64_t)(card & ((1ULL << fmt->card_bits) - 1)) << fmt->card_shift);
+
+    // По порядку таблицы: общая чётность C1000 идёт последней и учитывает предыдущие
+    for (int i = 0; i < fmt->n_parity; i++) {
+        if ((unsigned)__builtin_parityll(v & fmt->parity[i].mask) != fmt->parity[i].odd) {
+            v ^= 1ULL << fmt->parity[i].bit;
+        }
+    }
+    return v;
+}
+
+size_t wg_credential_to_str(const wg_credential_t *cred, char *buf, size_t len)
+{
+    int n;
+    if (cred->format == WG_FMT_RAW) {
+        n = snprintf(buf, len, "%llX", (unsigned long long)(cred->id & ((1ULL << 56) - 1)));
+    } else {
+        n = snprintf(buf, len, "%lu:%lu", (unsigned long)cred->facility, (unsigned long)cred->card);
+    }
+    return n < 0 ? 0 : (size_t)n;
+}
+
+void wg_credential_from_id(uint64_t id, wg_credential_t *out)
+{
+    out->id = id;
+    out->format = (uint8_t)(id >> 56);
+    out->nbits = 0;
+    for (int n = 0; n <= WG_RAW_MAX_BITS; n++) {
+        if (formats_by_len[n] && formats_by_len[n]->id == out->format && out->format != WG_FMT_RAW) {
+            out->nbits = n;
+            break;
+        }
+    }
+    if (out->format == WG_FMT_RAW) {
+        out->facility = 0;
+        out->card = (uint32_t)id;
+    } else {
+        out->facility = (uint32_t)(id >> 32) & 0xFFFFFF;
+        out->card = (uint32_t)id;
+    }
+}
+
+const char *wg_format_name(uint8_t format)
+{
+    switch (format) {
+    case WG_FMT_H10301_26: return fmt_h10301.name;
+    case WG_FMT_H10306_34: return fmt_h10306.name;
+    case WG_FMT_C1000_35:  return fmt_c1000_35.name;
+    case WG_FMT_H10304_37: return fmt_h10304.name;
+    case WG_FMT_C1000_48:  return fmt_c1000_48.name;
+    case WG_FMT_RAW:       return fmt_raw.name;
+    default:               return "?";
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------------------------
+// Табличный декодер форматов Wiegand.
+// Формат выбирается по длине кадра, чётность проверяется масками
+// над всем 64-битным словом (__builtin_parityll), поля извлекаются
+// сдвигом и маской. Не зависит от ESP-IDF.
+// ---------------------------
+
+typedef enum {
+    WG_FMT_NONE = 0,
+    WG_FMT_H10301_26,       // 8 бит FC + 16 бит номер
+    WG_FMT_H10306_34,       // 16 бит FC + 16 бит номер
+    WG_FMT_C1000_35,        // Corporate 1000: 12 бит CID + 20 бит номер
+    WG_FMT_H10304_37,       // 16 бит FC + 19 бит номер
+    WG_FMT_C1000_48,        // Corporate 1000: 22 бита CID + 23 бита номер
+    WG_FMT_RAW,             // без чётности (CSN-считыватели, 32/40/56 бит)
+} wg_format_id_t;
+
+#define WG_RAW_MIN_BITS  32
+#define WG_RAW_MAX_BITS  56     // id хранит формат в старшем байте
+
+typedef struct {
+    uint64_t mask;          // биты, входящие в проверку (вкл. сам бит чётности)
+    uint8_t  odd;           // 1 = нечётная, 0 = чётная
+    uint8_t  bit;           // разряд самого бита чётности (для кодера)
+} wg_parity_t;
+
+typedef struct {
+    wg_format_id_t id;
+    const char *name;
+    uint8_t nbits;
+    uint8_t n_parity;
+    wg_parity_t parity[3];
+    uint8_t fc_shift, fc_bits;
+    uint8_t card_shift, card_bits;
+} wg_format_t;
+
+// Канонический идентификатор карты
+typedef struct {
+    uint64_t id;            // формат << 56 | FC << 32 | номер; RAW: формат << 56 | биты
+    uint8_t  format;        // wg_format_id_t
+    uint8_t  nbits;
+    uint32_t facility;
+    uint32_t card;
+} wg_credential_t;
+
+typedef enum {
+    WG_DECODE_OK = 0,
+    WG_DECODE_BAD_LENGTH,   // нет формата для такой длины (шум, обрыв)
+    WG_DECODE_BAD_PARITY,
+} wg_decode_result_t;
+
+// Описание формата по длине или NULL
+const wg_format_t *wg_format_for_length(uint8_t nbits);
+
+// bits: первый принятый бит — старший из nbits
+wg_decode_result_t wg_decode(uint64_t bits, uint8_t nbits, wg_credential_t *out);
+
+// Обратная операция (симулятор, бенчмарки): кадр с корректной чётностью.
+// Для RAW card — младшие 32 бита, остальное нули.
+uint64_t wg_encode(const wg_format_t *fmt, uint32_t facility, uint32_t card);
+
+// Текстовая форма для таблицы пользователей: "FC:номер", RAW — hex
+size_t wg_credential_to_str(const wg_credential_t *cred, char *buf, size_t len);
+
+// Разбор канонического id обратно в поля (логи хранят только id)
+void wg_credential_from_id(uint64_t id, wg_credential_t *out);
+
+const char *wg_format_name(uint8_t format);
+
+#ifdef __cplusplus
+}
+#endif
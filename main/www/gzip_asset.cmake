@@ -0,0 +1,4 @@
+# Comprime um asset da UI para embutir no firmware (chamado por main/CMakeLists.txt).
+# Uso: cmake -DIN=<arquivo> -DOUT=<arquivo.gz> -P gzip_asset.cmake, a partir do diretório de IN
+cmake_minimum_required(VERSION 3.19)
+file(ARCHIVE_CREATE OUTPUT ${OUT} PATHS ${IN} FORMAT raw COMPRESSION GZip COMPRESSION_LEVEL 9)